@@ -17,15 +17,26 @@ if (!fs.existsSync(cppDir)) {
 const isDebug = process.argv.includes("--debug");
 console.log(`Building in ${isDebug ? "debug" : "optimized release"} mode...`);
 
-// List of source files to compile - include dfs.cpp and dfs_algorithm.cpp
+// List of source files to compile - keep in sync with build.sh
 const sourceFiles = [
   "bfs.cpp",
   "dfs.cpp",
+  "dp.cpp",
   "effects.cpp",
   "pricing.cpp",
   "reporter.cpp",
   "bfs_algorithm.cpp",
   "dfs_algorithm.cpp",
+  "state_table.cpp",
+  "rule_kernel.cpp",
+  "work_pool.cpp",
+  "profit_bound.cpp",
+  "top_k.cpp",
+  "constraints.cpp",
+  "shared_best.cpp",
+  "metrics.cpp",
+  "dp_algorithm.cpp",
+  "incremental.cpp",
   "json_parser.cpp",
 ].map((file) => path.join(cppDir, file).replace(/\\/g, "/"));
 
@@ -36,9 +47,12 @@ if (missingFiles.length > 0) {
   process.exit(1);
 }
 
-// Output paths
+// Output paths: a single-threaded module that loads everywhere, and a threaded one
+// for cross-origin isolated pages
 const wasmOutputPath = path.join(cppDir, "bfs.wasm.js").replace(/\\/g, "/");
 const wasmBinaryPath = path.join(cppDir, "bfs.wasm.wasm").replace(/\\/g, "/");
+const threadsOutputPath = path.join(cppDir, "bfs.threads.wasm.js").replace(/\\/g, "/");
+const threadsBinaryPath = path.join(cppDir, "bfs.threads.wasm.wasm").replace(/\\/g, "/");
 
 // Define common Emscripten arguments
 const commonArgs = [
@@ -48,15 +62,19 @@ const commonArgs = [
   "-s EXPORT_ES6=1",
   "-s EXPORT_NAME=createBfsModule",
   "-s ENVIRONMENT=web,worker",
-  // Enable WebAssembly threads support
-  "-s USE_PTHREADS=1",
-  "-s PTHREAD_POOL_SIZE=16", // Specify thread pool size
   "-s TOTAL_MEMORY=3072MB", // Increase memory to accommodate threads
   "-s ALLOW_MEMORY_GROWTH=1",
+  "-msimd128", // 128-bit SIMD for the rule kernel
   "--bind",
   "--no-entry",
 ];
 
+// Extra arguments for the threaded build, with one pool worker per core
+const threadArgs = [
+  "-pthread",
+  "-s PTHREAD_POOL_SIZE=navigator.hardwareConcurrency",
+];
+
 // Define debug-specific arguments
 const debugArgs = [
   ...commonArgs,
@@ -76,7 +94,7 @@ const releaseArgs = [
   "-fno-rtti",
   "-fno-exceptions",
   "-DEMSCRIPTEN_HAS_UNBOUND_TYPE_NAMES=0",
-  "-s ASSERTIONS=1",
+  "-s ASSERTIONS=0",
   "-s MALLOC=emmalloc",
   "-s SUPPORT_ERRNO=0",
   "-s DISABLE_EXCEPTION_CATCHING=1",
@@ -96,16 +114,22 @@ if (vcpkgRoot) {
   buildArgs.push(`-I "${vcpkgRoot}/installed/wasm32-emscripten/include"`);
 }
 
-// Build the command
-const command = `emcc -std=c++17 ${sourceFiles.join(
-  " "
-)} -o "${wasmOutputPath}" ${buildArgs.join(" ")}`;
+// Build the commands
+const commands = [
+  `emcc -std=c++17 ${sourceFiles.join(" ")} -o "${wasmOutputPath}" ${buildArgs.join(" ")}`,
+  `emcc -std=c++17 ${sourceFiles.join(" ")} -o "${threadsOutputPath}" ${[
+    ...buildArgs,
+    ...threadArgs,
+  ].join(" ")}`,
+];
 
 console.log("Compiling C++ to WebAssembly...");
-console.log(command);
 
 try {
-  execSync(command, { stdio: "inherit" });
+  for (const command of commands) {
+    console.log(command);
+    execSync(command, { stdio: "inherit" });
+  }
   console.log("Successfully compiled C++ to WebAssembly!");
 
   // Copy the generated .wasm file to the public directory to ensure it's accessible
@@ -116,27 +140,33 @@ try {
     fs.mkdirSync(publicDir, { recursive: true });
   }
 
-  if (fs.existsSync(wasmBinaryPath)) {
+  [
+    [wasmBinaryPath, "bfs.wasm"],
+    [threadsBinaryPath, "bfs.threads.wasm"],
+  ].forEach(([binaryPath, servedName]) => {
+    if (!fs.existsSync(binaryPath)) {
+      console.error(`WASM binary not found at ${binaryPath}`);
+      return;
+    }
+
     // Copy to public directory for development
-    fs.copyFileSync(wasmBinaryPath, path.join(publicDir, "bfs.wasm"));
-    console.log("Copied WASM file to public directory for serving");
+    fs.copyFileSync(binaryPath, path.join(publicDir, servedName));
+    console.log(`Copied ${servedName} to public directory for serving`);
 
     // Copy to dist directory if it exists (for production builds)
     if (fs.existsSync(distDir)) {
       if (!fs.existsSync(path.join(distDir, "assets"))) {
         fs.mkdirSync(path.join(distDir, "assets"), { recursive: true });
       }
-      fs.copyFileSync(wasmBinaryPath, path.join(distDir, "assets", "bfs.wasm"));
-      fs.copyFileSync(wasmBinaryPath, path.join(distDir, "bfs.wasm"));
-      console.log("Copied WASM file to dist directory for production");
+      fs.copyFileSync(binaryPath, path.join(distDir, "assets", servedName));
+      fs.copyFileSync(binaryPath, path.join(distDir, servedName));
+      console.log(`Copied ${servedName} to dist directory for production`);
     }
-  } else {
-    console.error(`WASM binary not found at ${wasmBinaryPath}`);
-  }
+  });
 
   // Display file sizes
   console.log("📊 Build size:");
-  [wasmOutputPath, wasmBinaryPath].forEach((file) => {
+  [wasmOutputPath, wasmBinaryPath, threadsOutputPath, threadsBinaryPath].forEach((file) => {
     if (fs.existsSync(file)) {
       const stats = fs.statSync(file);
       console.log(`- ${file}: ${(stats.size / 1024).toFixed(2)} KB`);
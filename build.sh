@@ -12,31 +12,47 @@ mkdir -p src/cpp
 COMMON_ARGS=(
   src/cpp/bfs.cpp
   src/cpp/dfs.cpp
+  src/cpp/dp.cpp
   src/cpp/effects.cpp
   src/cpp/pricing.cpp
   src/cpp/reporter.cpp
   src/cpp/bfs_algorithm.cpp
   src/cpp/dfs_algorithm.cpp
+  src/cpp/state_table.cpp
+  src/cpp/rule_kernel.cpp
+  src/cpp/work_pool.cpp
+  src/cpp/profit_bound.cpp
+  src/cpp/top_k.cpp
+  src/cpp/constraints.cpp
+  src/cpp/shared_best.cpp
+  src/cpp/metrics.cpp
+  src/cpp/dp_algorithm.cpp
+  src/cpp/incremental.cpp
   src/cpp/json_parser.cpp
-  -o src/cpp/bfs.wasm.js
   -s WASM=1
   -s ALLOW_MEMORY_GROWTH=1
   -s EXPORTED_RUNTIME_METHODS='["ccall","cwrap"]'
   -s EXPORT_ES6=1
   -s EXPORT_NAME=createBfsModule
-  -s ENVIRONMENT=web
-  # Enable WebAssembly threads support
-  -s USE_PTHREADS=1
-  -s PTHREAD_POOL_SIZE=16
   -s TOTAL_MEMORY=3072MB
   -s ALLOW_MEMORY_GROWTH=1
   -s ENVIRONMENT=web,worker
   -s ASYNCIFY=1
+  # 128-bit SIMD for the rule kernel (supported by all current browsers)
+  -msimd128
   -I "$VCPKG_ROOT/installed/wasm32-emscripten/include"
   --bind
   --no-entry
 )
 
+# Extra arguments for the threaded build, loaded by the DFS worker on cross-origin
+# isolated pages. The pool is created up front with one worker per core, so DFS can
+# start its threads without yielding to the browser
+THREAD_ARGS=(
+  -pthread
+  -s PTHREAD_POOL_SIZE=navigator.hardwareConcurrency
+)
+
 # Debug build arguments
 DEBUG_ARGS=(
   "${COMMON_ARGS[@]}"
@@ -56,7 +72,7 @@ RELEASE_ARGS=(
   -fno-rtti
   -fno-exceptions
   -DEMSCRIPTEN_HAS_UNBOUND_TYPE_NAMES=0
-  -s ASSERTIONS=1
+  -s ASSERTIONS=0
   -s MALLOC=emmalloc
   -s SUPPORT_ERRNO=0
   -s NO_FILESYSTEM=1
@@ -72,9 +88,10 @@ RELEASE_ARGS=(
 copy_wasm_to_public() {
   mkdir -p public/
   cp src/cpp/bfs.wasm.wasm public/bfs.wasm
+  cp src/cpp/bfs.threads.wasm.wasm public/bfs.threads.wasm
   # Copy worker script if it exists
-  if [ -f "src/cpp/bfs.wasm.worker.js" ]; then
-    cp src/cpp/bfs.wasm.worker.js public/
+  if [ -f "src/cpp/bfs.threads.wasm.worker.js" ]; then
+    cp src/cpp/bfs.threads.wasm.worker.js public/
   fi
   echo "Copied WASM file to public directory for serving"
 }
@@ -85,10 +102,12 @@ copy_wasm_to_dist() {
     mkdir -p dist/assets/
     cp src/cpp/bfs.wasm.wasm dist/assets/bfs.wasm
     cp src/cpp/bfs.wasm.wasm dist/bfs.wasm
+    cp src/cpp/bfs.threads.wasm.wasm dist/assets/bfs.threads.wasm
+    cp src/cpp/bfs.threads.wasm.wasm dist/bfs.threads.wasm
     # Copy worker script if it exists
-    if [ -f "src/cpp/bfs.wasm.worker.js" ]; then
-      cp src/cpp/bfs.wasm.worker.js dist/assets/
-      cp src/cpp/bfs.wasm.worker.js dist/
+    if [ -f "src/cpp/bfs.threads.wasm.worker.js" ]; then
+      cp src/cpp/bfs.threads.wasm.worker.js dist/assets/
+      cp src/cpp/bfs.threads.wasm.worker.js dist/
     fi
     echo "Copied WASM file to dist directory for production"
   fi
@@ -97,10 +116,12 @@ copy_wasm_to_dist() {
 # Build options
 if [[ "$1" == "--debug" ]]; then
   echo "Building in debug mode..."
-  emcc -std=c++17 "${DEBUG_ARGS[@]}"
+  emcc -std=c++17 "${DEBUG_ARGS[@]}" -o src/cpp/bfs.wasm.js
+  emcc -std=c++17 "${DEBUG_ARGS[@]}" "${THREAD_ARGS[@]}" -o src/cpp/bfs.threads.wasm.js
 else
   echo "Building in optimized release mode..."
-  emcc -std=c++17 "${RELEASE_ARGS[@]}"
+  emcc -std=c++17 "${RELEASE_ARGS[@]}" -o src/cpp/bfs.wasm.js
+  emcc -std=c++17 "${RELEASE_ARGS[@]}" "${THREAD_ARGS[@]}" -o src/cpp/bfs.threads.wasm.js
 fi
 
 echo "Successfully compiled C++ to WebAssembly!"
@@ -111,6 +132,7 @@ copy_wasm_to_dist
 # Display file sizes
 echo "📊 Build size:"
 ls -lh src/cpp/bfs.wasm.js src/cpp/bfs.wasm.wasm | awk '{print "- " $9 ": " $5}'
-if [ -f "src/cpp/bfs.wasm.worker.js" ]; then
-  ls -lh src/cpp/bfs.wasm.worker.js | awk '{print "- " $9 ": " $5}'
+ls -lh src/cpp/bfs.threads.wasm.js src/cpp/bfs.threads.wasm.wasm | awk '{print "- " $9 ": " $5}'
+if [ -f "src/cpp/bfs.threads.wasm.worker.js" ]; then
+  ls -lh src/cpp/bfs.threads.wasm.worker.js | awk '{print "- " $9 ": " $5}'
 fi
@@ -0,0 +1,41 @@
+#!/bin/bash
+# Profile-guided, link-time optimized native build.
+#
+# Builds instrumented binaries, trains them on the benchmark harness workloads in bench/,
+# then rebuilds the calculator and the harness optimized with the recorded profiles.
+# Usage: ./pgo-build.sh [build dir] [extra CMake arguments...]
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="${1:-$SCRIPT_DIR/build-pgo}"
+shift || true
+PROFILE_DIR="$BUILD_DIR/pgo-profile"
+
+# Training matrix: every engine on every bench product, single- and multithreaded, at
+# depths that run in seconds but reach the deep-search hot paths
+TRAINING_ARGS=(--depths 4,5,6 --threads "1,$(nproc 2>/dev/null || echo 4)" -o "$BUILD_DIR/pgo-training.json")
+
+configure() {
+  cmake -S "$SCRIPT_DIR" -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release \
+    -DBFS_PGO="$1" -DBFS_PGO_DIR="$PROFILE_DIR" "${@:2}"
+}
+
+echo "Building instrumented binaries..."
+rm -rf "$PROFILE_DIR"
+configure GENERATE "$@"
+cmake --build "$BUILD_DIR" --target bfs_bench -j"$(nproc 2>/dev/null || echo 4)"
+
+echo "Training on the benchmark workloads..."
+"$BUILD_DIR/bfs_bench" "${TRAINING_ARGS[@]}"
+
+# Clang writes raw profiles that have to be merged first
+if compgen -G "$PROFILE_DIR/*.profraw" > /dev/null; then
+  llvm-profdata merge -output="$PROFILE_DIR/default.profdata" "$PROFILE_DIR"/*.profraw
+fi
+
+echo "Building with the profiles..."
+configure USE "$@"
+cmake --build "$BUILD_DIR" --clean-first -j"$(nproc 2>/dev/null || echo 4)"
+
+echo "Optimized binaries: $BUILD_DIR/bfs_calculator and $BUILD_DIR/bfs_bench"
@@ -1,7 +1,8 @@
 // Node.js server for schedule-I-calculator
-// This server exposes an API endpoint that runs the native C++ BFS algorithm
+// This server exposes an API endpoint that runs the native C++ solver daemon
 
-import { exec } from "child_process";
+import { spawn } from "child_process";
+import crypto from "crypto";
 import { EventEmitter } from "events";
 import express from "express";
 import fs from "fs";
@@ -74,7 +75,227 @@ app.use(express.json());
 // Serve static files from the project directory
 app.use(express.static("./"));
 
-// API endpoint for mix calculations - supports both BFS and DFS
+// Frame types of the native solver daemon protocol (see src/cpp/daemon.h)
+const FRAME = {
+  DATASET: 0x44, // 'D'
+  JOB: 0x4a, // 'J'
+  CANCEL: 0x43, // 'C'
+  PROGRESS: 0x50, // 'P'
+  BEST_MIX: 0x42, // 'B'
+  METRICS: 0x4d, // 'M'
+  DEPTH_RESULT: 0x41, // 'A'
+  RESULT: 0x52, // 'R'
+  ERROR: 0x45, // 'E'
+};
+
+// Number of parsed datasets the daemon keeps, matching MAX_DATASETS in daemon.cpp
+const DAEMON_DATASETS = 16;
+
+// Client for one long-lived `bfs_calculator --daemon` process. Substance data is sent
+// once per distinct dataset and jobs are multiplexed over the process's stdin/stdout
+class SolverDaemon {
+  constructor(executable, args) {
+    this.executable = executable;
+    this.args = args;
+    this.process = null;
+    this.buffer = Buffer.alloc(0);
+    this.jobs = new Map();
+    this.datasets = new Map(); // Mirrors the daemon's LRU order, oldest first
+    this.nextJobId = 1;
+  }
+
+  start() {
+    if (this.process) {
+      return;
+    }
+
+    console.log(`Starting solver daemon: ${this.executable}`);
+    const child = spawn(this.executable, ["--daemon", ...this.args], {
+      stdio: ["pipe", "pipe", "pipe"],
+    });
+    this.process = child;
+    this.buffer = Buffer.alloc(0);
+    this.datasets.clear();
+
+    child.stdout.on("data", (chunk) => this.onData(chunk));
+    child.stdin.on("error", (error) => {
+      console.error(`Solver daemon stdin error: ${error.message}`);
+    });
+    child.stderr.on("data", (data) => {
+      console.log(`Solver stderr: ${data}`);
+    });
+
+    const onExit = (reason) => {
+      if (this.process !== child) {
+        return;
+      }
+      this.process = null;
+      for (const job of this.jobs.values()) {
+        job.reject(new Error(`Solver daemon ${reason}`));
+      }
+      this.jobs.clear();
+    };
+    child.on("error", (error) => onExit(`failed: ${error.message}`));
+    child.on("exit", (code) => onExit(`exited with code ${code}`));
+  }
+
+  send(type, payload) {
+    const body = Buffer.isBuffer(payload)
+      ? payload
+      : Buffer.from(JSON.stringify(payload));
+    const header = Buffer.alloc(5);
+    header.writeUInt32LE(body.length, 0);
+    header.writeUInt8(type, 4);
+    this.process.stdin.write(Buffer.concat([header, body]));
+  }
+
+  onData(chunk) {
+    this.buffer = Buffer.concat([this.buffer, chunk]);
+    while (this.buffer.length >= 5) {
+      const length = this.buffer.readUInt32LE(0);
+      if (this.buffer.length < 5 + length) {
+        break;
+      }
+      const type = this.buffer.readUInt8(4);
+      const body = this.buffer.subarray(5, 5 + length);
+      this.buffer = this.buffer.subarray(5 + length);
+      this.dispatch(type, body);
+    }
+  }
+
+  dispatch(type, body) {
+    if (type === FRAME.PROGRESS) {
+      const job = this.jobs.get(body.readUInt32LE(0));
+      if (job) {
+        job.onProgress({
+          depth: body.readUInt32LE(4),
+          processed: Number(body.readBigInt64LE(8)),
+          total: Number(body.readBigInt64LE(16)),
+        });
+      }
+      return;
+    }
+
+    const message = JSON.parse(body.toString("utf8"));
+    const job = this.jobs.get(message.jobId);
+    if (type === FRAME.BEST_MIX) {
+      if (job) {
+        job.onBestMix(message);
+      }
+    } else if (type === FRAME.METRICS) {
+      if (job && job.onMetrics) {
+        job.onMetrics(message);
+      }
+    } else if (type === FRAME.DEPTH_RESULT) {
+      if (job && job.onDepthResult) {
+        job.onDepthResult(message);
+      }
+    } else if (type === FRAME.RESULT || type === FRAME.ERROR) {
+      if (!job) {
+        if (type === FRAME.ERROR) {
+          console.error(`Solver daemon error: ${message.error}`);
+        }
+        return;
+      }
+      this.jobs.delete(message.jobId);
+      if (type === FRAME.RESULT) {
+        job.resolve(message);
+      } else {
+        job.reject(new Error(message.error));
+      }
+    }
+  }
+
+  // Send the dataset unless the daemon still has it, and return its ID
+  useDataset(substances, effectMultipliers, substanceRules) {
+    const dataset = { substances, effectMultipliers, substanceRules };
+    const id = crypto
+      .createHash("sha1")
+      .update(JSON.stringify(dataset))
+      .digest("hex");
+
+    if (this.datasets.has(id)) {
+      this.datasets.delete(id);
+    } else {
+      this.send(FRAME.DATASET, { id, ...dataset });
+      if (this.datasets.size >= DAEMON_DATASETS) {
+        this.datasets.delete(this.datasets.keys().next().value);
+      }
+    }
+    this.datasets.set(id, true);
+    return id;
+  }
+
+  // Queue a job. Returns its ID and a promise for the result message
+  solve(request, { onProgress, onBestMix, onMetrics, onDepthResult }) {
+    this.start();
+
+    const jobId = this.nextJobId;
+    this.nextJobId = (this.nextJobId % 0xffffffff) + 1;
+
+    const dataset = this.useDataset(
+      request.substances,
+      request.effectMultipliers,
+      request.substanceRules
+    );
+    const promise = new Promise((resolve, reject) => {
+      this.jobs.set(jobId, {
+        resolve,
+        reject,
+        onProgress,
+        onBestMix,
+        onMetrics,
+        onDepthResult,
+      });
+    });
+    this.send(FRAME.JOB, {
+      jobId,
+      dataset,
+      product: request.product,
+      maxDepth: request.maxDepth,
+      algorithm: request.algorithm,
+      topK: request.topK,
+      topMaxCost: request.topMaxCost,
+      topMaxLength: request.topMaxLength,
+      metrics: Boolean(onMetrics),
+      anytime: request.anytime,
+      deadlineMs: request.deadlineMs,
+    });
+    return { jobId, promise };
+  }
+
+  cancel(jobId) {
+    if (!this.process || !this.jobs.has(jobId)) {
+      return false;
+    }
+    const payload = Buffer.alloc(4);
+    payload.writeUInt32LE(jobId, 0);
+    this.send(FRAME.CANCEL, payload);
+    return true;
+  }
+}
+
+// Determine the path of the bfs_calculator executable based on the platform
+const isWindows = process.platform === "win32";
+const calculatorExecutable = isWindows
+  ? path.join(__dirname, "build", "Release", "bfs_calculator.exe")
+  : path.join(__dirname, "build", "bin", "bfs_calculator");
+
+// Keep the result cache next to the other server scratch files
+const tempDir = path.join(__dirname, "temp");
+if (!fs.existsSync(tempDir)) {
+  fs.mkdirSync(tempDir);
+}
+
+const solverDaemon = new SolverDaemon(calculatorExecutable, [
+  "--cache-file",
+  path.join(tempDir, "result_cache.tsv"),
+]);
+
+// Longest time a job may run before it's cancelled (20 minutes)
+const JOB_TIMEOUT_MS = 20 * 60 * 1000;
+
+// API endpoint for mix calculations - supports BFS, DFS and DP
 app.post("/api/mix", async (req, res) => {
   try {
     const { product, maxDepth, algorithm = "bfs" } = req.body;
@@ -87,79 +308,115 @@ app.post("/api/mix", async (req, res) => {
     }
 
     // Validate algorithm selection
-    if (algorithm !== "bfs" && algorithm !== "dfs") {
+    if (algorithm !== "bfs" && algorithm !== "dfs" && algorithm !== "dp") {
       return res.status(400).json({
         success: false,
-        error: "Invalid algorithm. Use 'bfs' or 'dfs'",
+        error: "Invalid algorithm. Use 'bfs', 'dfs' or 'dp'",
       });
     }
 
-    // Create temporary JSON files for the native process
-    const tempDir = path.join(__dirname, "temp");
-
-    // Ensure the temp directory exists
-    if (!fs.existsSync(tempDir)) {
-      fs.mkdirSync(tempDir);
-    }
-
-    // Write input data to temp files
-    const productJsonPath = path.join(tempDir, "product.json");
-    const substancesJsonPath = path.join(tempDir, "substances.json");
-    const effectMultipliersJsonPath = path.join(
-      tempDir,
-      "effectMultipliers.json"
-    );
-    const substanceRulesJsonPath = path.join(tempDir, "substanceRules.json");
-    const outputJsonPath = path.join(tempDir, "output.json");
-
-    // Add maxDepth to product object so it's available in the JSON
-    const productWithDepth = {
-      ...req.body.product,
-      maxDepth: maxDepth || 5,
-    };
-
-    fs.writeFileSync(
-      productJsonPath,
-      JSON.stringify(productWithDepth, null, 2)
-    );
-    fs.writeFileSync(
-      substancesJsonPath,
-      JSON.stringify(req.body.substances, null, 2)
-    );
-    fs.writeFileSync(
-      effectMultipliersJsonPath,
-      JSON.stringify(req.body.effectMultipliers, null, 2)
-    );
-    fs.writeFileSync(
-      substanceRulesJsonPath,
-      JSON.stringify(req.body.substanceRules, null, 2)
-    );
-
-    // Determine the path of the bfs_calculator executable based on the platform
-    const isWindows = process.platform === "win32";
-    const calculatorExecutable = isWindows
-      ? path.join(__dirname, "build", "Release", "bfs_calculator.exe")
-      : path.join(__dirname, "build", "bin", "bfs_calculator");
-
-    // Prepare the command to execute with algorithm choice
-    let command = `"${calculatorExecutable}" -a ${algorithm} -p "${productJsonPath}" "${substancesJsonPath}" "${effectMultipliersJsonPath}" "${substanceRulesJsonPath}" ${
-      maxDepth || 5
-    } -o "${outputJsonPath}"`;
-
-    console.log(`Executing command: ${command}`);
-
     // Track total combinations for better progress reporting
     let totalCombinations = 0;
-    let processedCombinations = 0;
     let currentDepth = 1;
     let startTime = Date.now();
 
     // Track the best mix found so far
     let currentBestMix = null;
 
+    const { jobId, promise } = solverDaemon.solve(
+      {
+        product,
+        substances: req.body.substances,
+        effectMultipliers: req.body.effectMultipliers,
+        substanceRules: req.body.substanceRules,
+        maxDepth: maxDepth || 5,
+        algorithm,
+        topK: req.body.topK,
+        topMaxCost: req.body.topMaxCost,
+        topMaxLength: req.body.topMaxLength,
+        // DFS only: solve depth by depth, and answer with the best mix so far once
+        // deadlineMs have passed
+        anytime: req.body.anytime,
+        deadlineMs: req.body.deadlineMs,
+      },
+      {
+        onProgress: ({ depth, processed, total }) => {
+          currentDepth = depth;
+          totalCombinations = total;
+
+          // Calculate overall progress percentage (0-100)
+          const percentage =
+            total > 0 ? Math.min(100, Math.round((processed / total) * 100)) : 0;
+
+          bfsProgressEmitter.emit("progress", {
+            type: "progress",
+            jobId,
+            depth,
+            processed,
+            total,
+            totalProcessed: processed,
+            grandTotal: total,
+            percentage,
+            executionTime: Date.now() - startTime,
+            message: `Processing depth ${depth}`,
+            bestMix: currentBestMix, // Include current best mix if available
+          });
+        },
+        onBestMix: (message) => {
+          currentBestMix = {
+            mix: message.mixArray,
+            profit: message.profit,
+            sellPrice: message.sellPrice,
+            cost: message.cost,
+          };
+
+          // Emit best mix update
+          bfsProgressEmitter.emit("progress", {
+            type: "update",
+            jobId,
+            bestMix: currentBestMix,
+            executionTime: Date.now() - startTime,
+          });
+        },
+        // Search metrics (nodes/sec, per-depth counts, cache hit rate, pruning and
+        // thread utilization), sampled by the solver; only DFS reports them
+        onMetrics: (metrics) => {
+          bfsProgressEmitter.emit("progress", {
+            type: "metrics",
+            jobId,
+            metrics,
+            executionTime: Date.now() - startTime,
+          });
+        },
+        // Each depth's result of an anytime search, proven optimal when complete
+        onDepthResult: (message) => {
+          bfsProgressEmitter.emit("progress", {
+            type: "depthResult",
+            jobId,
+            depth: message.depth,
+            complete: message.complete,
+            bestMix: {
+              mix: message.mixArray,
+              profit: message.profit,
+              sellPrice: message.sellPrice,
+              cost: message.cost,
+            },
+            executionTime: Date.now() - startTime,
+          });
+        },
+      }
+    );
+
+    console.log(
+      `Queued ${algorithm.toUpperCase()} job ${jobId} for ${product.name} at depth ${
+        maxDepth || 5
+      }`
+    );
+
     // Initialize progress tracking
     bfsProgressEmitter.emit("progress", {
       type: "progress",
+      jobId,
       processed: 0,
       total: 100, // Initial estimate
       depth: 1,
@@ -167,195 +424,74 @@ app.post("/api/mix", async (req, res) => {
       executionTime: 0,
     });
 
-    // Execute the native calculator with increased timeout (20 minutes)
-    const childProcess = exec(command, { timeout: 20 * 60 * 1000 });
-
-    // Handle potential exec errors
-    childProcess.on("error", (error) => {
-      console.error(`Error executing calculator: ${error.message}`);
-      bfsProgressEmitter.emit("progress", {
-        type: "error",
-        message: `Execution error: ${error.message}`,
-      });
-    });
-
-    // Process stdout to extract progress information
-    childProcess.stdout.on("data", (data) => {
-      // console.log(`${algorithm.toUpperCase()} stdout: ${data}`);
-      const dataStr = data.toString();
-
-      // Try to parse progress information - looking for patterns like:
-      // Progress: Depth 3, 456/1000 (45%)
-      const progressMatch = dataStr.match(
-        /Progress: Depth (\d+), (\d+)\/(\d+)/
-      );
-      if (progressMatch) {
-        const depth = parseInt(progressMatch[1], 10);
-        const processed = parseInt(progressMatch[2], 10);
-        const total = parseInt(progressMatch[3], 10);
-
-        // Update our progress tracking
-        currentDepth = depth;
-        processedCombinations = processed;
-
-        // If this is the first time we see this depth, update total
-        if (depth > 1 && totalCombinations === 0) {
-          totalCombinations = total;
-        }
-
-        // Calculate overall progress percentage (0-100)
-        const percentage = Math.min(100, Math.round((processed / total) * 100));
-
-        // Calculate execution time
-        const executionTime = Date.now() - startTime;
-
-        // Periodically send the current best mix, even if it hasn't changed
-        // This gives more frequent UI updates
-        if (currentBestMix && percentage % 5 === 0) {
-          // Use the last known digit of processed number as a simple way to reduce
-          // how often we send updates (avoids flooding the WebSocket)
-          const lastDigit = processed % 10;
-          if (lastDigit === 0) {
-            // console.log(
-            //   "Sending periodic best mix update at progress:",
-            //   percentage + "%"
-            // );
-            // Emit best mix update with currentBestMix
-            bfsProgressEmitter.emit("progress", {
-              type: "update",
-              bestMix: currentBestMix,
-              executionTime,
-              milestone: true, // Mark this as a milestone update rather than a new best mix
-            });
-          }
-        }
-
-        // Emit progress event
-        bfsProgressEmitter.emit("progress", {
-          type: "progress",
-          depth,
-          processed,
-          total,
-          totalProcessed: processedCombinations,
-          grandTotal: totalCombinations,
-          percentage,
-          executionTime,
-          message: `Processing depth ${depth}`,
-          bestMix: currentBestMix, // Include current best mix if available
-        });
-      }
-
-      // Check for best mix found so far
-      // Format: Best mix so far: [mixArray] with profit X
-      const bestMixMatch = dataStr.match(
-        /Best mix so far: \[(.*?)\] with profit (\d+\.?\d*), price (\d+\.?\d*), cost (\d+\.?\d*)/
-      );
-      if (bestMixMatch) {
-        const mixArray = bestMixMatch[1].split(",").map((item) => item.trim());
-        const profit = parseFloat(bestMixMatch[2]);
-        const sellPrice = parseFloat(bestMixMatch[3]);
-        const cost = parseFloat(bestMixMatch[4]);
-
-        // Update current best mix
-        currentBestMix = {
-          mix: mixArray,
-          profit,
-          sellPrice,
-          cost,
-        };
-
-        // Emit best mix update
-        bfsProgressEmitter.emit("progress", {
-          type: "update",
-          bestMix: currentBestMix,
-          executionTime: Date.now() - startTime,
-        });
+    // Stop the search if it runs too long or the client goes away
+    const timeout = setTimeout(() => solverDaemon.cancel(jobId), JOB_TIMEOUT_MS);
+    res.on("close", () => {
+      if (!res.writableFinished) {
+        solverDaemon.cancel(jobId);
       }
     });
 
-    // Process stderr
-    childProcess.stderr.on("data", (data) => {
-      console.log(`${algorithm.toUpperCase()} stderr: ${data}`);
+    let message;
+    try {
+      message = await promise;
+    } catch (error) {
+      console.error(`Job ${jobId} failed: ${error.message}`);
 
-      // Emit error information
+      // Emit error event
       bfsProgressEmitter.emit("progress", {
         type: "error",
-        message: data.toString(),
+        jobId,
+        message: error.message,
       });
-    });
-
-    // Handle completion or error
-    childProcess.on("exit", (code) => {
-      if (code !== 0) {
-        console.error(`Execution error with code: ${code}`);
-
-        // Emit error event
-        bfsProgressEmitter.emit("progress", {
-          type: "error",
-          message: `Process exited with code ${code}`,
-        });
-
-        return res.status(500).json({
-          success: false,
-          error: `Error executing ${algorithm.toUpperCase()} calculator, exit code: ${code}`,
-        });
-      }
-
-      try {
-        // Read and parse the output file
-        if (!fs.existsSync(outputJsonPath)) {
-          throw new Error("Output file not generated");
-        }
 
-        const resultData = fs.readFileSync(outputJsonPath, "utf8");
-        const result = JSON.parse(resultData);
-
-        // Emit a final 100% progress update
-        bfsProgressEmitter.emit("progress", {
-          type: "progress",
-          depth: currentDepth,
-          processed: totalCombinations || 100,
-          total: totalCombinations || 100,
-          totalProcessed: totalCombinations || 100,
-          grandTotal: totalCombinations || 100,
-          percentage: 100,
-          executionTime: Date.now() - startTime,
-          message: "Calculation complete",
-          bestMix: result, // Include final best mix
-        });
+      return res.status(500).json({
+        success: false,
+        error: `Error executing ${algorithm.toUpperCase()} calculator: ${error.message}`,
+      });
+    } finally {
+      clearTimeout(timeout);
+    }
 
-        // Emit completion event
-        bfsProgressEmitter.emit("progress", {
-          type: "done",
-          result,
-        });
+    const result = {
+      mixArray: message.mixArray,
+      profit: message.profit,
+      sellPrice: message.sellPrice,
+      cost: message.cost,
+      topMixes: message.topMixes,
+      cancelled: message.cancelled,
+      deadlineReached: message.deadlineReached,
+    };
 
-        // Send the result back to the client
-        res.json({
-          success: true,
-          result,
-        });
+    // Emit a final 100% progress update
+    bfsProgressEmitter.emit("progress", {
+      type: "progress",
+      jobId,
+      depth: currentDepth,
+      processed: totalCombinations || 100,
+      total: totalCombinations || 100,
+      totalProcessed: totalCombinations || 100,
+      grandTotal: totalCombinations || 100,
+      percentage: 100,
+      executionTime: Date.now() - startTime,
+      message: message.cancelled
+        ? "Calculation cancelled"
+        : "Calculation complete",
+      bestMix: result, // Include final best mix
+    });
 
-        // Clean up temp files
-        // fs.unlinkSync(productJsonPath);
-        // fs.unlinkSync(substancesJsonPath);
-        // fs.unlinkSync(effectMultipliersJsonPath);
-        // fs.unlinkSync(substanceRulesJsonPath);
-        // fs.unlinkSync(outputJsonPath);
-      } catch (parseError) {
-        console.error(`Error parsing result: ${parseError}`);
-
-        // Emit error event
-        bfsProgressEmitter.emit("progress", {
-          type: "error",
-          message: parseError.message,
-        });
+    // Emit completion event
+    bfsProgressEmitter.emit("progress", {
+      type: "done",
+      jobId,
+      result,
+    });
 
-        res.status(500).json({
-          success: false,
-          error: `Error parsing result: ${parseError.message}`,
-        });
-      }
+    // Send the result back to the client
+    res.json({
+      success: true,
+      jobId,
+      result,
     });
   } catch (error) {
     console.error(`Server error: ${error}`);
@@ -373,6 +509,12 @@ app.post("/api/mix", async (req, res) => {
   }
 });
 
+// Cancel a running or queued job; the job's request completes with its best mix so far
+app.post("/api/mix/cancel", (req, res) => {
+  const jobId = Number(req.body.jobId);
+  res.json({ success: solverDaemon.cancel(jobId) });
+});
+
 // Keep the old /api/bfs endpoint for backward compatibility
 app.post("/api/bfs", async (req, res) => {
   // Force the algorithm to be BFS and delegate to the new endpoint
@@ -15,6 +15,7 @@ export interface ProgressData {
   message?: string;
   algorithm?: string; // Add algorithm type for display
   forceUpdate?: boolean; // Integrate force update into the data object
+  etaSeconds?: number; // Engine's own estimate of the time left, -1 if it has none yet
 }
 
 // Define a consistent implementation type
@@ -25,22 +26,70 @@ export type ImplementationType =
   | "native-bfs" // Native BFS
   | "native-dfs"; // Native DFS
 
+// Time constant of the measured throughput average
+const THROUGHPUT_SMOOTHING_MS = 5000;
+
+// Smoothed rate of each implementation's progress, measured between updates
+const throughputTrackers = new Map<
+  ImplementationType,
+  { time: number; processed: number; rate: number }
+>();
+
+// Rate at which `processed` grows, as an exponential moving average over a few seconds.
+// A count going backwards starts a new measurement
+function measureThroughput(
+  implementation: ImplementationType,
+  processed: number,
+  currentTime: number
+): number {
+  const tracker = throughputTrackers.get(implementation);
+  if (!tracker || processed < tracker.processed) {
+    throughputTrackers.set(implementation, {
+      time: currentTime,
+      processed,
+      rate: -1,
+    });
+    return -1;
+  }
+
+  const interval = currentTime - tracker.time;
+  if (interval <= 0) return tracker.rate;
+
+  const sampleRate = (processed - tracker.processed) / interval;
+  const weight = 1 - Math.exp(-interval / THROUGHPUT_SMOOTHING_MS);
+  tracker.rate =
+    tracker.rate < 0
+      ? sampleRate
+      : tracker.rate + weight * (sampleRate - tracker.rate);
+  tracker.time = currentTime;
+  tracker.processed = processed;
+  return tracker.rate;
+}
+
+// Remaining time from the engine's estimate when it reports one, else from the measured
+// throughput. Engines that prune count skipped mixes as processed, so either stays
+// meaningful whatever the search skips
 function calculateRemainingTimeAndFinishTime(
+  implementation: ImplementationType,
   processed: number,
   total: number,
-  executionTime: number
+  etaSeconds: number | undefined,
+  currentTime: number
 ) {
   const percentage = Math.min(
     100,
     Math.round((processed / Math.max(1, total)) * 100)
   );
+  const rate = measureThroughput(implementation, processed, currentTime);
   let remainingTime = 0;
-  if (percentage > 0 && percentage < 100) {
-    remainingTime = Math.round(
-      (executionTime / percentage) * (100 - percentage)
-    );
+  if (processed < total) {
+    if (etaSeconds !== undefined && etaSeconds >= 0) {
+      remainingTime = Math.round(etaSeconds * 1000);
+    } else if (rate > 0) {
+      remainingTime = Math.round((total - processed) / rate);
+    }
   }
-  const estimatedFinishTime = Date.now() + remainingTime;
+  const estimatedFinishTime = currentTime + remainingTime;
   return { percentage, remainingTime, estimatedFinishTime };
 }
 
@@ -77,7 +126,13 @@ export function updateProgressDisplay(
   const { processed, total, depth, executionTime, message, algorithm } =
     progressData;
   const { percentage, remainingTime, estimatedFinishTime } =
-    calculateRemainingTimeAndFinishTime(processed, total, executionTime);
+    calculateRemainingTimeAndFinishTime(
+      implementation,
+      processed,
+      total,
+      progressData.etaSeconds,
+      currentTime
+    );
 
   // Determine display title based on implementation
   const implParts = implementation.split("-");
@@ -8,7 +8,7 @@ import {
 } from "@/bfsProgress";
 import { MAX_RECIPE_DEPTH } from "../bfsCommon";
 import { createBestMixDisplay } from "../bfsMixDisplay";
-import { ProductVariety, effects } from "../substances";
+import { ProductVariety, effects, getBasePrice } from "../substances";
 import {
   prepareEffectMultipliersForWasm,
   prepareSubstanceRulesForWasm,
@@ -22,6 +22,7 @@ export class NativeAlgorithmController extends AlgorithmController {
   protected totalProcessed = 0;
   protected grandTotal = 1; // Start with 1 to avoid division by zero
   protected lastUpdate = 0;
+  protected etaSeconds: number | undefined; // From the latest metrics sample, DFS only
 
   constructor(algorithm: string) {
     super("native", algorithm);
@@ -32,6 +33,7 @@ export class NativeAlgorithmController extends AlgorithmController {
     this.running = true;
     this.totalProcessed = 0;
     this.grandTotal = 1;
+    this.etaSeconds = undefined;
     this.lastUpdate = 0;
 
     // Initialize WebSocket connection
@@ -65,6 +67,7 @@ export class NativeAlgorithmController extends AlgorithmController {
       const productJson = {
         name: product.name,
         initialEffect: product.initialEffect,
+        basePrice: getBasePrice(product.name),
       };
 
       // Get data in the same format as we use for WASM
@@ -230,6 +233,7 @@ export class NativeAlgorithmController extends AlgorithmController {
             executionTime,
             message: data.message || `Processing depth ${data.depth || 1}`,
             algorithm: this.algorithm.toUpperCase(),
+            etaSeconds: this.etaSeconds,
           };
 
           this.updateProgressDisplay(progressData);
@@ -239,6 +243,10 @@ export class NativeAlgorithmController extends AlgorithmController {
             this.bestMix = data.bestMix;
             this.updateBestMixDisplay();
           }
+        } else if (data.type === "metrics") {
+          // The solver's time left, from the throughput it measured over the
+          // mixes it evaluated or skipped
+          this.etaSeconds = data.metrics?.etaSeconds;
         } else if (data.type === "update") {
           // Handle best mix update
           if (data.bestMix && data.bestMix.profit > this.bestMix.profit) {
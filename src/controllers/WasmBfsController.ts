@@ -3,10 +3,15 @@
 
 import { MAX_RECIPE_DEPTH } from "../bfsCommon";
 import { ProductVariety } from "../substances";
+import { createCancelBuffer } from "../wasmLoader";
 import { AlgorithmController } from "./AlgorithmController";
 
 export class WasmBfsController extends AlgorithmController {
   private worker: Worker | null = null;
+  // Flag shared with the worker that stops its search (null if the page can't share memory)
+  private cancelBuffer: SharedArrayBuffer | null = null;
+  // Whether the running search was asked to stop and is finishing with its best mix so far
+  private cancelling = false;
   private totalProcessedCombinations = 0;
   private totalCombinations = 0;
 
@@ -20,6 +25,14 @@ export class WasmBfsController extends AlgorithmController {
     this.totalProcessedCombinations = 0;
     this.totalCombinations = 0;
 
+    // A cancelled search that is still finishing isn't waited for
+    if (this.worker) {
+      this.worker.terminate();
+      this.worker = null;
+    }
+    this.cancelBuffer = createCancelBuffer();
+    this.cancelling = false;
+
     // Create worker
     const worker = new Worker(new URL("../wasmBfsWorker.ts", import.meta.url), {
       type: "module",
@@ -36,6 +49,7 @@ export class WasmBfsController extends AlgorithmController {
         product: { ...product },
         bestMix: this.bestMix,
         maxDepth: MAX_RECIPE_DEPTH,
+        cancelBuffer: this.cancelBuffer,
       },
     });
 
@@ -45,7 +59,11 @@ export class WasmBfsController extends AlgorithmController {
 
   // Stop the WASM BFS algorithm
   protected stop(): void {
-    if (this.worker) {
+    if (this.worker && this.cancelBuffer) {
+      // Let the search stop itself, so its best mix so far still arrives with "done"
+      Atomics.store(new Int32Array(this.cancelBuffer), 0, 1);
+      this.cancelling = true;
+    } else if (this.worker) {
       this.worker.terminate();
       this.worker = null;
     }
@@ -90,8 +108,8 @@ export class WasmBfsController extends AlgorithmController {
           progress = event.data.progress;
         }
 
-        // Force progress to 100% if we're done
-        if (event.data.isFinal) {
+        // Force progress to 100% if we're done, unless the search was cancelled
+        if (event.data.isFinal && !this.cancelling) {
           progress = 100;
           // Ensure processed equals total for the final update
           this.totalProcessedCombinations = this.totalCombinations;
@@ -107,6 +125,18 @@ export class WasmBfsController extends AlgorithmController {
           },
           event.data.isFinal
         );
+      } else if (type === "done" && this.cancelling) {
+        // A cancelled search only covered part of the space
+        this.updateProgressDisplay(
+          {
+            processed: this.totalProcessedCombinations,
+            total: this.totalCombinations || 100,
+            message: "Calculation canceled",
+          },
+          true
+        );
+        this.cancelling = false;
+        this.worker = null;
       } else if (type === "done") {
         // When the calculation is complete, make sure we show 100% progress
         // Ensure processed equals total
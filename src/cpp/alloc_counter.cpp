@@ -0,0 +1,37 @@
+#include "alloc_counter.h"
+
+#ifdef BFS_COUNT_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<int64_t> g_heapAllocations(0);
+
+// Counting replacements for the global allocation functions
+static void *countedAllocate(std::size_t size)
+{
+  g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *pointer = std::malloc(size ? size : 1))
+  {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size) { return countedAllocate(size); }
+void *operator new[](std::size_t size) { return countedAllocate(size); }
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, std::size_t) noexcept { std::free(pointer); }
+
+int64_t heapAllocationCount()
+{
+  return g_heapAllocations.load(std::memory_order_relaxed);
+}
+#else
+int64_t heapAllocationCount()
+{
+  return -1;
+}
+#endif
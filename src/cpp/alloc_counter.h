@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+// Number of heap allocations made so far through operator new, or -1 when the build
+// doesn't count them (configure with -DBFS_COUNT_ALLOCATIONS=ON to enable)
+int64_t heapAllocationCount();
@@ -0,0 +1,178 @@
+#include "batch.h"
+#include "bfs_algorithm.h"
+#include "dfs_algorithm.h"
+#include "dp_algorithm.h"
+#include "json_parser.h"
+#include "state_table.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+// Ordered, so result fields keep the calculator's order
+using json = nlohmann::ordered_json;
+
+// External console mutex declaration (defined in dfs_algorithm.cpp)
+extern std::mutex g_consoleMutex;
+
+std::vector<BatchJob> parseBatchJobsJson(const std::string &batchJson, const std::string &defaultAlgorithm)
+{
+  json doc = json::parse(batchJson);
+  if (!doc.is_array())
+    throw std::runtime_error("Batch must be a JSON array of jobs");
+
+  std::vector<BatchJob> jobs;
+  jobs.reserve(doc.size());
+  for (size_t i = 0; i < doc.size(); ++i)
+  {
+    const json &entry = doc[i];
+    const json &product = entry.at("product");
+
+    BatchJob job;
+    job.product = parseProductJson(product.dump());
+    job.maxDepth = entry.value("maxDepth", product.value("maxDepth", 5));
+    job.algorithm = entry.value("algorithm", defaultAlgorithm);
+
+    if (job.maxDepth < 1 || job.maxDepth > static_cast<int>(MAX_MIX_LENGTH))
+      throw std::runtime_error("Batch job " + std::to_string(i) + ": maxDepth must be between 1 and " +
+                               std::to_string(MAX_MIX_LENGTH));
+    if (job.algorithm != "bfs" && job.algorithm != "dfs" && job.algorithm != "dp")
+      throw std::runtime_error("Batch job " + std::to_string(i) + ": unknown algorithm " + job.algorithm);
+    jobs.push_back(job);
+  }
+  return jobs;
+}
+
+// Fields of a result, shared by the batch entry and its top list
+static json mixJson(const std::vector<std::string> &mixArray, int profitCents, int sellPriceCents, int costCents)
+{
+  return json{{"mixArray", mixArray},
+              {"profit", profitCents / 100.0},
+              {"sellPrice", sellPriceCents / 100.0},
+              {"cost", costCents / 100.0}};
+}
+
+static json resultJson(const BatchJob &job, const JsBestMixResult &result, bool complete, double elapsedSeconds)
+{
+  json entry{{"product", job.product.name}, {"maxDepth", job.maxDepth}, {"algorithm", job.algorithm}};
+  entry.update(mixJson(result.mixArray, result.profitCents, result.sellPriceCents, result.costCents));
+
+  json topMixes = json::array();
+  for (const RankedMixResult &ranked : result.topMixes)
+  {
+    topMixes.push_back(mixJson(ranked.mixArray, ranked.profitCents, ranked.sellPriceCents, ranked.costCents));
+  }
+  entry["topMixes"] = topMixes;
+  entry["complete"] = complete;
+  entry["elapsedSeconds"] = elapsedSeconds;
+  return entry;
+}
+
+std::string runBatch(
+    const std::vector<BatchJob> &jobs,
+    const Dataset &dataset,
+    const SearchOptions &options,
+    bool useHashingOptimization)
+{
+  auto batchStart = std::chrono::steady_clock::now();
+
+  // Jobs of a batch would all write the same checkpoint file
+  SearchOptions jobOptions = options;
+  jobOptions.checkpointFile.clear();
+
+  // One transition table for every DFS job. It's compiled for the first DFS job's product,
+  // and later products reuse it whenever their effect IDs come out the same, which holds
+  // when their initial effects are among the multiplier names
+  std::unique_ptr<CompiledEffects> sharedCompiled;
+  std::unique_ptr<TransitionTable> sharedTransitions;
+  auto firstDFSJob = std::find_if(jobs.begin(), jobs.end(), [](const BatchJob &job)
+                                  { return job.algorithm == "dfs"; });
+  if (useHashingOptimization && firstDFSJob != jobs.end())
+  {
+    sharedCompiled.reset(new CompiledEffects(
+        compileEffects(firstDFSJob->product, dataset.substances, dataset.effectMultipliers)));
+    if (sharedCompiled->valid)
+    {
+      sharedTransitions.reset(new TransitionTable(*sharedCompiled, options.transitionTableStates));
+      jobOptions.sharedTransitions = sharedTransitions.get();
+    }
+  }
+
+  std::vector<json> results(jobs.size());
+  auto runJob = [&](size_t index)
+  {
+    const BatchJob &job = jobs[index];
+    auto start = std::chrono::steady_clock::now();
+    JsBestMixResult result;
+    if (job.algorithm == "dfs")
+    {
+      result = findBestMixDFS(job.product, dataset.substances, dataset.effectMultipliers, job.maxDepth,
+                              nullptr, useHashingOptimization, jobOptions);
+    }
+    else if (job.algorithm == "dp")
+    {
+      result = findBestMixDP(job.product, dataset.substances, dataset.effectMultipliers, job.maxDepth,
+                             nullptr, jobOptions);
+    }
+    else
+    {
+      result = findBestMix(job.product, dataset.substances, dataset.effectMultipliers, job.maxDepth,
+                           nullptr, jobOptions);
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    results[index] = resultJson(job, result, !g_shouldTerminate, elapsed);
+  };
+
+  // Whole-machine searches first, one at a time
+  std::vector<size_t> dpJobs;
+  for (size_t i = 0; i < jobs.size(); ++i)
+  {
+    if (jobs[i].algorithm == "dp")
+    {
+      dpJobs.push_back(i);
+      continue;
+    }
+    runJob(i);
+  }
+
+  // Then the DP jobs, each on its own worker
+  int threadCount = options.threads > 0 ? options.threads : static_cast<int>(std::thread::hardware_concurrency());
+  threadCount = std::max(1, std::min(threadCount, static_cast<int>(dpJobs.size())));
+  std::atomic<size_t> nextDPJob(0);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threadCount && !dpJobs.empty(); ++t)
+  {
+    workers.emplace_back(
+        [&]()
+        {
+          size_t next;
+          while ((next = nextDPJob.fetch_add(1)) < dpJobs.size())
+          {
+            runJob(dpJobs[next]);
+          }
+        });
+  }
+  for (std::thread &worker : workers)
+  {
+    worker.join();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(g_consoleMutex);
+    std::cout << "Batch of " << jobs.size() << " jobs solved in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count() << " s";
+    if (sharedTransitions)
+    {
+      std::cout << ", shared transition table: " << sharedTransitions->stateCount() << "/"
+                << sharedTransitions->capacity() << " states";
+    }
+    std::cout << std::endl;
+  }
+
+  return json(results).dump(2);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "types.h"
+#include "dataset.h"
+#include <string>
+#include <vector>
+
+// One search of a batch
+struct BatchJob
+{
+  Product product;
+  int maxDepth;
+  std::string algorithm; // "bfs", "dfs" or "dp"
+};
+
+// Parse a batch from a JSON array of {"product", "maxDepth", "algorithm"} objects.
+// "maxDepth" falls back to the product's own maxDepth and then 5; "algorithm" falls back
+// to defaultAlgorithm. Throws std::runtime_error for invalid entries
+std::vector<BatchJob> parseBatchJobsJson(const std::string &batchJson, const std::string &defaultAlgorithm);
+
+// Solve every job against one dataset and return a JSON array with one result per job,
+// in job order. The dataset is parsed once for the whole batch, and DFS jobs share one
+// transition table, since effect IDs and rules don't depend on the product. DP jobs are
+// single-threaded and independent, so they run concurrently on options.threads workers;
+// DFS and BFS jobs already use every thread and share process-wide search state, so they
+// run one after another
+std::string runBatch(
+    const std::vector<BatchJob> &jobs,
+    const Dataset &dataset,
+    const SearchOptions &options,
+    bool useHashingOptimization);
@@ -0,0 +1,438 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+#include "types.h"
+#include "bfs_algorithm.h"
+#include "dfs_algorithm.h"
+#include "dp_algorithm.h"
+#include "json_parser.h"
+#include "alloc_counter.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using json = nlohmann::ordered_json;
+
+// Benchmark harness: runs every engine over the fixtures in bench/ across a depth x
+// thread count matrix and prints one JSON document, so builds can be compared run to run.
+// Also checks that all engines agree on the best profit for each product and depth, and,
+// given a baseline report, that no run got slower than the tolerance allows
+
+#ifndef BFS_BENCH_FIXTURES_DIR
+#define BFS_BENCH_FIXTURES_DIR "bench"
+#endif
+
+// One engine configuration of the matrix
+struct BenchEngine
+{
+  const char *name;
+  const char *algorithm; // bfs, dfs or dp
+  bool hashing;
+  bool pruning;
+  bool dominance;
+};
+
+static const BenchEngine BENCH_ENGINES[] = {
+    {"bfs", "bfs", true, false, false},
+    {"dfs", "dfs", true, false, false},
+    {"dfs-no-hashing", "dfs", false, false, false},
+    {"dfs-prune", "dfs", true, true, false},
+    {"dfs-dominance", "dfs", true, false, true},
+    {"dp", "dp", true, false, false},
+};
+
+// Discards the engines' log output while they run
+class NullBuffer : public std::streambuf
+{
+protected:
+  int overflow(int c) override { return traits_type::not_eof(c); }
+  std::streamsize xsputn(const char *, std::streamsize count) override { return count; }
+};
+
+static void printUsage(const char *programName)
+{
+  std::cerr << "Usage: " << programName << " [options]\n"
+            << "Options:\n"
+            << "  --fixtures DIR   Directory with substances.json, effects.json, rules.json and\n"
+            << "                   products.json (default " << BFS_BENCH_FIXTURES_DIR << ")\n"
+            << "  --depths LIST    Comma-separated search depths (default 4,5,6)\n"
+            << "  --threads LIST   Comma-separated worker thread counts (default 1 and hardware concurrency)\n"
+            << "  --engines LIST   Comma-separated engines (default all: bfs, dfs, dfs-no-hashing,\n"
+            << "                   dfs-prune, dfs-dominance, dp)\n"
+            << "  --products LIST  Comma-separated product names (default all in products.json)\n"
+            << "  --repeat N       Time each run N times and keep the fastest (default 1)\n"
+            << "  --baseline F     Fail when a run's nodes/sec is more than the tolerance below the\n"
+            << "                   same run in the report F\n"
+            << "  --tolerance P    Largest nodes/sec drop from the baseline, in percent (default 10)\n"
+            << "  -o, --output F   Write the JSON report to F instead of stdout\n"
+            << "  -h, --help       Show this help message" << std::endl;
+}
+
+static std::vector<std::string> splitList(const std::string &list)
+{
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ','))
+  {
+    if (!item.empty())
+      items.push_back(item);
+  }
+  return items;
+}
+
+static std::vector<int> parseIntList(const std::string &list)
+{
+  std::vector<int> values;
+  for (const std::string &item : splitList(list))
+  {
+    values.push_back(std::stoi(item));
+  }
+  return values;
+}
+
+static std::string readFile(const std::string &path)
+{
+  std::ifstream file(path);
+  if (!file)
+  {
+    throw std::runtime_error("could not open " + path);
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+// Start a new peak RSS measurement (Linux resets the high-water mark of the process)
+static void resetPeakRss()
+{
+#ifdef __linux__
+  std::ofstream clearRefs("/proc/self/clear_refs");
+  clearRefs << "5";
+#endif
+}
+
+// Peak resident set size in KiB since resetPeakRss, or since process start where the
+// high-water mark can't be reset. -1 when unavailable
+static int64_t peakRssKiB()
+{
+#ifdef __linux__
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line))
+  {
+    if (line.compare(0, 6, "VmHWM:") == 0)
+    {
+      return std::stoll(line.substr(6));
+    }
+  }
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+  {
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // Bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+  }
+#endif
+  return -1;
+}
+
+// Number of mixes of length 1 to maxDepth, the search space every engine covers
+static int64_t searchSpaceSize(size_t substanceCount, int maxDepth)
+{
+  int64_t total = 0;
+  for (int depth = 1; depth <= maxDepth; ++depth)
+  {
+    total += static_cast<int64_t>(std::pow(static_cast<double>(substanceCount), depth));
+  }
+  return total;
+}
+
+// Runs of a report, keyed by product, depth, engine and thread count
+static std::string runKey(const json &run)
+{
+  return run.at("product").get<std::string>() + "/" + std::to_string(run.at("depth").get<int>()) + "/" +
+         run.at("engine").get<std::string>() + "/" + std::to_string(run.at("threads").get<int>());
+}
+
+static JsBestMixResult runEngine(const BenchEngine &engine, const Product &product,
+                                 const std::vector<Substance> &substances,
+                                 const std::unordered_map<std::string, int> &effectMultipliers,
+                                 int maxDepth, const SearchOptions &options)
+{
+  std::string algorithm = engine.algorithm;
+  if (algorithm == "dfs")
+    return findBestMixDFS(product, substances, effectMultipliers, maxDepth, nullptr, engine.hashing, options);
+  if (algorithm == "dp")
+    return findBestMixDP(product, substances, effectMultipliers, maxDepth, nullptr, options);
+  return findBestMix(product, substances, effectMultipliers, maxDepth, nullptr, options);
+}
+
+int main(int argc, char *argv[])
+{
+  std::string fixturesDir = BFS_BENCH_FIXTURES_DIR;
+  std::string outputFile;
+  std::vector<int> depths = {4, 5, 6};
+  std::vector<int> threadCounts = {1, static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))};
+  std::vector<std::string> engineNames;
+  std::vector<std::string> productNames;
+  int repeat = 1;
+  std::string baselineFile;
+  double tolerancePercent = 10.0;
+
+  try
+  {
+    for (int i = 1; i < argc; ++i)
+    {
+      std::string arg = argv[i];
+      bool hasValue = i + 1 < argc;
+      if (arg == "-h" || arg == "--help")
+      {
+        printUsage(argv[0]);
+        return 0;
+      }
+      else if (arg == "--fixtures" && hasValue)
+      {
+        fixturesDir = argv[++i];
+      }
+      else if (arg == "--depths" && hasValue)
+      {
+        depths = parseIntList(argv[++i]);
+      }
+      else if (arg == "--threads" && hasValue)
+      {
+        threadCounts = parseIntList(argv[++i]);
+      }
+      else if (arg == "--engines" && hasValue)
+      {
+        engineNames = splitList(argv[++i]);
+      }
+      else if (arg == "--products" && hasValue)
+      {
+        productNames = splitList(argv[++i]);
+      }
+      else if (arg == "--repeat" && hasValue)
+      {
+        repeat = std::max(1, std::stoi(argv[++i]));
+      }
+      else if (arg == "--baseline" && hasValue)
+      {
+        baselineFile = argv[++i];
+      }
+      else if (arg == "--tolerance" && hasValue)
+      {
+        tolerancePercent = std::stod(argv[++i]);
+      }
+      else if ((arg == "-o" || arg == "--output") && hasValue)
+      {
+        outputFile = argv[++i];
+      }
+      else
+      {
+        std::cerr << "Error: unknown or incomplete option " << arg << std::endl;
+        printUsage(argv[0]);
+        return 1;
+      }
+    }
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "Error: invalid option value: " << e.what() << std::endl;
+    return 1;
+  }
+
+  // Drop duplicate thread counts, e.g. on single-core machines
+  std::sort(threadCounts.begin(), threadCounts.end());
+  threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+  std::vector<const BenchEngine *> engines;
+  for (const BenchEngine &engine : BENCH_ENGINES)
+  {
+    if (engineNames.empty() || std::find(engineNames.begin(), engineNames.end(), engine.name) != engineNames.end())
+      engines.push_back(&engine);
+  }
+  if (engines.empty())
+  {
+    std::cerr << "Error: no known engines selected" << std::endl;
+    return 1;
+  }
+
+  // Load the fixtures once; every run shares the parsed data
+  std::vector<Substance> substances;
+  std::unordered_map<std::string, int> effectMultipliers;
+  std::vector<Product> products;
+  try
+  {
+    substances = parseSubstancesJson(readFile(fixturesDir + "/substances.json"));
+    effectMultipliers = parseEffectMultipliersJson(readFile(fixturesDir + "/effects.json"));
+    applySubstanceRulesJson(substances, readFile(fixturesDir + "/rules.json"));
+
+    for (const auto &entry : nlohmann::json::parse(readFile(fixturesDir + "/products.json")))
+    {
+      Product product = parseProductJson(entry.dump());
+      if (productNames.empty() || std::find(productNames.begin(), productNames.end(), product.name) != productNames.end())
+        products.push_back(product);
+    }
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "Error loading fixtures from " << fixturesDir << ": " << e.what() << std::endl;
+    return 1;
+  }
+
+  // Throughput of every run of the baseline report
+  std::unordered_map<std::string, double> baselineRates;
+  if (!baselineFile.empty())
+  {
+    try
+    {
+      json baseline = json::parse(readFile(baselineFile));
+      for (const json &run : baseline.at("runs"))
+      {
+        baselineRates[runKey(run)] = run.at("nodesPerSecond").get<double>();
+      }
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << "Error loading the baseline " << baselineFile << ": " << e.what() << std::endl;
+      return 1;
+    }
+  }
+
+  json report;
+  report["substances"] = substances.size();
+  report["hardwareConcurrency"] = std::thread::hardware_concurrency();
+  report["allocationsCounted"] = heapAllocationCount() >= 0;
+  report["runs"] = json::array();
+  report["checks"] = json::array();
+  report["regressions"] = json::array();
+  bool allAgree = true;
+
+  // Keep the engines' logging out of the report
+  NullBuffer nullBuffer;
+  std::streambuf *coutBuffer = std::cout.rdbuf(&nullBuffer);
+
+  for (const Product &product : products)
+  {
+    for (int depth : depths)
+    {
+      json check;
+      check["product"] = product.name;
+      check["depth"] = depth;
+      check["profits"] = json::object();
+      bool haveProfit = false;
+      int expectedProfitCents = 0;
+      bool agree = true;
+
+      for (const BenchEngine *engine : engines)
+      {
+        for (int threads : threadCounts)
+        {
+          SearchOptions options;
+          options.threads = threads;
+          options.pruning = engine->pruning;
+          options.dominance = engine->dominance;
+
+          std::cerr << product.name << " depth " << depth << ": " << engine->name
+                    << " on " << threads << " threads" << std::endl;
+
+          // The fastest of the repeats is the least disturbed by the rest of the machine
+          JsBestMixResult result;
+          double seconds = 0.0;
+          int64_t allocations = -1;
+          for (int attempt = 0; attempt < repeat; ++attempt)
+          {
+            resetPeakRss();
+            int64_t allocationsBefore = heapAllocationCount();
+            auto start = std::chrono::steady_clock::now();
+            result = runEngine(*engine, product, substances, effectMultipliers, depth, options);
+            double attemptSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            allocations = allocationsBefore >= 0 ? heapAllocationCount() - allocationsBefore : -1;
+            seconds = attempt == 0 ? attemptSeconds : std::min(seconds, attemptSeconds);
+          }
+          int64_t nodes = searchSpaceSize(substances.size(), depth);
+
+          json run;
+          run["product"] = product.name;
+          run["depth"] = depth;
+          run["engine"] = engine->name;
+          run["threads"] = threads;
+          run["seconds"] = seconds;
+          run["nodes"] = nodes;
+          run["nodesPerSecond"] = seconds > 0 ? nodes / seconds : 0.0;
+          run["peakRssKiB"] = peakRssKiB();
+          run["allocations"] = allocations;
+          run["profitCents"] = result.profitCents;
+          run["mixArray"] = result.mixArray;
+          report["runs"].push_back(run);
+
+          auto baseline = baselineRates.find(runKey(run));
+          if (baseline != baselineRates.end() && baseline->second > 0)
+          {
+            double changePercent = 100.0 * (run["nodesPerSecond"].get<double>() / baseline->second - 1.0);
+            if (changePercent < -tolerancePercent)
+            {
+              std::cerr << "REGRESSION: " << runKey(run) << " nodes/sec dropped " << -changePercent
+                        << "% below the baseline" << std::endl;
+              report["regressions"].push_back({{"run", runKey(run)},
+                                               {"nodesPerSecond", run["nodesPerSecond"]},
+                                               {"baselineNodesPerSecond", baseline->second},
+                                               {"changePercent", changePercent}});
+            }
+          }
+
+          check["profits"][std::string(engine->name) + "/" + std::to_string(threads)] = result.profitCents;
+          if (!haveProfit)
+          {
+            expectedProfitCents = result.profitCents;
+            haveProfit = true;
+          }
+          agree = agree && result.profitCents == expectedProfitCents;
+        }
+      }
+
+      check["agree"] = agree;
+      report["checks"].push_back(check);
+      if (!agree)
+      {
+        std::cerr << "MISMATCH: engines disagree on the best profit for " << product.name
+                  << " at depth " << depth << std::endl;
+        allAgree = false;
+      }
+    }
+  }
+
+  std::cout.rdbuf(coutBuffer);
+  report["allAgree"] = allAgree;
+  bool regressed = !report["regressions"].empty();
+
+  if (outputFile.empty())
+  {
+    std::cout << report.dump(2) << std::endl;
+  }
+  else
+  {
+    std::ofstream out(outputFile);
+    if (!out)
+    {
+      std::cerr << "Error: Could not open output file: " << outputFile << std::endl;
+      return 1;
+    }
+    out << report.dump(2) << std::endl;
+  }
+
+  return allAgree && !regressed ? 0 : 1;
+}
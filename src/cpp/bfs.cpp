@@ -2,6 +2,7 @@
 #include <vector>
 #include <cmath>
 #include <memory>
+#include <algorithm>
 
 #include "types.h"
 #include "effects.h"
@@ -56,11 +57,14 @@ JsBestMixResult findBestMixJsonWithProgress(
   std::unordered_map<std::string, int> effectMultipliers = parseEffectMultipliersJson(effectMultipliersJson);
   applySubstanceRulesJson(substances, substanceRulesJson);
 
-  // Run the BFS algorithm with progress reporting if enabled
+  // Run the BFS algorithm with progress reporting if enabled. The progress callback can
+  // stop it through cancelSearch()
 #ifdef __EMSCRIPTEN__
   if (reportProgress)
   {
-    return findBestMix(product, substances, effectMultipliers, maxDepth, reportProgressToJS);
+    SearchOptions options;
+    options.cancellation = startCancellableSearch();
+    return findBestMix(product, substances, effectMultipliers, maxDepth, reportProgressToJS, options);
   }
   else
 #else
@@ -77,6 +81,58 @@ JsBestMixResult findBestMixJsonWithProgress(
   }
 }
 
+// Parse JSON input and run BFS under the constraints in constraintsJson (see
+// parseSearchConstraintsJson), also returning the topK best mixes with distinct effect sets
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+JsBestMixResult findBestMixJsonConstrained(
+    std::string productJson,
+    std::string substancesJson,
+    std::string effectMultipliersJson,
+    std::string substanceRulesJson,
+    int maxDepth,
+    bool reportProgress,
+    int topK,
+    std::string constraintsJson)
+{
+  Product product = parseProductJson(productJson);
+  std::vector<Substance> substances = parseSubstancesJson(substancesJson);
+  std::unordered_map<std::string, int> effectMultipliers = parseEffectMultipliersJson(effectMultipliersJson);
+  applySubstanceRulesJson(substances, substanceRulesJson);
+
+  SearchOptions options;
+  options.topK = static_cast<size_t>(std::max(1, topK));
+  options.constraints = parseSearchConstraintsJson(constraintsJson);
+
+#ifdef __EMSCRIPTEN__
+  options.cancellation = startCancellableSearch();
+  ProgressCallback progressCallback = reportProgress ? ProgressCallback(reportProgressToJS) : ProgressCallback();
+#else
+  extern void reportProgressToConsole(int depth, int64_t processed, int64_t total);
+  ProgressCallback progressCallback = reportProgress ? ProgressCallback(reportProgressToConsole) : ProgressCallback();
+#endif
+  return findBestMix(product, substances, effectMultipliers, maxDepth, progressCallback, options);
+}
+
+// Parse JSON input and run BFS, also returning the topK best mixes with distinct effect sets
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+JsBestMixResult findBestMixJsonTopK(
+    std::string productJson,
+    std::string substancesJson,
+    std::string effectMultipliersJson,
+    std::string substanceRulesJson,
+    int maxDepth,
+    bool reportProgress,
+    int topK)
+{
+  return findBestMixJsonConstrained(
+      productJson, substancesJson, effectMultipliersJson, substanceRulesJson,
+      maxDepth, reportProgress, topK, "");
+}
+
 // Helper function that returns just the mix array directly
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
@@ -103,12 +159,18 @@ EMSCRIPTEN_BINDINGS(bfs_module)
       // Keep the legacy dollar-based fields for backward compatibility
       .field("profit", &JsBestMixResult::profit)
       .field("sellPrice", &JsBestMixResult::sellPrice)
-      .field("cost", &JsBestMixResult::cost);
+      .field("cost", &JsBestMixResult::cost)
+      .field("topMixes", &JsBestMixResult::topMixes);
 
   register_vector<std::string>("VectorString");
 
   function("getMixArray", &getMixArray);
   function("findBestMixJson", &findBestMixJson);
   function("findBestMixJsonWithProgress", &findBestMixJsonWithProgress);
+  function("findBestMixJsonTopK", &findBestMixJsonTopK);
+  function("findBestMixJsonConstrained", &findBestMixJsonConstrained);
+
+  // Stops the running search of any engine, which then returns its best mix so far
+  function("cancelSearch", &cancelSearch);
 }
 #endif
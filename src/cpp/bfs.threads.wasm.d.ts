@@ -0,0 +1,4 @@
+// The threaded build exports the same module as the single-threaded one
+import ModuleFactory from "./bfs.wasm";
+
+export default ModuleFactory;
@@ -2,6 +2,14 @@
  * Type definitions for Emscripten-generated WebAssembly module
  */
 
+// One entry of a top-K result list
+interface WasmRankedMix {
+  mixArray: string[];
+  profit: number;
+  sellPrice: number;
+  cost: number;
+}
+
 // Result type for BFS/DFS algorithm
 interface WasmAlgorithmResult {
   mixArray: string[];
@@ -9,6 +17,8 @@ interface WasmAlgorithmResult {
   sellPrice: number;
   cost: number;
   totalCombinations?: number;
+  // Best mixes with distinct effect sets, best first
+  topMixes?: WasmRankedMix[];
 }
 
 // Define the complete module interface
@@ -31,6 +41,29 @@ interface BFSModule {
     reportProgress: boolean
   ) => WasmAlgorithmResult;
 
+  findBestMixJsonTopK?: (
+    productJson: string,
+    substancesJson: string,
+    effectMultipliersJson: string,
+    substanceRulesJson: string,
+    maxDepth: number,
+    reportProgress: boolean,
+    topK: number
+  ) => WasmAlgorithmResult;
+
+  // Like the TopK variant, restricted by constraintsJson: {"maxCost", "requiredEffects",
+  // "forbiddenEffects", "allowedSubstances", "exactLength"}, all optional
+  findBestMixJsonConstrained?: (
+    productJson: string,
+    substancesJson: string,
+    effectMultipliersJson: string,
+    substanceRulesJson: string,
+    maxDepth: number,
+    reportProgress: boolean,
+    topK: number,
+    constraintsJson: string
+  ) => WasmAlgorithmResult;
+
   // DFS functions
   findBestMixDFSJson?: (
     productJson: string,
@@ -49,6 +82,106 @@ interface BFSModule {
     reportProgress: boolean
   ) => WasmAlgorithmResult;
 
+  findBestMixDFSJsonTopK?: (
+    productJson: string,
+    substancesJson: string,
+    effectMultipliersJson: string,
+    substanceRulesJson: string,
+    maxDepth: number,
+    reportProgress: boolean,
+    enableHashing: boolean,
+    topK: number
+  ) => WasmAlgorithmResult;
+
+  // Like the TopK variant, restricted by constraintsJson: {"maxCost", "requiredEffects",
+  // "forbiddenEffects", "allowedSubstances", "exactLength"}, all optional
+  findBestMixDFSJsonConstrained?: (
+    productJson: string,
+    substancesJson: string,
+    effectMultipliersJson: string,
+    substanceRulesJson: string,
+    maxDepth: number,
+    reportProgress: boolean,
+    enableHashing: boolean,
+    topK: number,
+    constraintsJson: string
+  ) => WasmAlgorithmResult;
+
+  // Anytime DFS: reports each depth's result through self.reportDepthResult as soon as
+  // it's proven, and returns the best mix so far once deadlineMs have passed (0 = none)
+  findBestMixDFSJsonAnytime?: (
+    productJson: string,
+    substancesJson: string,
+    effectMultipliersJson: string,
+    substanceRulesJson: string,
+    maxDepth: number,
+    reportProgress: boolean,
+    enableHashing: boolean,
+    deadlineMs: number
+  ) => WasmAlgorithmResult;
+
+  // Latest DFS metrics sample as JSON (nodesPerSecond, depthNodes, cacheHitRate, progress,
+  // etaSeconds, ...), empty before the first sample
+  getSearchMetricsJson?: () => string;
+
+  // DP functions
+  findBestMixDPJson?: (
+    productJson: string,
+    substancesJson: string,
+    effectMultipliersJson: string,
+    substanceRulesJson: string,
+    maxDepth: number
+  ) => WasmAlgorithmResult;
+
+  findBestMixDPJsonWithProgress?: (
+    productJson: string,
+    substancesJson: string,
+    effectMultipliersJson: string,
+    substanceRulesJson: string,
+    maxDepth: number,
+    reportProgress: boolean
+  ) => WasmAlgorithmResult;
+
+  findBestMixDPJsonTopK?: (
+    productJson: string,
+    substancesJson: string,
+    effectMultipliersJson: string,
+    substanceRulesJson: string,
+    maxDepth: number,
+    reportProgress: boolean,
+    topK: number
+  ) => WasmAlgorithmResult;
+
+  // Like the TopK variant, restricted by constraintsJson: {"maxCost", "requiredEffects",
+  // "forbiddenEffects", "allowedSubstances", "exactLength"}, all optional
+  findBestMixDPJsonConstrained?: (
+    productJson: string,
+    substancesJson: string,
+    effectMultipliersJson: string,
+    substanceRulesJson: string,
+    maxDepth: number,
+    reportProgress: boolean,
+    topK: number,
+    constraintsJson: string
+  ) => WasmAlgorithmResult;
+
+  // Incremental solver: keeps the state graph of the last call and only re-scores it
+  // when just costs, multipliers or the base price changed
+  findBestMixIncrementalJson?: (
+    productJson: string,
+    substancesJson: string,
+    effectMultipliersJson: string,
+    substanceRulesJson: string,
+    maxDepth: number,
+    topK: number
+  ) => WasmAlgorithmResult;
+
+  clearIncrementalStateGraph?: () => void;
+
+  // Stops the running search, which then returns its best mix so far. Only takes effect
+  // when called while a search runs, i.e. from one of its callbacks
+  cancelSearch?: () => void;
+
   // Helper functions
   getMixArray?: () => string[];
 }
@@ -2,17 +2,26 @@
 #include "effects.h"
 #include "pricing.h"
 #include "reporter.h"
-#include <queue>
+#include "top_k.h"
+#include "rule_kernel.h"
+#include "metrics.h"
+#include "constraints.h"
+#include "shared_best.h"
 #include <cmath>
 #include <limits>
+#include <climits>
+#include <algorithm>
+#include <vector>
+#include <iostream>
+#include <memory>
+#include <atomic>
 
 // Include threading libraries only for native build
 #ifndef __EMSCRIPTEN__
 #include <thread>
 #include <mutex>
-#include <atomic>
-#include <vector>
-#include <iostream> // Add iostream for std::cout and std::endl
+#include <condition_variable>
+#include <chrono>
 #endif
 
 #ifdef __EMSCRIPTEN__
@@ -20,339 +29,501 @@
 using namespace emscripten;
 #endif
 
-// Mutex for thread synchronization when updating best mix - only used in native build
+// Mutexes for merging the workers' top lists and frontiers - only used in native build
 #ifndef __EMSCRIPTEN__
-std::mutex bestMixMutex;
+std::mutex topMixesMutex;
+static std::mutex frontierMutex;
 std::atomic<int64_t> totalProcessedCombinations(0);
 #endif
 
-// Version of recursiveBFS for both Emscripten and native single-threaded mode
-void recursiveBFS(
-    const Product &product,
-    const std::vector<Substance> &substances,
-    const std::unordered_map<std::string, int> &effectMultipliers,
-    const std::unordered_map<std::string, bool> &effectsSet,
-    int currentDepth,
-    int maxDepth,
-    std::vector<MixState> &currentDepthMixes,
-    MixState &bestMix,
-    int &bestProfitCents,
-    int &bestSellPriceCents,
-    int &bestCostCents,
-    int64_t &processedCombinations,
-    int64_t totalCombinations,
-    ProgressCallback progressCallback)
+// External cancellation flag and its deadline and token check (defined in dfs_algorithm.cpp)
+extern std::atomic<bool> g_shouldTerminate;
+bool stopRequested(const SearchOptions &options);
+
+// Longest wait between two looks at the best mix the workers published
+static const int BEST_MIX_POLL_MS = 10;
+
+// Mixes evaluated per chunk of work handed to a thread. Workers report progress when they
+// finish a chunk, or after this many mixes of a chunk that expands to more
+static const int64_t CHUNK_WORK = int64_t(1) << 16;
+
+MixCodec::MixCodec(size_t substanceCount) : bitsPerSubstance(1)
 {
-  // Process all mixes at the current depth (breadth-first fashion)
-  std::vector<MixState> nextDepthMixes;
-  nextDepthMixes.reserve(currentDepthMixes.size() * substances.size());
+  while ((size_t(1) << bitsPerSubstance) < substanceCount)
+  {
+    bitsPerSubstance++;
+  }
+  maxLength = 64 / bitsPerSubstance;
+}
 
-  int batchSize = 0;
-  const int reportInterval = 100000;
+MixState MixCodec::decode(uint64_t code, int length) const
+{
+  const uint64_t substanceMask = (uint64_t(1) << bitsPerSubstance) - 1;
+  MixState mix(length);
+  for (int i = 0; i < length; ++i)
+  {
+    mix.addSubstance(static_cast<size_t>((code >> (i * bitsPerSubstance)) & substanceMask));
+  }
+  return mix;
+}
 
-  // Process all states at the current depth
-  for (auto &currentMix : currentDepthMixes)
+uint32_t FrontierStates::insert(const PackedMix &record)
+{
+  if ((kept.size() + 1) * 2 > slots.size())
   {
-    // Calculate effects for current mix - using BFS-specific function
-    std::vector<std::string> effectsList = calculateEffectsForMixBFS(
-        currentMix, substances, product.initialEffect, effectsSet);
+    grow();
+  }
 
-    // Calculate profit using integer cents
-    int sellPriceCents = calculateFinalPrice(product.name, effectsList, effectMultipliers);
-    int costCents = calculateFinalCost(currentMix, substances);
-    int profitCents = sellPriceCents - costCents;
+  // Linear probing - the table is at most half full, so probe sequences stay short
+  size_t slot = hashEffectMask(record.effects) & slotMask;
+  while (slots[slot] != 0)
+  {
+    uint32_t stateId = slots[slot] - 1;
+    PackedMix &current = kept[stateId];
+    if (current.effects == record.effects)
+    {
+      if (record.costCents < current.costCents ||
+          (record.costCents == current.costCents && codec.precedes(record.code, current.code)))
+      {
+        current = record;
+      }
+      return stateId;
+    }
+    slot = (slot + 1) & slotMask;
+  }
 
-    // Update best mix if this one is better
-    if (profitCents > bestProfitCents)
+  uint32_t stateId = static_cast<uint32_t>(kept.size());
+  slots[slot] = stateId + 1;
+  kept.push_back(record);
+  return stateId;
+}
+
+void FrontierStates::merge(const FrontierStates &other)
+{
+  for (const PackedMix &record : other.kept)
+  {
+    insert(record);
+  }
+}
+
+void FrontierStates::takeRecords(std::vector<PackedMix> &records)
+{
+  records.swap(kept);
+  std::vector<PackedMix>().swap(kept);
+  std::vector<uint32_t>().swap(slots);
+  slotMask = 0;
+}
+
+void FrontierStates::grow()
+{
+  size_t capacity = std::max<size_t>(64, slots.size() * 2);
+  slots.assign(capacity, 0);
+  slotMask = capacity - 1;
+  for (uint32_t stateId = 0; stateId < kept.size(); ++stateId)
+  {
+    size_t slot = hashEffectMask(kept[stateId].effects) & slotMask;
+    while (slots[slot] != 0)
     {
-      bestMix = currentMix;
-      bestProfitCents = profitCents;
-      bestSellPriceCents = sellPriceCents;
-      bestCostCents = costCents;
+      slot = (slot + 1) & slotMask;
+    }
+    slots[slot] = stateId + 1;
+  }
+}
 
-      // Report the new best mix in WebAssembly mode
-#ifdef __EMSCRIPTEN__
-      // Report the new best mix using the unified function
-      reportBestMixFoundToJS(bestMix, substances, bestProfitCents, bestSellPriceCents, bestCostCents);
+// Best mix found so far, kept packed until it has to be reported
+struct PackedBest
+{
+  uint64_t code;
+  int depth;
+  int profitCents;
+  int sellPriceCents;
+  int costCents;
+};
+
+// State shared by all workers of one BFS search
+struct BFSSearch
+{
+  const Product &product;
+  const std::vector<Substance> &substances;
+  const CompiledEffects &compiled;
+  const PricingContext &pricing;
+  const SearchOptions &options;
+  RuleKernel kernel; // Read-only, shared by all workers
+  MixCodec codec;
+  ProgressCallback progressCallback;
+  BestMixCallback bestMixCallback;
+  int64_t totalCombinations;
+  int64_t processedCombinations; // Single-threaded (WebAssembly) progress counter
+  PackedBest best;                      // Best mix taken over from the workers so far
+  std::unique_ptr<SharedBestMix> shared; // Best mixes the workers published, one slot per thread
+  std::unique_ptr<TopMixList> topMixes; // Merged top list, when one is kept
+  std::unique_ptr<ConstraintFilter> constraints; // Budget, effect and length constraints, if any
+  FrontierStates nextFrontier;          // Frontier being built, merged from the workers' tables
+  std::vector<int64_t> mixCounts;       // Mixes of up to N substances, for counting skipped subtrees
+
+  BFSSearch(const Product &product, const std::vector<Substance> &substances,
+            const CompiledEffects &compiled, const PricingContext &pricing,
+            const SearchOptions &options, ProgressCallback progressCallback, int64_t totalCombinations)
+      : product(product), substances(substances), compiled(compiled), pricing(pricing), options(options),
+        kernel(compiled), codec(substances.size()), progressCallback(progressCallback),
+        totalCombinations(totalCombinations), processedCombinations(0), nextFrontier(codec)
+  {
+    best.code = 0;
+    best.depth = 0;
+    best.profitCents = -std::numeric_limits<int>::infinity();
+    best.sellPriceCents = 0;
+    best.costCents = 0;
+  }
+};
+
+// Take over the best mix the workers published, and report it if it's new. Workers never
+// report, so this runs on the thread that started the search while it waits for them
+static void collectBest(BFSSearch &search)
+{
+  SharedBestMix::Entry entry;
+  if (!search.shared->read(entry) || entry.profitCents <= search.best.profitCents)
+    return;
+
+  search.best.code = 0;
+  for (int i = 0; i < entry.length; ++i)
+  {
+    search.best.code = search.codec.append(search.best.code, i, static_cast<size_t>(entry.substanceIndices[i]));
+  }
+  search.best.depth = entry.length;
+  search.best.profitCents = entry.profitCents;
+  search.best.sellPriceCents = entry.sellPriceCents;
+  search.best.costCents = entry.costCents;
+  MixState mix = entry.toMixState();
+
+#ifndef __EMSCRIPTEN__
+  // Print best mix so far to stdout in native mode
+  std::cout << "Best mix so far: [";
+  for (size_t i = 0; i < mix.substanceIndices.size(); ++i)
+  {
+    if (i > 0)
+      std::cout << ", ";
+    std::cout << search.substances[mix.substanceIndices[i]].name;
+  }
+  std::cout << "] with profit " << entry.profitCents / 100.0
+            << ", price " << entry.sellPriceCents / 100.0
+            << ", cost " << entry.costCents / 100.0
+            << " at depth " << entry.length << std::endl;
+#else
+  // Report the new best mix using the unified function
+  reportBestMixFoundToJS(mix, search.substances, entry.profitCents, entry.sellPriceCents, entry.costCents);
 #endif
 
+  if (search.bestMixCallback)
+  {
+    search.bestMixCallback(mix, entry.profitCents, entry.sellPriceCents, entry.costCents);
+  }
+}
+
+// Per-thread evaluation state: a local best and a batched progress counter
+class BFSWorker
+{
+public:
+  BFSWorker(BFSSearch &search, int slot)
+      : search(search), slot(slot), localBestProfitCents(search.shared->profitCents()), nextStates(search.codec),
+        batchSize(0), skippedBatch(0)
+  {
 #ifndef __EMSCRIPTEN__
-      // Print best mix so far to stdout in native mode
-      std::vector<std::string> mixNames = bestMix.toSubstanceNames(substances);
-      std::cout << "Best mix so far: [";
-      for (size_t i = 0; i < mixNames.size(); ++i)
-      {
-        if (i > 0)
-          std::cout << ", ";
-        std::cout << mixNames[i];
-      }
-      std::cout << "] with profit " << bestProfitCents / 100.0
-                << ", price " << bestSellPriceCents / 100.0
-                << ", cost " << bestCostCents / 100.0
-                << " at depth " << mixNames.size() << std::endl; // Added depth info
+    std::lock_guard<std::mutex> lock(topMixesMutex);
 #endif
+    if (search.topMixes)
+    {
+      localTop.reset(new TopMixList(*search.topMixes));
     }
+  }
 
-    // If we haven't reached max depth, prepare mixes for the next depth
-    if (currentDepth < maxDepth)
+  // Score one mix the constraints accept and publish it if it beats this worker's best
+  void evaluate(uint64_t code, int depth, EffectMask effects, int costCents)
+  {
+    if (!search.constraints || search.constraints->accepts(effects, costCents, depth))
     {
-      for (size_t i = 0; i < substances.size(); ++i)
+      int sellPriceCents = search.pricing.sellPrice(effects);
+      int profitCents = sellPriceCents - costCents;
+
+      if (profitCents > localBestProfitCents)
       {
-        MixState newMix = currentMix; // Copy is optimized due to vector of indices
-        newMix.addSubstance(i);
-        nextDepthMixes.push_back(newMix);
+        localBestProfitCents = profitCents;
+        publishBest(code, depth, profitCents, sellPriceCents, costCents);
       }
-    }
 
-    // Update progress
-    processedCombinations++;
-    batchSize++;
+      if (localTop && localTop->admits(profitCents, costCents, depth))
+      {
+        localTop->insert(search.codec.decode(code, depth), effects, profitCents, sellPriceCents, costCents);
+      }
+    }
 
-    // Adjust reporting frequency based on depth
-    int reportFrequency = reportInterval;
-    if (currentDepth > 5)
+    if (++batchSize >= CHUNK_WORK)
     {
-      // For deeper levels, report progress less frequently to reduce I/O pressure
-      reportFrequency = reportInterval * (currentDepth - 4); // 1000 for depth <=5, 2000 for depth 6, 3000 for depth 7...
+      flushProgress(depth);
     }
+  }
 
-    // Report progress periodically with adaptive frequency
-    if (progressCallback && batchSize >= reportFrequency)
-    {
+  // Count mixes the constraints ruled out without visiting them as done
+  void skip(int64_t mixes)
+  {
+    skippedBatch = skippedBatch > std::numeric_limits<int64_t>::max() - mixes
+                       ? std::numeric_limits<int64_t>::max()
+                       : skippedBatch + mixes;
+  }
+
+  // Add this worker's unreported mixes to the shared count, and check whether the search
+  // should stop
+  void flushProgress(int depth)
+  {
+    if (batchSize == 0 && skippedBatch == 0)
+      return;
+    stopRequested(search.options);
+
+    int64_t batch = batchSize + skippedBatch;
 #ifndef __EMSCRIPTEN__
-      // In native multithreaded version, use atomic counter
-      progressCallback(currentDepth, totalProcessedCombinations.load(), totalCombinations);
+    int64_t processed = totalProcessedCombinations.fetch_add(batch) + batch;
 #else
-      // In Emscripten version, use regular counter
-      progressCallback(currentDepth, processedCombinations, totalCombinations);
+    search.processedCombinations += batch;
+    int64_t processed = search.processedCombinations;
 #endif
-      batchSize = 0;
+    batchSize = 0;
+    skippedBatch = 0;
+
+    if (search.progressCallback)
+    {
+      search.progressCallback(depth, std::min(processed, search.totalCombinations), search.totalCombinations);
+    }
+  }
+
+  // Keep a record for the frontier being built, unless one with the same effects is cheaper
+  void keep(const PackedMix &record)
+  {
+    nextStates.insert(record);
+  }
+
+  // Scratch row for the children of a mix, one row per suffix level
+  EffectMask *childRow(size_t level)
+  {
+    const size_t substanceCount = search.substances.size();
+    if (childEffects.size() < (level + 1) * substanceCount)
+    {
+      childEffects.resize((level + 1) * substanceCount);
     }
+    return &childEffects[level * substanceCount];
   }
 
-  // Report progress for this depth
-  if (progressCallback && batchSize > 0)
+  // Merge this worker's top list into the search's
+  void mergeTopMixes()
   {
+    if (!localTop)
+      return;
+
 #ifndef __EMSCRIPTEN__
-    progressCallback(currentDepth, totalProcessedCombinations.load(), totalCombinations);
-#else
-    progressCallback(currentDepth, processedCombinations, totalCombinations);
+    std::lock_guard<std::mutex> lock(topMixesMutex);
+#endif
+    search.topMixes->merge(*localTop);
+  }
+
+  // Merge the records this worker kept into the frontier being built
+  void mergeFrontier()
+  {
+    if (nextStates.size() == 0)
+      return;
+
+#ifndef __EMSCRIPTEN__
+    std::lock_guard<std::mutex> lock(frontierMutex);
 #endif
+    search.nextFrontier.merge(nextStates);
   }
 
-  // If we have mixes for the next depth and haven't reached max depth,
-  // recursively process the next depth (BFS ordering)
-  if (!nextDepthMixes.empty() && currentDepth < maxDepth)
+private:
+  // Unpack a mix into this worker's slot of the shared best, without waiting on anyone
+  void publishBest(uint64_t code, int depth, int profitCents, int sellPriceCents, int costCents)
   {
-    recursiveBFS(
-        product, substances, effectMultipliers, effectsSet,
-        currentDepth + 1, maxDepth, nextDepthMixes,
-        bestMix, bestProfitCents, bestSellPriceCents, bestCostCents,
-        processedCombinations, totalCombinations, progressCallback);
+    int substanceIndices[MAX_MIX_LENGTH];
+    for (int i = 0; i < depth; ++i)
+    {
+      substanceIndices[i] = search.codec.substanceAt(code, i);
+    }
+    search.shared->publish(slot, substanceIndices, depth, profitCents, sellPriceCents, costCents);
+  }
+
+  BFSSearch &search;
+  int slot;
+  int localBestProfitCents;
+  std::unique_ptr<TopMixList> localTop;
+  FrontierStates nextStates;
+  std::vector<EffectMask> childEffects;
+  int batchSize;
+  int64_t skippedBatch;
+};
+
+// Build the frontier for `depth` from the previous one, scoring every new mix. The
+// children are kept in the worker's table, one per effect set
+static void expandFrontierChunk(
+    BFSSearch &search,
+    BFSWorker &worker,
+    const std::vector<PackedMix> &frontier,
+    size_t begin,
+    size_t end,
+    int depth)
+{
+  const size_t substanceCount = search.substances.size();
+
+  for (size_t parentIndex = begin; parentIndex < end; ++parentIndex)
+  {
+    const PackedMix parent = frontier[parentIndex];
+    EffectMask *children = worker.childRow(0);
+    search.kernel.expand(parent.effects, depth, children);
+
+    for (size_t s = 0; s < substanceCount; ++s)
+    {
+      PackedMix child;
+      child.code = search.codec.append(parent.code, depth - 1, s);
+      child.effects = children[s];
+      child.costCents = parent.costCents + search.substances[s].cost;
+
+      worker.evaluate(child.code, depth, child.effects, child.costCents);
+      worker.keep(child);
+    }
   }
 }
 
-#ifndef __EMSCRIPTEN__
-// Thread-safe version of recursiveBFS for multi-threading (only in native build)
-void recursiveBFSThreaded(
-    const Product &product,
-    const std::vector<Substance> &substances,
-    const std::unordered_map<std::string, int> &effectMultipliers,
-    const std::unordered_map<std::string, bool> &effectsSet,
-    int currentDepth,
-    int maxDepth,
-    std::vector<MixState> &currentDepthMixes,
-    MixState &threadBestMix,
-    int &threadBestProfitCents,
-    int &threadBestSellPriceCents,
-    int &threadBestCostCents,
-    int64_t &processedCombinations,
-    int64_t expectedCombinations,
-    ProgressCallback progressCallback)
+// Score every mix of exactly `depth` substances that extends a frontier record, without
+// storing anything: the suffixes are enumerated with a fixed-size stack
+static void streamFrontierChunk(
+    BFSSearch &search,
+    BFSWorker &worker,
+    const std::vector<PackedMix> &frontier,
+    size_t begin,
+    size_t end,
+    int frontierDepth,
+    int depth)
 {
-  // Process all mixes at the current depth (breadth-first fashion)
-  std::vector<MixState> nextDepthMixes;
-  nextDepthMixes.reserve(currentDepthMixes.size() * substances.size());
+  const size_t substanceCount = search.substances.size();
 
-  int batchSize = 0;
-  const int reportInterval = 100000;
-  const int bestMixCheckInterval = 5000; // Check global best mix every 5000 steps
-  int stepsSinceLastBestMixCheck = 0;
+  // Partial mix at each suffix level, and the next substance to try there
+  PackedMix path[65];
+  size_t nextSubstance[65];
 
-  // Process all states at the current depth
-  for (auto &currentMix : currentDepthMixes)
+  for (size_t parentIndex = begin; parentIndex < end; ++parentIndex)
   {
-    // Calculate effects for current mix
-    std::vector<std::string> effectsList = calculateEffectsForMixBFS(
-        currentMix, substances, product.initialEffect, effectsSet);
-
-    // Calculate profit using integer cents
-    int sellPriceCents = calculateFinalPrice(product.name, effectsList, effectMultipliers);
-    int costCents = calculateFinalCost(currentMix, substances);
-    int profitCents = sellPriceCents - costCents;
+    path[0] = frontier[parentIndex];
+    nextSubstance[0] = 0;
+    int level = 0;
 
-    // Update thread's best mix if this one is better
-    if (profitCents > threadBestProfitCents)
+    while (level >= 0)
     {
-      threadBestMix = currentMix;
-      threadBestProfitCents = profitCents;
-      threadBestSellPriceCents = sellPriceCents;
-      threadBestCostCents = costCents;
-
-      // Check if this is better than the global best mix
-      // We use a mutex to avoid race conditions when checking and updating
+      if (nextSubstance[level] >= substanceCount)
       {
-        std::lock_guard<std::mutex> lock(bestMixMutex);
-
-        // Check against the global variables passed by reference to this function
-        // These are actually the real global variables from bfsThreadWorker
-        MixState &globalBestMix = *static_cast<MixState *>(&threadBestMix);
-        int &globalBestProfitCents = threadBestProfitCents;
-
-        // Report the updated best mix immediately regardless of whether it's better than
-        // the global best - each thread reports its own discoveries
-        std::vector<std::string> mixNames = threadBestMix.toSubstanceNames(substances);
-        std::cout << "Best mix so far: [";
-        for (size_t i = 0; i < mixNames.size(); ++i)
-        {
-          if (i > 0)
-            std::cout << ", ";
-          std::cout << mixNames[i];
-        }
-        std::cout << "] with profit " << threadBestProfitCents / 100.0
-                  << ", price " << threadBestSellPriceCents / 100.0
-                  << ", cost " << threadBestCostCents / 100.0 << std::endl;
+        level--;
+        continue;
       }
-    }
 
-    // Periodically check if we need to update the global best mix
-    stepsSinceLastBestMixCheck++;
-    if (stepsSinceLastBestMixCheck >= bestMixCheckInterval)
-    {
-      stepsSinceLastBestMixCheck = 0;
+      size_t s = nextSubstance[level]++;
+      int mixDepth = frontierDepth + level + 1;
 
-      std::lock_guard<std::mutex> lock(bestMixMutex);
-      // This check happens in bfsThreadWorker after threads complete
-      // We're now doing it more frequently within the thread
-      // The actual update is now done above when a thread finds a better mix
-    }
+      // Expand all children of this level's mix when its first one is visited. A record
+      // can expand to billions of mixes, so a stopped search leaves it midway
+      EffectMask *children = worker.childRow(level);
+      if (s == 0)
+      {
+        if (g_shouldTerminate.load(std::memory_order_relaxed))
+          return;
+        search.kernel.expand(path[level].effects, mixDepth, children);
+      }
 
-    // If we haven't reached max depth, prepare mixes for the next depth
-    if (currentDepth < maxDepth)
-    {
-      for (size_t i = 0; i < substances.size(); ++i)
+      PackedMix child;
+      child.code = search.codec.append(path[level].code, mixDepth - 1, s);
+      child.effects = children[s];
+      child.costCents = path[level].costCents + search.substances[s].cost;
+
+      if (mixDepth == depth)
+      {
+        worker.evaluate(child.code, depth, child.effects, child.costCents);
+      }
+      else if (search.constraints && !search.constraints->canExtend(child.effects, child.costCents, mixDepth))
       {
-        MixState newMix = currentMix;
-        newMix.addSubstance(i);
-        nextDepthMixes.push_back(newMix);
+        // None of this pass's mixes below the child can satisfy the constraints
+        worker.skip(search.mixCounts[depth - mixDepth] - search.mixCounts[depth - mixDepth - 1]);
+      }
+      else
+      {
+        level++;
+        path[level] = child;
+        nextSubstance[level] = 0;
       }
     }
+  }
+}
 
-    // Update progress
-    processedCombinations++;
-    totalProcessedCombinations++;
-    batchSize++;
+// Run a chunked pass over frontier records [0, recordCount), on worker threads in native builds
+template <typename ChunkFunction>
+static void runChunkedPass(BFSSearch &search, size_t recordCount, size_t chunkRecords, int threadCount,
+                           int depth, ChunkFunction processChunk)
+{
+  const size_t chunkCount = (recordCount + chunkRecords - 1) / chunkRecords;
 
-    // Adjust reporting frequency based on depth
-    int reportFrequency = reportInterval;
-    if (currentDepth > 5)
+#ifndef __EMSCRIPTEN__
+  std::atomic<size_t> nextChunk(0);
+  std::atomic<size_t> runningWorkers(0);
+  std::mutex workersMutex;
+  std::condition_variable workersDone;
+  auto workerLoop = [&](int slot)
+  {
+    BFSWorker worker(search, slot);
+    size_t chunk;
+    while (!g_shouldTerminate.load(std::memory_order_relaxed) &&
+           (chunk = nextChunk.fetch_add(1)) < chunkCount)
     {
-      // For deeper levels, report progress less frequently to reduce I/O pressure
-      reportFrequency = reportInterval * (currentDepth - 4); // 1000 for depth <=5, 2000 for depth 6, 3000 for depth 7...
+      size_t begin = chunk * chunkRecords;
+      processChunk(worker, begin, std::min(recordCount, begin + chunkRecords));
+      worker.flushProgress(depth);
     }
+    worker.mergeTopMixes();
+    worker.mergeFrontier();
+    runningWorkers.fetch_sub(1, std::memory_order_release);
+    std::lock_guard<std::mutex> lock(workersMutex);
+    workersDone.notify_all();
+  };
+
+  size_t threads = std::max<size_t>(1, std::min<size_t>(threadCount, chunkCount));
+  runningWorkers.store(threads, std::memory_order_relaxed);
+  std::vector<std::thread> pool;
+  pool.reserve(threads);
+  for (size_t i = 0; i < threads; ++i)
+  {
+    pool.emplace_back(workerLoop, static_cast<int>(i));
+  }
 
-    // Report progress periodically with adaptive frequency
-    if (progressCallback && batchSize >= reportFrequency)
+  // Report new best mixes while the workers run
+  while (runningWorkers.load(std::memory_order_acquire) > 0)
+  {
     {
-      progressCallback(currentDepth, totalProcessedCombinations.load(), expectedCombinations);
-      batchSize = 0;
+      std::unique_lock<std::mutex> lock(workersMutex);
+      workersDone.wait_for(lock, std::chrono::milliseconds(BEST_MIX_POLL_MS), [&]()
+                           { return runningWorkers.load(std::memory_order_acquire) == 0; });
     }
+    collectBest(search);
   }
-
-  // Report progress for this depth
-  if (progressCallback && batchSize > 0)
+  for (auto &thread : pool)
   {
-    progressCallback(currentDepth, totalProcessedCombinations.load(), expectedCombinations);
+    thread.join();
   }
-
-  // If we have mixes for the next depth and haven't reached max depth,
-  // recursively process the next depth
-  if (!nextDepthMixes.empty() && currentDepth < maxDepth)
+  collectBest(search);
+#else
+  (void)threadCount;
+  BFSWorker worker(search, 0);
+  for (size_t chunk = 0; chunk < chunkCount && !g_shouldTerminate.load(std::memory_order_relaxed); ++chunk)
   {
-    recursiveBFSThreaded(
-        product, substances, effectMultipliers, effectsSet,
-        currentDepth + 1, maxDepth, nextDepthMixes,
-        threadBestMix, threadBestProfitCents, threadBestSellPriceCents, threadBestCostCents,
-        processedCombinations, expectedCombinations, progressCallback);
-  }
-}
-
-#endif // <-- Added missing #endif for the recursiveBFSThreaded function
-
-#ifndef __EMSCRIPTEN__
-// Thread worker function (only in native build)
-void bfsThreadWorker(
-    const Product &product,
-    const std::vector<Substance> &substances,
-    const std::unordered_map<std::string, int> &effectMultipliers,
-    const std::unordered_map<std::string, bool> &effectsSet,
-    size_t startSubstanceIndex,
-    int maxDepth,
-    int64_t expectedCombinations,
-    MixState &globalBestMix,
-    int &globalBestProfitCents,
-    int &globalBestSellPriceCents,
-    int &globalBestCostCents,
-    ProgressCallback progressCallback)
-{
-  // Initialize thread-local best mix data
-  MixState threadBestMix(maxDepth);
-  int threadBestProfitCents = -std::numeric_limits<int>::infinity();
-  int threadBestSellPriceCents = 0;
-  int threadBestCostCents = 0;
-
-  // Create initial mix state for this thread's starting substance
-  std::vector<MixState> initialMixes;
-  initialMixes.reserve(1);
-
-  MixState initialMix(maxDepth);
-  initialMix.addSubstance(startSubstanceIndex);
-  initialMixes.push_back(initialMix);
-
-  // Track thread-local processed combinations
-  int64_t processedCombinations = 0; // Changed from int to int64_t
-
-  // Execute BFS for this thread's starting state
-  recursiveBFSThreaded(
-      product, substances, effectMultipliers, effectsSet,
-      1, maxDepth, initialMixes,
-      threadBestMix, threadBestProfitCents, threadBestSellPriceCents, threadBestCostCents,
-      processedCombinations, expectedCombinations, progressCallback);
-
-  // Synchronize with global best mix
-  std::lock_guard<std::mutex> lock(bestMixMutex);
-  if (threadBestProfitCents > globalBestProfitCents)
-  {
-    globalBestMix = threadBestMix;
-    globalBestProfitCents = threadBestProfitCents;
-    globalBestSellPriceCents = threadBestSellPriceCents;
-    globalBestCostCents = threadBestCostCents;
-
-    // Print best mix update to stdout when a thread finds a better mix
-    std::vector<std::string> mixNames = globalBestMix.toSubstanceNames(substances);
-    std::cout << "Best mix so far: [";
-    for (size_t i = 0; i < mixNames.size(); ++i)
-    {
-      if (i > 0)
-        std::cout << ", ";
-      std::cout << mixNames[i];
-    }
-    std::cout << "] with profit " << globalBestProfitCents / 100.0
-              << ", price " << globalBestSellPriceCents / 100.0
-              << ", cost " << globalBestCostCents / 100.0 << std::endl;
+    size_t begin = chunk * chunkRecords;
+    processChunk(worker, begin, std::min(recordCount, begin + chunkRecords));
+    worker.flushProgress(depth);
+    collectBest(search);
   }
-}
+  worker.mergeTopMixes();
+  worker.mergeFrontier();
 #endif
+}
 
 // BFS algorithm with appropriate implementation for platform
 JsBestMixResult findBestMix(
@@ -360,45 +531,59 @@ JsBestMixResult findBestMix(
     const std::vector<Substance> &substances,
     const std::unordered_map<std::string, int> &effectMultipliers,
     int maxDepth,
-    ProgressCallback progressCallback)
+    ProgressCallback progressCallback,
+    const SearchOptions &options)
 {
+  // Search only the allowed substances, no deeper than an exact length asks for
+  std::vector<Substance> narrowedSubstances;
+  int narrowedDepth;
+  SearchOptions narrowedOptions;
+  if (narrowSearch(substances, maxDepth, options, narrowedSubstances, narrowedDepth, narrowedOptions))
+  {
+    return findBestMix(product, narrowedSubstances, effectMultipliers, narrowedDepth, progressCallback, narrowedOptions);
+  }
+
 #ifndef __EMSCRIPTEN__
-  // Native multi-threaded implementation
   // Reset the atomic counter for this run
   totalProcessedCombinations = 0;
+#endif
+  g_shouldTerminate = false;
+  stopRequested(options);
 
-  // Initialize the best mix and profit
-  MixState bestMix(maxDepth);
-  int bestProfitCents = -std::numeric_limits<int>::infinity();
-  int bestSellPriceCents = 0;
-  int bestCostCents = 0;
+  // Compile effect names and substance rules to bitmask form once for the whole search
+  CompiledEffects compiled = compileEffects(product, substances, effectMultipliers);
+  PricingContext pricing(product, compiled.registry, effectMultipliers);
 
-  // Create a set of all effect names for efficiency
-  std::unordered_map<std::string, bool> effectsSet;
-  effectsSet.reserve(effectMultipliers.size() * 2);
-  for (const auto &pair : effectMultipliers)
+  // Size of the search space for progress reporting, saturating at very large depths
+  size_t substanceCount = substances.size();
+  std::vector<int64_t> mixCounts = mixCountsByDepth(substanceCount, std::max(maxDepth, 0));
+  int64_t totalCombinations = mixCounts.back();
+
+  BFSSearch search(product, substances, compiled, pricing, options, progressCallback, totalCombinations);
+  search.bestMixCallback = options.bestMixCallback;
+  search.mixCounts = mixCounts;
+  if (options.wantsTopList())
   {
-    effectsSet[pair.first] = true;
+    search.topMixes.reset(new TopMixList(options));
   }
-
-  // Calculate total expected combinations for progress reporting
-  // Use 64-bit integer to avoid overflow at high depths
-  int64_t totalCombinations64 = 0;
-  size_t substanceCount = substances.size();
-  for (size_t i = 1; i <= static_cast<size_t>(maxDepth); ++i)
+  if (options.constraints.any() && compiled.valid)
   {
-    // Use pow with doubles and then cast to int64_t to handle large values
-    totalCombinations64 += static_cast<int64_t>(pow(static_cast<double>(substanceCount), static_cast<double>(i)));
+    search.constraints.reset(new ConstraintFilter(options.constraints, substances, compiled));
   }
 
-  // Use the full 64-bit value for total combinations
-  int64_t totalCombinations = totalCombinations64;
-
-  // If we'll exceed INT_MAX, print a warning that we're using 64-bit mode
-  if (totalCombinations64 > INT_MAX)
+  // Start from the seed mix, if any
+  if (options.seed.valid && options.seed.mix.substanceIndices.size() <= static_cast<size_t>(maxDepth) &&
+      options.seed.mix.substanceIndices.size() <= static_cast<size_t>(search.codec.maxLength))
   {
-    std::cout << "INFO: Total combinations (" << totalCombinations64
-              << ") exceeds INT_MAX. Using 64-bit progress reporting." << std::endl;
+    const MixState &seedMix = options.seed.mix;
+    for (size_t i = 0; i < seedMix.substanceIndices.size(); ++i)
+    {
+      search.best.code = search.codec.append(search.best.code, static_cast<int>(i), seedMix.substanceIndices[i]);
+    }
+    search.best.depth = static_cast<int>(seedMix.substanceIndices.size());
+    search.best.profitCents = options.seed.profitCents;
+    search.best.sellPriceCents = options.seed.sellPriceCents;
+    search.best.costCents = options.seed.costCents;
   }
 
   // Initial progress report
@@ -407,109 +592,116 @@ JsBestMixResult findBestMix(
     progressCallback(1, 0, totalCombinations);
   }
 
-  // Create and launch threads - one for each starting substance
-  std::vector<std::thread> threads;
-  threads.reserve(substances.size());
-
-  for (size_t i = 0; i < substances.size(); ++i)
-  {
-    threads.emplace_back(
-        bfsThreadWorker,
-        std::ref(product),
-        std::ref(substances),
-        std::ref(effectMultipliers),
-        std::ref(effectsSet),
-        i,
-        maxDepth,
-        totalCombinations,
-        std::ref(bestMix),
-        std::ref(bestProfitCents),
-        std::ref(bestSellPriceCents),
-        std::ref(bestCostCents),
-        progressCallback);
-  }
+  int threadCount = 1;
+#ifndef __EMSCRIPTEN__
+  threadCount = options.threads > 0 ? options.threads : static_cast<int>(std::thread::hardware_concurrency());
+  threadCount = std::max(1, threadCount);
+#endif
+  search.shared.reset(new SharedBestMix(threadCount, search.best.profitCents));
 
-  // Wait for all threads to complete
-  for (auto &thread : threads)
+  const int maxMixLength = std::min(search.codec.maxLength, static_cast<int>(MAX_MIX_LENGTH));
+  bool canSearch = compiled.valid && substanceCount > 0 && maxDepth <= maxMixLength;
+  if (!compiled.valid)
   {
-    if (thread.joinable())
-    {
-      thread.join();
-    }
+    std::cerr << "Error: more than " << MAX_EFFECT_IDS << " distinct effects, cannot run BFS" << std::endl;
   }
-
-  // Final progress report
-  if (progressCallback)
+  else if (maxDepth > maxMixLength)
   {
-    progressCallback(maxDepth, totalCombinations, totalCombinations);
+    std::cerr << "Error: BFS supports mixes of at most " << maxMixLength
+              << " substances with " << substanceCount << " substances" << std::endl;
   }
 
-#else
-  // Emscripten single-threaded implementation
-  // Initialize the best mix and profit
-  MixState bestMix(maxDepth);
-  int bestProfitCents = -std::numeric_limits<int>::infinity();
-  int bestSellPriceCents = 0;
-  int bestCostCents = 0;
+  // The frontier starts as the empty mix. Each depth is either materialized from the
+  // stored frontier, while the next one fits in the memory limit, or streamed from it
+  std::vector<PackedMix> frontier(1, PackedMix{0, compiled.initialEffects, 0});
+  int frontierDepth = 0;
 
-  // Create a set of all effect names for efficiency
-  std::unordered_map<std::string, bool> effectsSet;
-  effectsSet.reserve(effectMultipliers.size() * 2);
-  for (const auto &pair : effectMultipliers)
+  for (int depth = 1; canSearch && depth <= maxDepth && !g_shouldTerminate; ++depth)
   {
-    effectsSet[pair.first] = true;
-  }
-
-  // Initial states for depth 1 (single substances)
-  std::vector<MixState> initialMixes;
-  initialMixes.reserve(substances.size());
+    // While the next frontier is built, every child may be kept both in a worker's table
+    // and in the merged one, so both count against the limit
+    size_t nextSize = frontier.size() * substanceCount;
+    bool storeNext = depth == frontierDepth + 1 && depth < maxDepth &&
+                     nextSize <= options.bfsMemoryLimitBytes / (2 * FrontierStates::MAX_BYTES_PER_RECORD);
 
-  // Add each substance as a starting point
-  for (size_t i = 0; i < substances.size(); ++i)
-  {
-    MixState initialMix(maxDepth);
-    initialMix.addSubstance(i);
-    initialMixes.push_back(initialMix);
-  }
+    if (storeNext)
+    {
+      size_t chunkRecords = std::max<int64_t>(1, CHUNK_WORK / static_cast<int64_t>(substanceCount));
+      runChunkedPass(search, frontier.size(), chunkRecords, threadCount, depth,
+                     [&](BFSWorker &worker, size_t begin, size_t end)
+                     { expandFrontierChunk(search, worker, frontier, begin, end, depth); });
+
+      // One record per effect set is left. Back in enumeration order, so chunks and ties
+      // come out the same whichever worker kept a record
+      search.nextFrontier.takeRecords(frontier);
+      std::sort(frontier.begin(), frontier.end(), [&](const PackedMix &a, const PackedMix &b)
+                { return search.codec.precedes(a.code, b.code); });
+      frontierDepth = depth;
+
+      // Every deeper mix below a dropped record is covered by the one kept in its place
+      if (!g_shouldTerminate && frontier.size() < nextSize)
+      {
+        int64_t dropped = static_cast<int64_t>(nextSize - frontier.size());
+        int64_t below = mixCounts[maxDepth - depth];
+        BFSWorker counter(search, 0);
+        counter.skip(dropped > std::numeric_limits<int64_t>::max() / below ? std::numeric_limits<int64_t>::max()
+                                                                            : dropped * below);
+        counter.flushProgress(depth);
+      }
 
-  // Calculate total expected combinations for progress reporting
-  // Use 64-bit integer to avoid overflow at high depths
-  int64_t totalCombinations64 = 0;
-  size_t substanceCount = substances.size();
-  for (int i = 1; i <= maxDepth; ++i)
-  {
-    // Use pow with doubles and then cast to int64_t to handle large values
-    totalCombinations64 += static_cast<int64_t>(pow(static_cast<double>(substanceCount), static_cast<double>(i)));
+      // Drop the records no constraint-satisfying mix extends, and count every deeper mix
+      // they would have led to as done
+      if (search.constraints)
+      {
+        const ConstraintFilter &constraints = *search.constraints;
+        size_t kept = std::remove_if(frontier.begin(), frontier.end(),
+                                     [&](const PackedMix &record)
+                                     { return !constraints.canExtend(record.effects, record.costCents, depth); }) -
+                      frontier.begin();
+        if (kept < frontier.size())
+        {
+          BFSWorker counter(search, 0);
+          for (size_t i = kept; i < frontier.size(); ++i)
+          {
+            counter.skip(mixCounts[maxDepth - depth]);
+          }
+          counter.flushProgress(depth);
+          frontier.resize(kept);
+        }
+      }
+    }
+    else
+    {
+      // Each record expands to substanceCount^(depth - frontierDepth) mixes at this depth
+      double leavesPerRecord = pow(static_cast<double>(substanceCount), depth - frontierDepth);
+      size_t chunkRecords = static_cast<size_t>(std::max(1.0, CHUNK_WORK / leavesPerRecord));
+      int baseDepth = frontierDepth;
+      runChunkedPass(search, frontier.size(), chunkRecords, threadCount, depth,
+                     [&](BFSWorker &worker, size_t begin, size_t end)
+                     { streamFrontierChunk(search, worker, frontier, begin, end, baseDepth, depth); });
+    }
   }
 
-  // Use the full 64-bit value for total combinations
-  int64_t totalCombinations = totalCombinations64;
-
-  // Initial progress report
-  int64_t processedCombinations = 0;
-  if (progressCallback)
+#ifndef __EMSCRIPTEN__
+  if (canSearch)
   {
-    progressCallback(1, 0, totalCombinations);
+    std::cout << "BFS frontier: stored depth " << frontierDepth << " (" << frontier.size() << " records, "
+              << frontier.size() * sizeof(PackedMix) / (1024 * 1024) << " MB), streamed "
+              << std::max(0, maxDepth - frontierDepth) << " deeper levels" << std::endl;
   }
-
-  // Start the recursive BFS from depth 1
-  recursiveBFS(
-      product, substances, effectMultipliers, effectsSet,
-      1, maxDepth, initialMixes,
-      bestMix, bestProfitCents, bestSellPriceCents, bestCostCents,
-      processedCombinations, totalCombinations, progressCallback);
+#endif
 
   // Final progress report
   if (progressCallback)
   {
     progressCallback(maxDepth, totalCombinations, totalCombinations);
   }
-#endif
 
   // Create the result
   JsBestMixResult result;
 
   // Convert best mix to an array using substance names
+  MixState bestMix = search.codec.decode(search.best.code, search.best.depth);
   std::vector<std::string> bestMixNames = bestMix.toSubstanceNames(substances);
 
 #ifdef __EMSCRIPTEN__
@@ -526,14 +718,16 @@ JsBestMixResult findBestMix(
 #endif
 
   // Store monetary values in both cents and dollars in the result
-  result.profitCents = bestProfitCents;
-  result.sellPriceCents = bestSellPriceCents;
-  result.costCents = bestCostCents;
+  result.profitCents = search.best.profitCents;
+  result.sellPriceCents = search.best.sellPriceCents;
+  result.costCents = search.best.costCents;
 
   // Convert cents to dollars for backward compatibility
-  result.profit = bestProfitCents / 100.0;
-  result.sellPrice = bestSellPriceCents / 100.0;
-  result.cost = bestCostCents / 100.0;
+  result.profit = search.best.profitCents / 100.0;
+  result.sellPrice = search.best.sellPriceCents / 100.0;
+  result.cost = search.best.costCents / 100.0;
+
+  setTopMixes(result, search.topMixes.get(), bestMix, substances);
 
   return result;
 }
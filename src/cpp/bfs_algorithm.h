@@ -1,66 +1,104 @@
 #pragma once
 
 #include "types.h"
+#include "effects.h"
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <cstdint>
 
-// BFS algorithm with memory optimizations and progress reporting
-JsBestMixResult findBestMix(
-    const Product &product,
-    const std::vector<Substance> &substances,
-    const std::unordered_map<std::string, int> &effectMultipliers,
-    int maxDepth,
-    ProgressCallback progressCallback = nullptr);
+// One mix of the BFS frontier packed into a fixed-width record: the substance sequence is
+// stored bitsPerSubstance bits per position in `code`, lowest bits first, alongside the
+// effects and cost it reaches so children can be built without replaying the mix
+struct PackedMix
+{
+  uint64_t code;
+  EffectMask effects;
+  int costCents;
+};
 
-// Basic recursive BFS implementation
-void recursiveBFS(
-    const Product &product,
-    const std::vector<Substance> &substances,
-    const std::unordered_map<std::string, int> &effectMultipliers,
-    const std::unordered_map<std::string, bool> &effectsSet,
-    int currentDepth,
-    int maxDepth,
-    std::vector<MixState> &currentDepthMixes,
-    MixState &bestMix,
-    int &bestProfitCents,
-    int &bestSellPriceCents,
-    int &bestCostCents,
-    int64_t &processedCombinations,
-    int64_t totalCombinations,
-    ProgressCallback progressCallback = nullptr);
-
-#ifndef __EMSCRIPTEN__
-// Thread-safe version of recursiveBFS for multi-threading
-void recursiveBFSThreaded(
-    const Product &product,
-    const std::vector<Substance> &substances,
-    const std::unordered_map<std::string, int> &effectMultipliers,
-    const std::unordered_map<std::string, bool> &effectsSet,
-    int currentDepth,
-    int maxDepth,
-    std::vector<MixState> &currentDepthMixes,
-    MixState &threadBestMix,
-    int &threadBestProfitCents,
-    int &threadBestSellPriceCents,
-    int &threadBestCostCents,
-    int64_t &processedCombinations,
-    int64_t expectedCombinations,
-    ProgressCallback progressCallback);
-
-// Thread worker function - only in native build
-void bfsThreadWorker(
+// Packs substance sequences into PackedMix codes
+struct MixCodec
+{
+  int bitsPerSubstance;
+  int maxLength; // Longest mix that fits in a 64-bit code
+
+  explicit MixCodec(size_t substanceCount);
+
+  uint64_t append(uint64_t code, int length, size_t substanceIndex) const
+  {
+    return code | (static_cast<uint64_t>(substanceIndex) << (length * bitsPerSubstance));
+  }
+
+  // Substance at one position of a code
+  int substanceAt(uint64_t code, int position) const
+  {
+    return static_cast<int>((code >> (position * bitsPerSubstance)) & ((uint64_t(1) << bitsPerSubstance) - 1));
+  }
+
+  // Whether one mix comes before another of the same length in enumeration order, which
+  // compares the first substance first
+  bool precedes(uint64_t code, uint64_t other) const
+  {
+    uint64_t difference = code ^ other;
+    if (difference == 0)
+      return false;
+    int position = countTrailingZeros(difference) / bitsPerSubstance;
+    return substanceAt(code, position) < substanceAt(other, position);
+  }
+
+  MixState decode(uint64_t code, int length) const;
+};
+
+// Frontier records interned by effect set. Rules only depend on a mix's effect set and
+// its length, which every record of one frontier shares, so records with the same effects
+// lead to the same effect sets below them and only the cheapest one can lead to a best
+// mix. Each distinct effect set gets a compact state ID, in order of first insertion, and
+// keeps its cheapest record, the first in enumeration order among equally cheap ones, so
+// searches report the same mixes as without it. The record's code is the path that
+// reached it, so no back-pointers are needed. Not thread-safe: each worker fills a table
+// of its own, and the tables are merged
+class FrontierStates
+{
+public:
+  // Most bytes a table holds per kept record: the record vector may have twice the
+  // capacity it uses, and the slots, doubled once half full, may number four per record
+  static const size_t MAX_BYTES_PER_RECORD = 2 * sizeof(PackedMix) + 4 * sizeof(uint32_t);
+
+  explicit FrontierStates(const MixCodec &codec) : codec(codec), slotMask(0) {}
+
+  // Keep a record if its effect set is new, or if it beats the record kept for it.
+  // Returns the state ID of its effect set
+  uint32_t insert(const PackedMix &record);
+
+  // Insert every record of another table
+  void merge(const FrontierStates &other);
+
+  size_t size() const { return kept.size(); }
+
+  // Move the kept records, indexed by state ID, into records and free the table
+  void takeRecords(std::vector<PackedMix> &records);
+
+private:
+  void grow();
+
+  const MixCodec &codec;
+  std::vector<uint32_t> slots; // Open addressing, at most half full: 0 = empty, else state ID + 1
+  size_t slotMask;
+  std::vector<PackedMix> kept; // Cheapest record per state ID
+};
+
+// BFS algorithm with a bounded-memory packed frontier and progress reporting.
+// Stored frontiers keep one record per effect set (see FrontierStates), and the mixes
+// below the records they drop count as processed.
+// Depths whose frontier fits in options.bfsMemoryLimitBytes are materialized; deeper
+// depths are streamed by enumerating suffixes of the deepest stored frontier in chunks.
+// A passed options.deadline or a cancelled options.cancellation stops the search within a
+// chunk with the best mix so far and leaves g_shouldTerminate raised
+JsBestMixResult findBestMix(
     const Product &product,
     const std::vector<Substance> &substances,
     const std::unordered_map<std::string, int> &effectMultipliers,
-    const std::unordered_map<std::string, bool> &effectsSet,
-    size_t startSubstanceIndex,
     int maxDepth,
-    int64_t expectedCombinations,
-    MixState &globalBestMix,
-    int &globalBestProfitCents,
-    int &globalBestSellPriceCents,
-    int &globalBestCostCents,
-    ProgressCallback progressCallback);
-
-#endif
+    ProgressCallback progressCallback = nullptr,
+    const SearchOptions &options = SearchOptions());
@@ -0,0 +1,184 @@
+#include "checkpoint.h"
+#include "result_cache.h"
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+
+// File layout, all integers little-endian:
+//   "BFSDFSCK", u32 version, u64 search key, u32 unit count, one bit per unit (LSB first),
+//   u8 has best, u8 mix length, u16 per substance index, i32 profit, sell price and cost
+//   (cents), i64 processed combinations
+static const char CHECKPOINT_MAGIC[8] = {'B', 'F', 'S', 'D', 'F', 'S', 'C', 'K'};
+static const uint32_t CHECKPOINT_VERSION = 1;
+
+static void appendLittleEndian(std::string &out, uint64_t value, int bytes)
+{
+  for (int i = 0; i < bytes; ++i)
+  {
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+// Reads little-endian fields from a loaded file, failing once it runs past the end
+class CheckpointReader
+{
+public:
+  explicit CheckpointReader(const std::string &data) : data(data), offset(0), ok(true) {}
+
+  uint64_t read(int bytes)
+  {
+    if (offset + bytes > data.size())
+    {
+      ok = false;
+      return 0;
+    }
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i)
+    {
+      value |= static_cast<uint64_t>(static_cast<unsigned char>(data[offset + i])) << (8 * i);
+    }
+    offset += bytes;
+    return value;
+  }
+
+  bool good() const { return ok; }
+  bool atEnd() const { return offset == data.size(); }
+
+private:
+  const std::string &data;
+  size_t offset;
+  bool ok;
+};
+
+size_t DFSCheckpoint::completedCount() const
+{
+  size_t count = 0;
+  for (uint8_t done : completedUnits)
+  {
+    count += done ? 1 : 0;
+  }
+  return count;
+}
+
+uint64_t computeCheckpointKey(
+    const Product &product,
+    const std::vector<Substance> &substances,
+    const std::unordered_map<std::string, int> &effectMultipliers,
+    int maxDepth,
+    int prefixDepth,
+    const SearchConstraints &constraints,
+    int shardIndex,
+    int shardCount)
+{
+  // The unit layout follows from the substance count, depth, prefix length and shard
+  uint64_t key = computeResultCacheKey(product, substances, effectMultipliers, constraints);
+  key ^= (static_cast<uint64_t>(maxDepth) << 8 | static_cast<uint64_t>(prefixDepth)) * 0x9E3779B97F4A7C15ULL;
+  if (shardCount > 1)
+  {
+    key ^= (static_cast<uint64_t>(shardCount) << 32 | static_cast<uint64_t>(shardIndex)) * 0xC2B2AE3D27D4EB4FULL;
+  }
+  return key * 0x100000001b3ULL;
+}
+
+bool saveCheckpoint(const std::string &path, const DFSCheckpoint &checkpoint)
+{
+  std::string out(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+  appendLittleEndian(out, CHECKPOINT_VERSION, 4);
+  appendLittleEndian(out, checkpoint.searchKey, 8);
+  appendLittleEndian(out, checkpoint.completedUnits.size(), 4);
+
+  uint8_t bits = 0;
+  for (size_t i = 0; i < checkpoint.completedUnits.size(); ++i)
+  {
+    if (checkpoint.completedUnits[i])
+      bits |= static_cast<uint8_t>(1u << (i % 8));
+    if (i % 8 == 7 || i + 1 == checkpoint.completedUnits.size())
+    {
+      out.push_back(static_cast<char>(bits));
+      bits = 0;
+    }
+  }
+
+  appendLittleEndian(out, checkpoint.hasBest ? 1 : 0, 1);
+  appendLittleEndian(out, checkpoint.bestMix.substanceIndices.size(), 1);
+  for (size_t index : checkpoint.bestMix.substanceIndices)
+  {
+    appendLittleEndian(out, index, 2);
+  }
+  appendLittleEndian(out, static_cast<uint32_t>(checkpoint.bestProfitCents), 4);
+  appendLittleEndian(out, static_cast<uint32_t>(checkpoint.bestSellPriceCents), 4);
+  appendLittleEndian(out, static_cast<uint32_t>(checkpoint.bestCostCents), 4);
+  appendLittleEndian(out, static_cast<uint64_t>(checkpoint.processedCombinations), 8);
+
+  std::string tempPath = path + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file)
+      return false;
+    file.write(out.data(), out.size());
+    if (!file)
+      return false;
+  }
+
+  // POSIX rename replaces the old checkpoint atomically. Windows won't rename over an
+  // existing file, so there alone a kill right here can lose it
+#ifdef _WIN32
+  std::remove(path.c_str());
+#endif
+  return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+bool loadCheckpoint(const std::string &path, DFSCheckpoint &checkpoint)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+  std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  if (data.compare(0, sizeof(CHECKPOINT_MAGIC), std::string(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC))) != 0)
+    return false;
+
+  CheckpointReader reader(data);
+  reader.read(sizeof(CHECKPOINT_MAGIC));
+  if (reader.read(4) != CHECKPOINT_VERSION)
+    return false;
+
+  DFSCheckpoint loaded;
+  loaded.searchKey = reader.read(8);
+  size_t unitCount = static_cast<size_t>(reader.read(4));
+  if (!reader.good() || unitCount > data.size() * 8)
+    return false;
+
+  loaded.completedUnits.resize(unitCount);
+  uint8_t bits = 0;
+  for (size_t i = 0; i < unitCount; ++i)
+  {
+    if (i % 8 == 0)
+      bits = static_cast<uint8_t>(reader.read(1));
+    loaded.completedUnits[i] = (bits >> (i % 8)) & 1;
+  }
+
+  loaded.hasBest = reader.read(1) != 0;
+  size_t mixLength = static_cast<size_t>(reader.read(1));
+  if (mixLength > MAX_MIX_LENGTH)
+    return false;
+  for (size_t i = 0; i < mixLength; ++i)
+  {
+    loaded.bestMix.addSubstance(static_cast<size_t>(reader.read(2)));
+  }
+  loaded.bestProfitCents = static_cast<int32_t>(reader.read(4));
+  loaded.bestSellPriceCents = static_cast<int32_t>(reader.read(4));
+  loaded.bestCostCents = static_cast<int32_t>(reader.read(4));
+  loaded.processedCombinations = static_cast<int64_t>(reader.read(8));
+
+  if (!reader.good() || !reader.atEnd())
+    return false;
+
+  checkpoint = loaded;
+  return true;
+}
+
+void removeCheckpoint(const std::string &path)
+{
+  std::remove(path.c_str());
+}
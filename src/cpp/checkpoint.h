@@ -0,0 +1,52 @@
+#pragma once
+
+#include "types.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// Default checkpoint file of the native calculator
+const char *const DEFAULT_CHECKPOINT_FILE = ".bfs_dfs_checkpoint.bin";
+
+// Progress of a DFS search at one point in time: which work units are finished and the
+// best mix among them. A restarted search skips the finished units and starts from the
+// best mix, so it ends with the same result as one that was never stopped
+struct DFSCheckpoint
+{
+  uint64_t searchKey;                // Identifies the inputs, depth and work unit layout
+  std::vector<uint8_t> completedUnits; // 1 for each finished work unit
+  bool hasBest;
+  MixState bestMix;
+  int bestProfitCents;
+  int bestSellPriceCents;
+  int bestCostCents;
+  int64_t processedCombinations; // Mixes evaluated before the checkpoint, for progress
+
+  DFSCheckpoint()
+      : searchKey(0), hasBest(false), bestProfitCents(0), bestSellPriceCents(0), bestCostCents(0),
+        processedCombinations(0) {}
+
+  size_t completedCount() const;
+};
+
+// Key of a DFS search: changes with anything that changes its result or its work units
+uint64_t computeCheckpointKey(
+    const Product &product,
+    const std::vector<Substance> &substances,
+    const std::unordered_map<std::string, int> &effectMultipliers,
+    int maxDepth,
+    int prefixDepth,
+    const SearchConstraints &constraints = SearchConstraints(),
+    int shardIndex = 0,
+    int shardCount = 1);
+
+// Write a checkpoint in a compact little-endian binary form. The file is replaced only
+// once the new one is complete, so a kill during the write keeps the previous checkpoint
+bool saveCheckpoint(const std::string &path, const DFSCheckpoint &checkpoint);
+
+// Read a checkpoint. Returns false if the file is missing, truncated or not a checkpoint
+bool loadCheckpoint(const std::string &path, DFSCheckpoint &checkpoint);
+
+// Delete a checkpoint once its search has finished
+void removeCheckpoint(const std::string &path);
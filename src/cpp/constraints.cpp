@@ -0,0 +1,115 @@
+#include "constraints.h"
+#include <algorithm>
+#include <limits>
+
+ConstraintFilter::ConstraintFilter(
+    const SearchConstraints &constraints,
+    const std::vector<Substance> &substances,
+    const CompiledEffects &compiled)
+    : maxCostCents(constraints.maxCostCents),
+      exactLength(constraints.exactLength),
+      requiredMask(0),
+      forbiddenMask(0),
+      permanentForbiddenMask(0),
+      obtainableMask(compiled.initialEffects),
+      minSubstanceCost(std::numeric_limits<int>::max()),
+      impossible(false)
+{
+  for (const std::string &name : constraints.requiredEffects)
+  {
+    int id = compiled.registry.find(name);
+    if (id < 0)
+    {
+      impossible = true;
+      continue;
+    }
+    requiredMask |= EffectMask(1) << id;
+  }
+
+  // An effect the registry doesn't know can never appear, so forbidding it is a no-op
+  for (const std::string &name : constraints.forbiddenEffects)
+  {
+    int id = compiled.registry.find(name);
+    if (id >= 0)
+    {
+      forbiddenMask |= EffectMask(1) << id;
+    }
+  }
+
+  // Effects leave a mix only through replace rules, and enter it as default effects,
+  // added effects or replacements
+  EffectMask removableMask = 0;
+  for (const CompiledSubstance &substance : compiled.substances)
+  {
+    obtainableMask |= substance.defaultEffectBit;
+    for (const CompiledRule &rule : substance.rules)
+    {
+      if (rule.action == RULE_REPLACE)
+      {
+        removableMask |= rule.targetBit;
+        obtainableMask |= rule.withBit;
+      }
+      else if (rule.action == RULE_ADD)
+      {
+        obtainableMask |= rule.targetBit;
+      }
+    }
+  }
+  permanentForbiddenMask = forbiddenMask & ~removableMask;
+
+  for (const Substance &substance : substances)
+  {
+    minSubstanceCost = std::min(minSubstanceCost, substance.cost);
+  }
+  if (substances.empty())
+  {
+    minSubstanceCost = 0;
+  }
+}
+
+bool narrowSearch(
+    const std::vector<Substance> &substances,
+    int maxDepth,
+    const SearchOptions &options,
+    std::vector<Substance> &narrowedSubstances,
+    int &narrowedDepth,
+    SearchOptions &narrowedOptions)
+{
+  const SearchConstraints &constraints = options.constraints;
+  narrowedDepth = constraints.exactLength > 0 ? std::min(maxDepth, constraints.exactLength) : maxDepth;
+
+  // Index of each kept substance in the narrowed list, -1 for dropped ones
+  std::vector<int> newIndex(substances.size(), -1);
+  narrowedSubstances.clear();
+  for (size_t i = 0; i < substances.size(); ++i)
+  {
+    const std::vector<std::string> &allowed = constraints.allowedSubstances;
+    if (allowed.empty() || std::find(allowed.begin(), allowed.end(), substances[i].name) != allowed.end())
+    {
+      newIndex[i] = static_cast<int>(narrowedSubstances.size());
+      narrowedSubstances.push_back(substances[i]);
+    }
+  }
+
+  bool substancesChanged = narrowedSubstances.size() != substances.size();
+  if (!substancesChanged && narrowedDepth == maxDepth)
+    return false;
+
+  narrowedOptions = options;
+  narrowedOptions.constraints.allowedSubstances.clear();
+  if (substancesChanged && options.seed.valid)
+  {
+    MixState mix;
+    for (size_t index : options.seed.mix.substanceIndices)
+    {
+      if (newIndex[index] < 0)
+      {
+        narrowedOptions.seed = SearchSeed();
+        return true;
+      }
+      mix.addSubstance(static_cast<size_t>(newIndex[index]));
+    }
+    narrowedOptions.seed.mix = mix;
+  }
+  return true;
+}
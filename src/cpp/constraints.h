@@ -0,0 +1,69 @@
+#pragma once
+
+#include "types.h"
+#include "effects.h"
+#include <vector>
+#include <string>
+
+// SearchConstraints compiled against the effect IDs and substances of one search, so
+// checking a mix is a few mask tests. The extension test never rejects a mix that has a
+// valid extension, so cutting the subtrees it rejects leaves the result unchanged
+class ConstraintFilter
+{
+public:
+  ConstraintFilter(
+      const SearchConstraints &constraints,
+      const std::vector<Substance> &substances,
+      const CompiledEffects &compiled);
+
+  // Whether a mix with these final effects, cost and length satisfies every constraint
+  bool accepts(EffectMask effects, int costCents, int length) const
+  {
+    return !impossible &&
+           (maxCostCents < 0 || costCents <= maxCostCents) &&
+           (exactLength == 0 || length == exactLength) &&
+           (effects & requiredMask) == requiredMask &&
+           (effects & forbiddenMask) == 0;
+  }
+
+  // Whether some mix adding substances to this one could still satisfy the constraints:
+  // a substance still fits the budget, the length allows one more, no forbidden effect is
+  // stuck for good and every missing required effect can still appear
+  bool canExtend(EffectMask effects, int costCents, int length) const
+  {
+    return !impossible &&
+           (maxCostCents < 0 || costCents + minSubstanceCost <= maxCostCents) &&
+           (exactLength == 0 || length < exactLength) &&
+           (effects & permanentForbiddenMask) == 0 &&
+           (requiredMask & ~effects & ~obtainableMask) == 0;
+  }
+
+private:
+  int maxCostCents;
+  int exactLength;
+  EffectMask requiredMask;
+  EffectMask forbiddenMask;
+
+  // Forbidden effects no rule ever replaces, and effects some substance can produce
+  EffectMask permanentForbiddenMask;
+  EffectMask obtainableMask;
+
+  // Cheapest substance, for whether any child fits the budget
+  int minSubstanceCost;
+
+  // A required effect no substance or product has, so no mix can qualify
+  bool impossible;
+};
+
+// Narrow a search to what its constraints allow before it starts: only the allowed
+// substances, in their original order, and no deeper than the exact length. Returns true
+// if that changed anything, with the narrowed substances, depth and options filled in.
+// The narrowed options no longer list allowed substances, and their seed refers to the
+// narrowed substances (or is dropped if it uses one that isn't allowed)
+bool narrowSearch(
+    const std::vector<Substance> &substances,
+    int maxDepth,
+    const SearchOptions &options,
+    std::vector<Substance> &narrowedSubstances,
+    int &narrowedDepth,
+    SearchOptions &narrowedOptions);
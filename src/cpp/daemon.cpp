@@ -0,0 +1,523 @@
+#include "daemon.h"
+#include "bfs_algorithm.h"
+#include "dfs_algorithm.h"
+#include "dp_algorithm.h"
+#include "json_parser.h"
+#include "dataset.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+using json = nlohmann::json;
+
+// Minimum time between two progress frames of a job, so fast searches don't flood the pipe
+static const int64_t PROGRESS_INTERVAL_MS = 100;
+
+// Number of parsed datasets kept in memory
+static const size_t MAX_DATASETS = 16;
+
+// A queued or running search
+struct DaemonJob
+{
+  uint32_t id;
+  std::shared_ptr<const Dataset> dataset;
+  Product product;
+  int maxDepth;
+  std::string algorithm;
+  SearchOptions options;
+  bool useCache;
+  uint64_t cacheKey;
+  bool reportMetrics;
+  CancellationToken cancellation; // Cancelled by a 'C' frame or shutdown, polled by the engine
+  std::atomic<int64_t> lastProgressMs;
+
+  DaemonJob()
+      : id(0), maxDepth(0), useCache(false), cacheKey(0), reportMetrics(false), lastProgressMs(0) {}
+};
+
+static int64_t steadyMilliseconds()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static void appendLittleEndian(std::string &out, uint64_t value, int bytes)
+{
+  for (int i = 0; i < bytes; ++i)
+  {
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+static uint64_t readLittleEndian(const unsigned char *in, int bytes)
+{
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i)
+  {
+    value |= static_cast<uint64_t>(in[i]) << (8 * i);
+  }
+  return value;
+}
+
+// Writes whole frames to stdout; safe to call from any thread
+class FrameWriter
+{
+public:
+  void write(uint8_t type, const std::string &payload)
+  {
+    std::string header;
+    appendLittleEndian(header, payload.size(), 4);
+    header.push_back(static_cast<char>(type));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::fwrite(header.data(), 1, header.size(), stdout);
+    std::fwrite(payload.data(), 1, payload.size(), stdout);
+    std::fflush(stdout);
+  }
+
+private:
+  std::mutex mutex;
+};
+
+// Read one frame from stdin. Returns false at end of input or on a malformed frame
+static bool readFrame(uint8_t &type, std::string &payload)
+{
+  unsigned char header[5];
+  if (std::fread(header, 1, sizeof(header), stdin) != sizeof(header))
+    return false;
+
+  uint32_t length = static_cast<uint32_t>(readLittleEndian(header, 4));
+  if (length > MAX_DAEMON_FRAME_BYTES)
+  {
+    std::cerr << "Daemon: frame of " << length << " bytes exceeds the limit, stopping" << std::endl;
+    return false;
+  }
+
+  type = header[4];
+  payload.resize(length);
+  return length == 0 || std::fread(&payload[0], 1, length, stdin) == length;
+}
+
+static json mixMessage(uint32_t jobId, const std::vector<std::string> &mix,
+                       int profitCents, int sellPriceCents, int costCents)
+{
+  return json{{"jobId", jobId},
+              {"mixArray", mix},
+              {"profit", profitCents / 100.0},
+              {"sellPrice", sellPriceCents / 100.0},
+              {"cost", costCents / 100.0}};
+}
+
+static json topMixesMessage(const JsBestMixResult &result)
+{
+  json top = json::array();
+  for (const RankedMixResult &entry : result.topMixes)
+  {
+    top.push_back(json{{"mixArray", entry.mixArray},
+                       {"profit", entry.profitCents / 100.0},
+                       {"sellPrice", entry.sellPriceCents / 100.0},
+                       {"cost", entry.costCents / 100.0}});
+  }
+  return top;
+}
+
+class SolverDaemon
+{
+public:
+  SolverDaemon(const SearchOptions &defaults, bool useHashingOptimization, ResultCache *cache)
+      : defaults(defaults), useHashingOptimization(useHashingOptimization), cache(cache), stopping(false) {}
+
+  int run()
+  {
+    // Engines log to std::cout; keep that text off the protocol channel
+    std::streambuf *consoleBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+
+    std::thread solver(&SolverDaemon::solverLoop, this);
+
+    uint8_t type = 0;
+    std::string payload;
+    while (readFrame(type, payload) && type != FRAME_QUIT)
+    {
+      try
+      {
+        if (type == FRAME_DATASET)
+        {
+          handleDataset(payload);
+        }
+        else if (type == FRAME_JOB)
+        {
+          handleJob(payload);
+        }
+        else if (type == FRAME_CANCEL && payload.size() == 4)
+        {
+          cancelJob(static_cast<uint32_t>(readLittleEndian(reinterpret_cast<const unsigned char *>(payload.data()), 4)));
+        }
+        else
+        {
+          sendError(0, "Unknown or malformed message of type " + std::to_string(type));
+        }
+      }
+      catch (const std::exception &e)
+      {
+        sendError(0, e.what());
+      }
+    }
+
+    // Drop queued jobs and stop the running one
+    {
+      std::lock_guard<std::mutex> lock(queueMutex);
+      stopping = true;
+      queue.clear();
+      if (running)
+      {
+        running->cancellation.cancel();
+      }
+    }
+    queueReady.notify_all();
+    solver.join();
+
+    std::cout.rdbuf(consoleBuffer);
+    return 0;
+  }
+
+private:
+  static std::shared_ptr<Dataset> parseDataset(const json &doc)
+  {
+    if (doc.contains("file"))
+    {
+      return std::make_shared<Dataset>(loadDatasetSnapshot(doc.at("file").get<std::string>()));
+    }
+    return std::make_shared<Dataset>(parseDatasetJson(
+        doc.at("substances").dump(), doc.at("effectMultipliers").dump(), doc.at("substanceRules").dump()));
+  }
+
+  void handleDataset(const std::string &payload)
+  {
+    json doc = json::parse(payload);
+    std::string id = doc.at("id").get<std::string>();
+    std::shared_ptr<const Dataset> dataset = parseDataset(doc);
+
+    for (size_t i = 0; i < datasets.size(); ++i)
+    {
+      if (datasets[i].first == id)
+      {
+        datasets.erase(datasets.begin() + i);
+        break;
+      }
+    }
+    if (datasets.size() >= MAX_DATASETS)
+    {
+      datasets.erase(datasets.begin());
+    }
+    datasets.emplace_back(id, dataset);
+  }
+
+  // Find a dataset by ID, marking it most recently used
+  std::shared_ptr<const Dataset> findDataset(const std::string &id)
+  {
+    for (size_t i = 0; i < datasets.size(); ++i)
+    {
+      if (datasets[i].first == id)
+      {
+        std::pair<std::string, std::shared_ptr<const Dataset>> entry = datasets[i];
+        datasets.erase(datasets.begin() + i);
+        datasets.push_back(entry);
+        return entry.second;
+      }
+    }
+    return nullptr;
+  }
+
+  void handleJob(const std::string &payload)
+  {
+    json doc = json::parse(payload);
+    uint32_t jobId = doc.value("jobId", 0u);
+
+    try
+    {
+      std::shared_ptr<DaemonJob> job = std::make_shared<DaemonJob>();
+      job->id = jobId;
+
+      if (doc.contains("dataset"))
+      {
+        job->dataset = findDataset(doc["dataset"].get<std::string>());
+        if (!job->dataset)
+          throw std::runtime_error("Unknown dataset " + doc["dataset"].get<std::string>());
+      }
+      else
+      {
+        job->dataset = parseDataset(doc);
+      }
+
+      const json &product = doc.at("product");
+      job->product = parseProductJson(product.dump());
+      job->maxDepth = doc.value("maxDepth", product.value("maxDepth", 5));
+      if (job->maxDepth < 1 || job->maxDepth > static_cast<int>(MAX_MIX_LENGTH))
+        throw std::runtime_error("maxDepth must be between 1 and " + std::to_string(MAX_MIX_LENGTH));
+
+      job->algorithm = doc.value("algorithm", std::string("bfs"));
+      if (job->algorithm != "bfs" && job->algorithm != "dfs" && job->algorithm != "dp")
+        throw std::runtime_error("Invalid algorithm. Use 'bfs', 'dfs' or 'dp'");
+
+      job->options = defaults;
+      job->options.pruning = doc.value("prune", defaults.pruning);
+      job->options.dominance = doc.value("dominance", defaults.dominance);
+      job->options.threads = doc.value("threads", defaults.threads);
+      job->options.topK = static_cast<size_t>(std::max(1, doc.value("topK", static_cast<int>(defaults.topK))));
+      if (doc.contains("topMaxCost"))
+      {
+        job->options.topMaxCostCents = static_cast<int>(std::round(doc["topMaxCost"].get<double>() * 100.0));
+      }
+      job->options.topMaxLength = doc.value("topMaxLength", defaults.topMaxLength);
+      job->reportMetrics = doc.value("metrics", false);
+      job->options.anytime = doc.value("anytime", defaults.anytime);
+      if (doc.contains("constraints"))
+      {
+        job->options.constraints = parseSearchConstraintsJson(doc["constraints"].dump());
+      }
+      if (doc.value("deadlineMs", 0) > 0)
+      {
+        job->options.setTimeLimit(doc["deadlineMs"].get<int64_t>());
+      }
+
+      // Cache hits don't need the solver thread, so they're answered right away. The cache
+      // only holds the best mix, so top-K jobs are always searched
+      job->useCache = cache && doc.value("useCache", true);
+      if (job->useCache)
+      {
+        const Dataset &data = *job->dataset;
+        job->cacheKey = computeResultCacheKey(job->product, data.substances, data.effectMultipliers,
+                                              job->options.constraints);
+
+        CachedResult cached;
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (!job->options.wantsTopList() && cache->find(job->cacheKey, job->maxDepth, cached))
+        {
+          sendResult(*job, toBestMixResult(cached), false, true);
+          return;
+        }
+        if (cache->findShallower(job->cacheKey, job->maxDepth, cached))
+        {
+          seedFromCachedResult(cached, data.substances, job->options.seed);
+        }
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back(job);
+      }
+      queueReady.notify_one();
+    }
+    catch (const std::exception &e)
+    {
+      sendError(jobId, e.what());
+    }
+  }
+
+  void cancelJob(uint32_t jobId)
+  {
+    std::shared_ptr<DaemonJob> dropped;
+    {
+      std::lock_guard<std::mutex> lock(queueMutex);
+      if (running && running->id == jobId)
+      {
+        // The engine returns its best mix so far, which is sent as a cancelled result
+        running->cancellation.cancel();
+        return;
+      }
+
+      for (auto it = queue.begin(); it != queue.end(); ++it)
+      {
+        if ((*it)->id == jobId)
+        {
+          dropped = *it;
+          queue.erase(it);
+          break;
+        }
+      }
+    }
+
+    if (dropped)
+    {
+      JsBestMixResult empty = JsBestMixResult();
+      sendResult(*dropped, empty, true, false);
+    }
+  }
+
+  void solverLoop()
+  {
+    for (;;)
+    {
+      std::shared_ptr<DaemonJob> job;
+      {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        queueReady.wait(lock, [this]
+                        { return stopping || !queue.empty(); });
+        if (stopping)
+          return;
+
+        job = queue.front();
+        queue.pop_front();
+        running = job;
+        g_shouldTerminate = false;
+      }
+
+      runJob(*job);
+
+      std::lock_guard<std::mutex> lock(queueMutex);
+      running.reset();
+    }
+  }
+
+  void runJob(DaemonJob &job)
+  {
+    const Dataset &data = *job.dataset;
+
+    SearchOptions options = job.options;
+    options.cancellation = &job.cancellation;
+    options.bestMixCallback = [&](const MixState &mix, int profitCents, int sellPriceCents, int costCents)
+    {
+      json message = mixMessage(job.id, mix.toSubstanceNames(data.substances),
+                                profitCents, sellPriceCents, costCents);
+      writer.write(FRAME_BEST_MIX, message.dump());
+    };
+
+    // Metrics samples already come at the reporting interval, so they aren't throttled
+    options.metricsCallback = nullptr;
+    if (job.reportMetrics)
+    {
+      options.metricsCallback = [&](const std::string &metricsJson)
+      {
+        writer.write(FRAME_METRICS, "{\"jobId\":" + std::to_string(job.id) + "," + metricsJson.substr(1));
+      };
+    }
+
+    // Anytime jobs stream each depth's result as soon as it's proven
+    options.depthResultCallback = [&](int depth, const JsBestMixResult &result, bool complete)
+    {
+      json message = mixMessage(job.id, result.mixArray, result.profitCents, result.sellPriceCents, result.costCents);
+      message["depth"] = depth;
+      message["complete"] = complete;
+      message["topMixes"] = topMixesMessage(result);
+      writer.write(FRAME_DEPTH_RESULT, message.dump());
+    };
+
+    ProgressCallback progress = [&](int depth, int64_t processed, int64_t total)
+    {
+      int64_t now = steadyMilliseconds();
+      int64_t last = job.lastProgressMs.load(std::memory_order_relaxed);
+      if (processed != total &&
+          (now - last < PROGRESS_INTERVAL_MS || !job.lastProgressMs.compare_exchange_strong(last, now)))
+        return;
+
+      std::string frame;
+      appendLittleEndian(frame, job.id, 4);
+      appendLittleEndian(frame, static_cast<uint32_t>(depth), 4);
+      appendLittleEndian(frame, static_cast<uint64_t>(processed), 8);
+      appendLittleEndian(frame, static_cast<uint64_t>(total), 8);
+      writer.write(FRAME_PROGRESS, frame);
+    };
+
+    JsBestMixResult result;
+    try
+    {
+      if (job.algorithm == "dfs")
+      {
+        result = findBestMixDFS(job.product, data.substances, data.effectMultipliers, job.maxDepth,
+                                progress, useHashingOptimization, options);
+      }
+      else if (job.algorithm == "dp")
+      {
+        result = findBestMixDP(job.product, data.substances, data.effectMultipliers, job.maxDepth,
+                               progress, options);
+      }
+      else
+      {
+        result = findBestMix(job.product, data.substances, data.effectMultipliers, job.maxDepth,
+                             progress, options);
+      }
+    }
+    catch (const std::exception &e)
+    {
+      sendError(job.id, e.what());
+      return;
+    }
+
+    // A cancelled search or one stopped at its deadline only covered part of the space,
+    // so its result isn't cached
+    bool cancelled = job.cancellation.cancelled();
+    bool deadlineReached = !cancelled && g_shouldTerminate;
+    if (job.useCache && !cancelled && !deadlineReached && !result.mixArray.empty())
+    {
+      std::lock_guard<std::mutex> lock(cacheMutex);
+      cache->store(job.cacheKey, {job.maxDepth, result.mixArray, result.profitCents,
+                                  result.sellPriceCents, result.costCents});
+    }
+
+    sendResult(job, result, cancelled, false, deadlineReached);
+  }
+
+  void sendResult(const DaemonJob &job, const JsBestMixResult &result, bool cancelled, bool cached,
+                  bool deadlineReached = false)
+  {
+    json message = mixMessage(job.id, result.mixArray, result.profitCents, result.sellPriceCents, result.costCents);
+    message["topMixes"] = topMixesMessage(result);
+    message["cancelled"] = cancelled;
+    message["deadlineReached"] = deadlineReached;
+    message["cached"] = cached;
+    writer.write(FRAME_RESULT, message.dump());
+  }
+
+  void sendError(uint32_t jobId, const std::string &error)
+  {
+    json message{{"jobId", jobId}, {"error", error}};
+    writer.write(FRAME_ERROR, message.dump());
+  }
+
+  SearchOptions defaults;
+  bool useHashingOptimization;
+  ResultCache *cache;
+  std::mutex cacheMutex;
+  FrameWriter writer;
+
+  // Parsed datasets by ID, least recently used first. Only touched by the reader thread
+  std::vector<std::pair<std::string, std::shared_ptr<const Dataset>>> datasets;
+
+  std::mutex queueMutex;
+  std::condition_variable queueReady;
+  std::deque<std::shared_ptr<DaemonJob>> queue;
+  std::shared_ptr<DaemonJob> running;
+  bool stopping;
+};
+
+int runDaemon(const SearchOptions &defaults, bool useHashingOptimization, ResultCache *cache)
+{
+#ifdef _WIN32
+  // Frames are binary; don't let the C runtime translate line endings
+  _setmode(_fileno(stdin), _O_BINARY);
+  _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+  std::cerr << "Solver daemon ready" << std::endl;
+  SolverDaemon solver(defaults, useHashingOptimization, cache);
+  return solver.run();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "types.h"
+#include "result_cache.h"
+#include <cstdint>
+
+// Long-lived solver mode of the native calculator. The server starts one process and
+// sends it jobs, so substance data, compiled caches and the result cache stay warm
+// between requests instead of being rebuilt by a fresh process every time.
+//
+// Messages are frames on stdin/stdout: a 4-byte little-endian payload length, a 1-byte
+// message type and the payload. Integers in binary payloads are little-endian.
+//
+// Client to solver:
+//   'D' dataset  JSON {"id", "substances", "effectMultipliers", "substanceRules"}, parsed
+//                once and kept for jobs that name it; {"id", "file"} loads a snapshot
+//                written by --build-dataset instead (see dataset.h)
+//   'J' job      JSON {"jobId", "dataset", "product", "maxDepth", "algorithm", "prune",
+//                "dominance", "threads", "useCache", "topK", "topMaxCost", "topMaxLength",
+//                "metrics", "anytime", "deadlineMs", "constraints"}; "dataset" may be replaced
+//                by inline "substances", "effectMultipliers" and "substanceRules".
+//                "deadlineMs" counts from when the job is received; DFS only, like
+//                "anytime". "constraints" is parsed by parseSearchConstraintsJson
+//   'C' cancel   u32 job ID, for a queued or running job
+//   'Q' quit     empty; also implied by end of input
+//
+// Solver to client:
+//   'P' progress u32 job ID, u32 depth, i64 processed, i64 total; DFS counts the mixes of
+//                pruned and dominated subtrees as processed
+//   'B' best mix JSON {"jobId", "mixArray", "profit", "sellPrice", "cost"}
+//   'M' metrics  JSON {"jobId", "elapsedSeconds", "nodes", "totalNodes", "nodesPerSecond",
+//                "depthNodes", "cacheHits", "cacheMisses", "cacheHitRate", "prunedSubtrees",
+//                "prunedNodes", "dominatedSubtrees", "dominatedNodes", "threadUtilization",
+//                "coveredNodes", "remainingNodes", "completedUnits", "totalUnits", "progress",
+//                "coveredPerSecond", "etaSeconds"}; DFS jobs with "metrics" only
+//   'A' anytime  JSON {"jobId", "depth", "complete", "mixArray", "profit", "sellPrice",
+//                "cost", "topMixes"}; one per depth of "anytime" jobs, complete unless
+//                the deadline or a cancel stopped that depth
+//   'R' result   JSON {"jobId", "mixArray", "profit", "sellPrice", "cost", "topMixes",
+//                "cancelled", "deadlineReached", "cached"}; topMixes entries have the
+//                same mix fields
+//   'E' error    JSON {"jobId", "error"}; jobId is 0 for errors not tied to a job
+//
+// Jobs are queued and run one at a time, since every engine already uses all worker
+// threads and shares process-wide search state. Cache hits are answered immediately,
+// even while another job is running. Engine log text goes to stderr
+
+// Message types
+const uint8_t FRAME_DATASET = 'D';
+const uint8_t FRAME_JOB = 'J';
+const uint8_t FRAME_CANCEL = 'C';
+const uint8_t FRAME_QUIT = 'Q';
+const uint8_t FRAME_PROGRESS = 'P';
+const uint8_t FRAME_BEST_MIX = 'B';
+const uint8_t FRAME_METRICS = 'M';
+const uint8_t FRAME_DEPTH_RESULT = 'A';
+const uint8_t FRAME_RESULT = 'R';
+const uint8_t FRAME_ERROR = 'E';
+
+// Largest frame payload accepted from the client
+const uint32_t MAX_DAEMON_FRAME_BYTES = uint32_t(64) << 20;
+
+// Serve jobs until the client quits or closes stdin. `defaults` gives the options of jobs
+// that don't override them; `cache` may be null to disable result caching
+int runDaemon(const SearchOptions &defaults, bool useHashingOptimization, ResultCache *cache);
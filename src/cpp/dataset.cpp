@@ -0,0 +1,380 @@
+#include "dataset.h"
+#include "json_parser.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char SNAPSHOT_MAGIC[8] = {'B', 'F', 'S', 'D', 'A', 'T', 'A', '1'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+static const uint32_t NO_STRING = 0xFFFFFFFFu;
+
+// On-disk records, read in place from the mapped file
+struct SnapshotHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t stringCount;
+  uint32_t substanceCount;
+  uint32_t ruleCount;
+  uint32_t effectListCount;
+  uint32_t multiplierCount;
+  uint32_t stringBytes;
+};
+
+struct SnapshotSubstance
+{
+  uint32_t name;
+  int32_t costCents;
+  uint32_t defaultEffect;
+  uint32_t firstRule;
+  uint32_t ruleCount;
+};
+
+struct SnapshotRule
+{
+  uint32_t type;
+  uint32_t target;
+  uint32_t withEffect; // NO_STRING for rules without one
+  uint32_t firstCondition;
+  uint32_t conditionCount;
+  uint32_t firstIfNotPresent;
+  uint32_t ifNotPresentCount;
+};
+
+struct SnapshotMultiplier
+{
+  uint32_t effect;
+  int32_t multiplier;
+};
+
+static size_t alignedTo4(size_t bytes)
+{
+  return (bytes + 3) & ~static_cast<size_t>(3);
+}
+
+// Read-only mapping of a whole file, unmapped when it goes out of scope
+class MappedFile
+{
+public:
+  explicit MappedFile(const std::string &path) : bytes(nullptr), length(0)
+  {
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+    mapping = nullptr;
+    LARGE_INTEGER size;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size))
+      throw std::runtime_error("Could not open dataset: " + path);
+    length = static_cast<size_t>(size.QuadPart);
+    if (length > 0)
+    {
+      mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping)
+        bytes = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+#else
+    descriptor = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (descriptor < 0 || fstat(descriptor, &info) != 0)
+    {
+      if (descriptor >= 0)
+        close(descriptor);
+      throw std::runtime_error("Could not open dataset: " + path);
+    }
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0)
+    {
+      void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+      bytes = mapped == MAP_FAILED ? nullptr : static_cast<const uint8_t *>(mapped);
+    }
+#endif
+    if (length > 0 && !bytes)
+    {
+      release();
+      throw std::runtime_error("Could not map dataset: " + path);
+    }
+  }
+
+  ~MappedFile() { release(); }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const uint8_t *data() const { return bytes; }
+  size_t size() const { return length; }
+
+private:
+  void release()
+  {
+#ifdef _WIN32
+    if (bytes)
+      UnmapViewOfFile(bytes);
+    if (mapping)
+      CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+      CloseHandle(file);
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (bytes)
+      munmap(const_cast<uint8_t *>(bytes), length);
+    if (descriptor >= 0)
+      close(descriptor);
+    descriptor = -1;
+#endif
+    bytes = nullptr;
+  }
+
+  const uint8_t *bytes;
+  size_t length;
+#ifdef _WIN32
+  HANDLE file;
+  HANDLE mapping;
+#else
+  int descriptor;
+#endif
+};
+
+Dataset parseDatasetJson(
+    const std::string &substancesJson,
+    const std::string &effectMultipliersJson,
+    const std::string &substanceRulesJson)
+{
+  Dataset dataset;
+  dataset.substances = parseSubstancesJson(substancesJson);
+  dataset.effectMultipliers = parseEffectMultipliersJson(effectMultipliersJson);
+  applySubstanceRulesJson(dataset.substances, substanceRulesJson);
+  return dataset;
+}
+
+// Builds the sections of a snapshot, interning every string on first use
+class SnapshotWriter
+{
+public:
+  uint32_t intern(const std::string &value)
+  {
+    auto it = stringIndex.find(value);
+    if (it != stringIndex.end())
+      return it->second;
+    uint32_t index = static_cast<uint32_t>(strings.size());
+    stringIndex.emplace(value, index);
+    strings.push_back(value);
+    return index;
+  }
+
+  uint32_t internList(const std::vector<std::string> &values)
+  {
+    uint32_t first = static_cast<uint32_t>(effectList.size());
+    for (const std::string &value : values)
+    {
+      effectList.push_back(intern(value));
+    }
+    return first;
+  }
+
+  std::string build(const Dataset &dataset)
+  {
+    for (const Substance &substance : dataset.substances)
+    {
+      SnapshotSubstance record;
+      record.name = intern(substance.name);
+      record.costCents = substance.cost;
+      record.defaultEffect = intern(substance.defaultEffect);
+      record.firstRule = static_cast<uint32_t>(rules.size());
+      record.ruleCount = static_cast<uint32_t>(substance.rules.size());
+      substances.push_back(record);
+
+      for (const SubstanceRule &rule : substance.rules)
+      {
+        SnapshotRule ruleRecord;
+        ruleRecord.type = intern(rule.type);
+        ruleRecord.target = intern(rule.target);
+        ruleRecord.withEffect = rule.withEffect.empty() ? NO_STRING : intern(rule.withEffect);
+        ruleRecord.firstCondition = internList(rule.condition);
+        ruleRecord.conditionCount = static_cast<uint32_t>(rule.condition.size());
+        ruleRecord.firstIfNotPresent = internList(rule.ifNotPresent);
+        ruleRecord.ifNotPresentCount = static_cast<uint32_t>(rule.ifNotPresent.size());
+        rules.push_back(ruleRecord);
+      }
+    }
+
+    for (const auto &entry : dataset.effectMultipliers)
+    {
+      multipliers.push_back({intern(entry.first), entry.second});
+    }
+
+    std::vector<uint32_t> stringEnds;
+    std::string stringBytes;
+    for (const std::string &value : strings)
+    {
+      stringBytes += value;
+      stringEnds.push_back(static_cast<uint32_t>(stringBytes.size()));
+    }
+
+    SnapshotHeader header;
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.stringCount = static_cast<uint32_t>(strings.size());
+    header.substanceCount = static_cast<uint32_t>(substances.size());
+    header.ruleCount = static_cast<uint32_t>(rules.size());
+    header.effectListCount = static_cast<uint32_t>(effectList.size());
+    header.multiplierCount = static_cast<uint32_t>(multipliers.size());
+    header.stringBytes = static_cast<uint32_t>(stringBytes.size());
+
+    std::string out;
+    append(out, &header, sizeof(header));
+    append(out, stringEnds.data(), stringEnds.size() * sizeof(uint32_t));
+    append(out, stringBytes.data(), stringBytes.size());
+    out.resize(alignedTo4(out.size()), '\0');
+    append(out, substances.data(), substances.size() * sizeof(SnapshotSubstance));
+    append(out, rules.data(), rules.size() * sizeof(SnapshotRule));
+    append(out, effectList.data(), effectList.size() * sizeof(uint32_t));
+    append(out, multipliers.data(), multipliers.size() * sizeof(SnapshotMultiplier));
+    return out;
+  }
+
+private:
+  static void append(std::string &out, const void *data, size_t bytes)
+  {
+    out.append(static_cast<const char *>(data), bytes);
+  }
+
+  std::unordered_map<std::string, uint32_t> stringIndex;
+  std::vector<std::string> strings;
+  std::vector<SnapshotSubstance> substances;
+  std::vector<SnapshotRule> rules;
+  std::vector<uint32_t> effectList;
+  std::vector<SnapshotMultiplier> multipliers;
+};
+
+void saveDatasetSnapshot(const std::string &path, const Dataset &dataset)
+{
+  SnapshotWriter writer;
+  std::string out = writer.build(dataset);
+
+  std::string tempPath = path + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    file.write(out.data(), out.size());
+    if (!file)
+      throw std::runtime_error("Could not write dataset: " + path);
+  }
+
+  // Replace the old snapshot in one step where rename allows it
+#ifdef _WIN32
+  std::remove(path.c_str());
+#endif
+  if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+    throw std::runtime_error("Could not write dataset: " + path);
+}
+
+Dataset loadDatasetSnapshot(const std::string &path)
+{
+  MappedFile file(path);
+  const uint8_t *data = file.data();
+  const std::runtime_error invalid("Not a dataset snapshot of version " + std::to_string(SNAPSHOT_VERSION) + ": " + path);
+
+  if (file.size() < sizeof(SnapshotHeader))
+    throw invalid;
+  const SnapshotHeader &header = *reinterpret_cast<const SnapshotHeader *>(data);
+  if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header.version != SNAPSHOT_VERSION)
+    throw invalid;
+
+  // Section offsets, computed in 64 bits so huge counts can't wrap around the size check
+  uint64_t stringsOffset = sizeof(SnapshotHeader);
+  uint64_t bytesOffset = stringsOffset + uint64_t(header.stringCount) * sizeof(uint32_t);
+  uint64_t substancesOffset = (bytesOffset + header.stringBytes + 3) & ~uint64_t(3);
+  uint64_t rulesOffset = substancesOffset + uint64_t(header.substanceCount) * sizeof(SnapshotSubstance);
+  uint64_t effectsOffset = rulesOffset + uint64_t(header.ruleCount) * sizeof(SnapshotRule);
+  uint64_t multipliersOffset = effectsOffset + uint64_t(header.effectListCount) * sizeof(uint32_t);
+  uint64_t end = multipliersOffset + uint64_t(header.multiplierCount) * sizeof(SnapshotMultiplier);
+  if (end != file.size())
+    throw invalid;
+
+  const uint32_t *stringEnds = reinterpret_cast<const uint32_t *>(data + stringsOffset);
+  const char *stringBytes = reinterpret_cast<const char *>(data + bytesOffset);
+  const SnapshotSubstance *substances = reinterpret_cast<const SnapshotSubstance *>(data + substancesOffset);
+  const SnapshotRule *rules = reinterpret_cast<const SnapshotRule *>(data + rulesOffset);
+  const uint32_t *effectList = reinterpret_cast<const uint32_t *>(data + effectsOffset);
+  const SnapshotMultiplier *multipliers = reinterpret_cast<const SnapshotMultiplier *>(data + multipliersOffset);
+
+  // Each string is materialized once, then copied by index
+  std::vector<std::string> strings;
+  strings.reserve(header.stringCount);
+  uint32_t start = 0;
+  for (uint32_t i = 0; i < header.stringCount; ++i)
+  {
+    if (stringEnds[i] < start || stringEnds[i] > header.stringBytes)
+      throw invalid;
+    strings.emplace_back(stringBytes + start, stringEnds[i] - start);
+    start = stringEnds[i];
+  }
+
+  auto stringAt = [&](uint32_t index) -> const std::string &
+  {
+    if (index >= strings.size())
+      throw invalid;
+    return strings[index];
+  };
+  auto listAt = [&](uint32_t first, uint32_t count)
+  {
+    if (uint64_t(first) + count > header.effectListCount)
+      throw invalid;
+    std::vector<std::string> values;
+    values.reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      values.push_back(stringAt(effectList[first + i]));
+    }
+    return values;
+  };
+
+  Dataset dataset;
+  dataset.substances.reserve(header.substanceCount);
+  for (uint32_t i = 0; i < header.substanceCount; ++i)
+  {
+    const SnapshotSubstance &record = substances[i];
+    if (uint64_t(record.firstRule) + record.ruleCount > header.ruleCount)
+      throw invalid;
+
+    Substance substance;
+    substance.name = stringAt(record.name);
+    substance.cost = record.costCents;
+    substance.defaultEffect = stringAt(record.defaultEffect);
+    substance.rules.reserve(record.ruleCount);
+    for (uint32_t r = record.firstRule; r < record.firstRule + record.ruleCount; ++r)
+    {
+      const SnapshotRule &ruleRecord = rules[r];
+      SubstanceRule rule;
+      rule.type = stringAt(ruleRecord.type);
+      rule.target = stringAt(ruleRecord.target);
+      if (ruleRecord.withEffect != NO_STRING)
+        rule.withEffect = stringAt(ruleRecord.withEffect);
+      rule.condition = listAt(ruleRecord.firstCondition, ruleRecord.conditionCount);
+      rule.ifNotPresent = listAt(ruleRecord.firstIfNotPresent, ruleRecord.ifNotPresentCount);
+      substance.rules.push_back(std::move(rule));
+    }
+    dataset.substances.push_back(std::move(substance));
+  }
+
+  dataset.effectMultipliers.reserve(header.multiplierCount);
+  for (uint32_t i = 0; i < header.multiplierCount; ++i)
+  {
+    dataset.effectMultipliers[stringAt(multipliers[i].effect)] = multipliers[i].multiplier;
+  }
+
+  return dataset;
+}
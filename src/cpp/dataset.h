@@ -0,0 +1,44 @@
+#pragma once
+
+#include "types.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// Substances (with their rules applied) and effect multipliers shared by every search
+// over the same game data
+struct Dataset
+{
+  std::vector<Substance> substances;
+  std::unordered_map<std::string, int> effectMultipliers;
+};
+
+// Parse a dataset from its three JSON documents, as the calculator takes them
+Dataset parseDatasetJson(
+    const std::string &substancesJson,
+    const std::string &effectMultipliersJson,
+    const std::string &substanceRulesJson);
+
+// Binary snapshot of a dataset, so the JSON is parsed once by a converter instead of by
+// every run. Every effect and substance name is interned into one string table, and
+// substances, rules and multipliers are fixed-size records of 32-bit fields referring
+// to it by index. The file is memory-mapped and read in place, so loading it is a
+// bounds check and a walk over the records, not a parse.
+//
+// Layout (little-endian, every section 4-byte aligned):
+//   header     "BFSDATA1", u32 version, u32 string, substance, rule, effect list and
+//              multiplier counts, u32 string byte count
+//   strings    u32 end offset per string, then the UTF-8 bytes, padded to 4 bytes
+//   substances {name, cost cents, default effect, first rule, rule count}
+//   rules      {type, target, with effect (or none), first and count of the
+//              conditions, first and count of the effects that must not be present}
+//   effects    u32 string index per condition and ifNotPresent entry
+//   multipliers {effect, multiplier x100}
+
+// Write a dataset snapshot. Throws std::runtime_error if the file can't be written
+void saveDatasetSnapshot(const std::string &path, const Dataset &dataset);
+
+// Map a dataset snapshot and build the dataset from it. Throws std::runtime_error if the
+// file is missing, truncated or not a snapshot of this version
+Dataset loadDatasetSnapshot(const std::string &path);
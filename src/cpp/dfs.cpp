@@ -2,11 +2,13 @@
 #include <vector>
 #include <cmath>
 #include <memory>
+#include <algorithm>
 
 #include "types.h"
 #include "effects.h"
 #include "pricing.h"
 #include "dfs_algorithm.h"
+#include "metrics.h"
 #include "reporter.h"
 #include "json_parser.h"
 
@@ -39,18 +41,16 @@ JsBestMixResult findBestMixDFSJson(
   return findBestMixDFS(product, substances, effectMultipliers, maxDepth, nullptr);
 }
 
-// Parse JSON input and run DFS with progress reporting
-#ifdef __EMSCRIPTEN__
-EMSCRIPTEN_KEEPALIVE
-#endif
-JsBestMixResult findBestMixDFSJsonWithProgress(
-    std::string productJson,
-    std::string substancesJson,
-    std::string effectMultipliersJson,
-    std::string substanceRulesJson,
+// Parse JSON input and run DFS with progress reporting and search options
+JsBestMixResult findBestMixDFSJsonWithOptions(
+    const std::string &productJson,
+    const std::string &substancesJson,
+    const std::string &effectMultipliersJson,
+    const std::string &substanceRulesJson,
     int maxDepth,
     bool reportProgress,
-    bool useHashingOptimization = true)
+    bool useHashingOptimization,
+    const SearchOptions &options)
 {
   Product product = parseProductJson(productJson);
   std::vector<Substance> substances = parseSubstancesJson(substancesJson);
@@ -64,20 +64,116 @@ JsBestMixResult findBestMixDFSJsonWithProgress(
 #ifdef __EMSCRIPTEN__
   if (reportProgress)
   {
-    // Use the WebAssembly-specific progress reporting function
-    return findBestMixDFS(product, substances, effectMultipliers, maxDepth, reportProgressToJS, useHashingOptimization);
+    // Use the WebAssembly-specific progress reporting function, from which JavaScript
+    // can stop the search through cancelSearch()
+    SearchOptions cancellableOptions = options;
+    cancellableOptions.cancellation = startCancellableSearch();
+    return findBestMixDFS(product, substances, effectMultipliers, maxDepth, reportProgressToJS, useHashingOptimization, cancellableOptions);
   }
   else
 #else
   if (reportProgress)
   {
-    return findBestMixDFS(product, substances, effectMultipliers, maxDepth, reportProgressToConsole, useHashingOptimization);
+    return findBestMixDFS(product, substances, effectMultipliers, maxDepth, reportProgressToConsole, useHashingOptimization, options);
   }
   else
 #endif
   {
-    return findBestMixDFS(product, substances, effectMultipliers, maxDepth, nullptr, useHashingOptimization);
+    return findBestMixDFS(product, substances, effectMultipliers, maxDepth, nullptr, useHashingOptimization, options);
+  }
+}
+
+// Parse JSON input and run DFS with progress reporting
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+JsBestMixResult findBestMixDFSJsonWithProgress(
+    std::string productJson,
+    std::string substancesJson,
+    std::string effectMultipliersJson,
+    std::string substanceRulesJson,
+    int maxDepth,
+    bool reportProgress,
+    bool useHashingOptimization = true)
+{
+  return findBestMixDFSJsonWithOptions(
+      productJson, substancesJson, effectMultipliersJson, substanceRulesJson,
+      maxDepth, reportProgress, useHashingOptimization, SearchOptions());
+}
+
+// Parse JSON input and run DFS, also returning the topK best mixes with distinct effect sets
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+JsBestMixResult findBestMixDFSJsonTopK(
+    std::string productJson,
+    std::string substancesJson,
+    std::string effectMultipliersJson,
+    std::string substanceRulesJson,
+    int maxDepth,
+    bool reportProgress,
+    bool useHashingOptimization,
+    int topK)
+{
+  SearchOptions options;
+  options.topK = static_cast<size_t>(std::max(1, topK));
+  return findBestMixDFSJsonWithOptions(
+      productJson, substancesJson, effectMultipliersJson, substanceRulesJson,
+      maxDepth, reportProgress, useHashingOptimization, options);
+}
+
+// Parse JSON input and run DFS under the constraints in constraintsJson (see
+// parseSearchConstraintsJson), also returning the topK best mixes with distinct effect sets
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+JsBestMixResult findBestMixDFSJsonConstrained(
+    std::string productJson,
+    std::string substancesJson,
+    std::string effectMultipliersJson,
+    std::string substanceRulesJson,
+    int maxDepth,
+    bool reportProgress,
+    bool useHashingOptimization,
+    int topK,
+    std::string constraintsJson)
+{
+  SearchOptions options;
+  options.topK = static_cast<size_t>(std::max(1, topK));
+  options.constraints = parseSearchConstraintsJson(constraintsJson);
+  return findBestMixDFSJsonWithOptions(
+      productJson, substancesJson, effectMultipliersJson, substanceRulesJson,
+      maxDepth, reportProgress, useHashingOptimization, options);
+}
+
+// Parse JSON input and run DFS in anytime mode: each depth's result is reported as soon
+// as it's proven, and the search stops with its best mix so far after deadlineMs (0 = no
+// deadline)
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+JsBestMixResult findBestMixDFSJsonAnytime(
+    std::string productJson,
+    std::string substancesJson,
+    std::string effectMultipliersJson,
+    std::string substanceRulesJson,
+    int maxDepth,
+    bool reportProgress,
+    bool useHashingOptimization,
+    int deadlineMs)
+{
+  SearchOptions options;
+  options.anytime = true;
+  if (deadlineMs > 0)
+  {
+    options.setTimeLimit(deadlineMs);
   }
+#ifdef __EMSCRIPTEN__
+  options.depthResultCallback = reportDepthResultToJS;
+#endif
+  return findBestMixDFSJsonWithOptions(
+      productJson, substancesJson, effectMultipliersJson, substanceRulesJson,
+      maxDepth, reportProgress, useHashingOptimization, options);
 }
 
 // Emscripten bindings - only include in WebAssembly build
@@ -87,5 +183,12 @@ EMSCRIPTEN_BINDINGS(dfs_module)
   // Reuse the JsBestMixResult binding from BFS module
   function("findBestMixDFSJson", &findBestMixDFSJson);
   function("findBestMixDFSJsonWithProgress", &findBestMixDFSJsonWithProgress);
+  function("findBestMixDFSJsonTopK", &findBestMixDFSJsonTopK);
+  function("findBestMixDFSJsonConstrained", &findBestMixDFSJsonConstrained);
+  function("findBestMixDFSJsonAnytime", &findBestMixDFSJsonAnytime);
+
+  // Latest metrics sample of the running search as JSON, refreshed whenever progress is
+  // reported, so the progress callback can poll it
+  function("getSearchMetricsJson", &latestSearchMetricsJson);
 }
 #endif
\ No newline at end of file
@@ -6,30 +6,65 @@
 #include <thread>
 #include <mutex>
 #include <functional>
+#include <algorithm>
 #include <cmath>
 #include <limits>
+#include <memory>
+#include <climits>
+#include <chrono>
+#include <condition_variable>
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten/val.h>
 #include <emscripten/threading.h>
 using namespace emscripten;
+#else
+#include "checkpoint.h"
 #endif
 
 // Define global variables for thread synchronization
-std::mutex g_bestMixMutex;
 std::atomic<int64_t> g_totalProcessedCombinations(0);
 std::atomic<bool> g_shouldTerminate(false);
+std::atomic<int> g_sharedTopThresholdCents(INT_MIN);
+std::atomic<int64_t> g_prunedSubtrees(0);
+std::atomic<int64_t> g_prunedCombinations(0);
+std::atomic<int64_t> g_dominatedSubtrees(0);
 const int MAX_SUBSTANCES = 16; // Maximum number of substances
 const int MAX_DEPTH = 10;      // Maximum depth for the mix
 
 // Mutex for console output
 std::mutex g_consoleMutex;
 
+// Raise an atomic to at least the given value
+static void atomicMax(std::atomic<int> &target, int value)
+{
+  int current = target.load(std::memory_order_relaxed);
+  while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+  {
+  }
+}
+
+// Longest wait between two deadline, cancellation and best mix checks while native workers run
+const int DEADLINE_POLL_MS = 10;
+
+// Mixes the single-threaded search evaluates between looks at the clock
+static const int CLOCK_CHECK_INTERVAL = 4096;
+
+bool stopRequested(const SearchOptions &options)
+{
+  if ((options.cancellation && options.cancellation->cancelled()) ||
+      (options.hasDeadline() && std::chrono::steady_clock::now() >= options.deadline))
+  {
+    g_shouldTerminate = true;
+  }
+  return g_shouldTerminate;
+}
+
 // DFSState implementation
 DFSState::DFSState() : depth(0), currentCost(0), stateHash(0)
 {
   // Initialize all indices to -1 (not used)
-  for (int i = 0; i < 16; ++i)
+  for (size_t i = 0; i < MAX_MIX_LENGTH; ++i)
   {
     substanceIndices[i] = -1;
   }
@@ -37,7 +72,7 @@ DFSState::DFSState() : depth(0), currentCost(0), stateHash(0)
 
 void DFSState::addSubstance(int index, const std::vector<Substance> &substances)
 {
-  if (depth < 16)
+  if (depth < static_cast<int>(MAX_MIX_LENGTH))
   {
     substanceIndices[depth] = index;
     currentCost += substances[index].cost; // Add the cost in cents
@@ -76,6 +111,16 @@ std::vector<std::string> DFSState::toSubstanceNames(const std::vector<Substance>
   return names;
 }
 
+void DFSState::printSubstanceNames(std::ostream &out, const std::vector<Substance> &substances) const
+{
+  for (int i = 0; i < depth; ++i)
+  {
+    if (i > 0)
+      out << ", ";
+    out << substances[substanceIndices[i]].name;
+  }
+}
+
 MixState DFSState::toMixState() const
 {
   MixState mix(depth); // Only allocate what we need
@@ -89,227 +134,413 @@ MixState DFSState::toMixState() const
   return mix;
 }
 
-// DFS Worker function for each thread
-void dfsThreadWorker(
-    const Product &product,
-    const std::vector<Substance> &substances,
-    const std::unordered_map<std::string, int> &effectMultipliers,
-    int startSubstanceIndex,
-    int maxDepth,
-    int64_t expectedCombinations,
-    MixState &globalBestMix,
-    int &globalBestProfitCents,
-    int &globalBestSellPriceCents,
-    int &globalBestCostCents,
-    ProgressCallback progressCallback,
-    bool useHashingOptimization)
+std::vector<DFSWorkUnit> buildDFSWorkUnits(size_t substanceCount, int maxDepth, int prefixDepth)
 {
-  // Initialize thread-local best mix data
-  DFSState currentState;
-  MixState threadBestMix(maxDepth);
-  int threadBestProfitCents = -std::numeric_limits<int>::infinity();
-  int threadBestSellPriceCents = 0;
-  int threadBestCostCents = 0;
+  int length = std::max(1, std::min(std::min(prefixDepth, MAX_DFS_PREFIX_DEPTH), maxDepth));
+  std::vector<DFSWorkUnit> units;
+
+  // Mixes shorter than the prefix length are single-node units, listed first since they're cheap.
+  // Every prefix of the full length then owns the subtree below it
+  for (int unitLength = 1; unitLength <= length; ++unitLength)
+  {
+    DFSWorkUnit unit;
+    unit.length = unitLength;
+    unit.maxDepth = unitLength < length ? unitLength : maxDepth;
+    for (int i = 0; i < unitLength; ++i)
+    {
+      unit.prefix[i] = 0;
+    }
+
+    // Enumerate every prefix of this length like an odometer
+    while (true)
+    {
+      units.push_back(unit);
+
+      int position = unitLength - 1;
+      while (position >= 0 && ++unit.prefix[position] >= static_cast<int>(substanceCount))
+      {
+        unit.prefix[position] = 0;
+        --position;
+      }
+      if (position < 0)
+        break;
+    }
+  }
 
-  // Initialize with the starting substance
-  currentState.addSubstance(startSubstanceIndex, substances);
+  return units;
+}
 
-  // Create a set of all effect names for fast lookups
-  std::unordered_map<std::string, bool> effectsSet;
-  effectsSet.reserve(effectMultipliers.size() * 2);
-  for (const auto &pair : effectMultipliers)
+std::vector<DFSWorkUnit> selectShardUnits(const std::vector<DFSWorkUnit> &units, int shardIndex, int shardCount)
+{
+  std::vector<DFSWorkUnit> shardUnits;
+  for (size_t i = static_cast<size_t>(shardIndex); i < units.size(); i += static_cast<size_t>(shardCount))
   {
-    effectsSet[pair.first] = true;
+    shardUnits.push_back(units[i]);
   }
+  return shardUnits;
+}
 
-  // Initialize the optimized effects cache with the hashing flag
-  EffectsCache effectsCache(maxDepth, product.initialEffect, useHashingOptimization);
+// Depth limit of a DFS kernel known at compile time. The depths users pick get one each
+template <int Depth>
+struct FixedDepth
+{
+  static constexpr int capacity = Depth;
+  int value() const { return Depth; }
+};
 
-  // Pre-calculate effects for the first substance (which is already added)
-  std::vector<std::string> effectsList = applySubstanceRules(
-      effectsCache.depthCache[0], substances[startSubstanceIndex], 1, effectsSet);
+// Depth limit of the generic DFS kernel, for every other depth
+struct RuntimeDepth
+{
+  static constexpr int capacity = static_cast<int>(MAX_MIX_LENGTH);
+  explicit RuntimeDepth(int depth) : depth(depth) {}
+  int value() const { return depth; }
+  int depth;
+};
 
-  // Cache the effects at depth 1
-  effectsCache.cacheEffects(1, effectsList);
+// DFS Worker function for each thread - processes work units until the pool runs dry
+void dfsThreadWorker(
+    const Product &product,
+    const std::vector<Substance> &substances,
+    const CompiledEffects &compiled,
+    const PricingContext &pricing,
+    const std::vector<DFSWorkUnit> &units,
+    WorkStealingPool &pool,
+    int workerIndex,
+    int maxDepth,
+    SharedBestMix &best,
+    ThreadCounters &counters,
+    TransitionTable *transitions,
+    StatePriceCache *prices,
+    const ProfitBound *bound,
+    TopMixList *topMixes,
+    DominanceTable *dominance,
+    std::atomic<uint8_t> *completedUnits,
+    const ConstraintFilter *constraints)
+{
+  // The thread's best profit, kept across work units so the shared best is only touched
+  // when this thread beats its own best. Reporting it is left to the thread that started
+  // the search, so workers never wait on the console or callbacks
+  DFSState currentState;
+  int threadBestProfitCents = best.profitCents();
 
-  // Also cache in the substance-specific map for potential reuse
-  effectsCache.cacheCalculatedEffects(startSubstanceIndex, effectsCache.depthCache[0], effectsList);
+  // Initialize the optimized effects cache on top of the shared transition table, with
+  // this thread's own copy of the flattened rules for expanding children in blocks
+  RuleKernel kernel(compiled);
+  EffectsCache effectsCache(maxDepth, compiled.initialEffects, transitions, prices, &kernel);
 
-  // Process the first node (already added substance)
+  // Score the mix in currentState, whose effects are cached at the given depth
+  auto evaluateCurrentMix = [&](int depth)
   {
-    // Calculate monetary values for the first node
-    int sellPriceCents = calculateFinalPrice(product.name, effectsList, effectMultipliers);
+    if (constraints && !constraints->accepts(effectsCache.depthCache[depth], currentState.currentCost, depth))
+      return;
+
+    // Calculate monetary values for the mix
+    int sellPriceCents = effectsCache.getSellPrice(depth, pricing);
     int costCents = currentState.currentCost;
     int profitCents = sellPriceCents - costCents;
 
-    // Update best mix if this one is better
+    // Publish the mix if it beats this thread's best
     if (profitCents > threadBestProfitCents)
     {
-      threadBestMix = currentState.toMixState();
       threadBestProfitCents = profitCents;
-      threadBestSellPriceCents = sellPriceCents;
-      threadBestCostCents = costCents;
-
-      // Update global best mix (thread-safe)
-      std::lock_guard<std::mutex> lock(g_bestMixMutex);
-      if (threadBestProfitCents > globalBestProfitCents)
-      {
-        globalBestMix = threadBestMix;
-        globalBestProfitCents = threadBestProfitCents;
-        globalBestSellPriceCents = threadBestSellPriceCents;
-        globalBestCostCents = threadBestCostCents;
-
-        // Report best mix
-        {
-          std::lock_guard<std::mutex> consoleLock(g_consoleMutex);
-          std::vector<std::string> mixNames = currentState.toSubstanceNames(substances);
-          std::cout << "Best mix so far: [";
-          for (size_t i = 0; i < mixNames.size(); ++i)
-          {
-            if (i > 0)
-              std::cout << ", ";
-            std::cout << mixNames[i];
-          }
-          std::cout << "] with profit " << threadBestProfitCents / 100.0
-                    << ", price " << threadBestSellPriceCents / 100.0
-                    << ", cost " << threadBestCostCents / 100.0 << std::endl;
-        }
-      }
+      best.publish(workerIndex, currentState.substanceIndices, depth, profitCents, sellPriceCents, costCents);
     }
-  }
 
-  // Count the first node
-  g_totalProcessedCombinations.fetch_add(1, std::memory_order_relaxed);
-
-  // Use a stack-based iterative DFS approach
-  // Each entry represents (substance_index, depth)
-  struct StackEntry
-  {
-    size_t substanceIndex;
-    size_t depth;
+    // Offer the mix to this thread's top list and share the list's threshold as the bound
+    if (topMixes && topMixes->admits(profitCents, costCents, depth) &&
+        topMixes->insert(currentState.toMixState(), effectsCache.depthCache[depth],
+                         profitCents, sellPriceCents, costCents))
+    {
+      atomicMax(g_sharedTopThresholdCents, topMixes->thresholdCents());
+    }
   };
 
-  std::vector<StackEntry> stack;
-  stack.reserve(maxDepth);
-
-  // If we should go deeper, add the first candidate for depth 2
-  if (maxDepth > 1)
-  {
-    stack.push_back({0, 2});
-  }
-
-  while (!stack.empty() && !g_shouldTerminate)
+  // Decide whether to search below the mix in currentState, cutting the subtree when no
+  // extension can satisfy the constraints, when its profit bound can't beat the shared
+  // best, or when another path already expanded the same effect set at this depth for no
+  // more than this mix costs. Skipped mixes are counted by subtree size, so progress
+  // doesn't stall behind what was cut
+  const std::vector<int64_t> subtreeSizes = mixCountsByDepth(substances.size(), maxDepth);
+  auto shouldDescend = [&](int depth, int limit)
   {
-    // Get the top entry without popping
-    StackEntry &current = stack.back();
+    int remaining = limit - depth;
+    if (constraints && !constraints->canExtend(effectsCache.depthCache[depth], currentState.currentCost, depth))
+    {
+      ThreadCounters::add(counters.prunedSubtrees, 1);
+      ThreadCounters::add(counters.prunedNodes, subtreeSizes[remaining]);
+      return false;
+    }
 
-    // If we've exhausted substances at this depth, backtrack
-    if (current.substanceIndex >= substances.size())
+    if (bound)
     {
-      stack.pop_back();
-      // Backtrack if we have more than just the initial substance
-      if (currentState.depth > 1)
+      int bestPossible = bound->maxExtensionProfit(effectsCache.depthCache[depth], currentState.currentCost, remaining);
+      int bestKnown = topMixes ? g_sharedTopThresholdCents.load(std::memory_order_relaxed) : best.profitCents();
+      if (bestPossible <= bestKnown)
       {
-        currentState.removeLastSubstance(substances);
+        ThreadCounters::add(counters.prunedSubtrees, 1);
+        ThreadCounters::add(counters.prunedNodes, subtreeSizes[remaining]);
+        return false;
       }
-      continue;
     }
 
-    // Add the current substance
-    currentState.addSubstance(current.substanceIndex, substances);
-
-    // Calculate effects efficiently, checking for cached results first
-    const int substanceIndex = current.substanceIndex;
-    const size_t currentDepth = current.depth;
-    const auto &parentEffects = effectsCache.depthCache[currentDepth - 1];
-
-    // Use direct cache lookup using the substance+parent combo
-    if (effectsCache.hasCalculatedEffects(substanceIndex, parentEffects))
+    int32_t state = effectsCache.depthStates[depth];
+    if (dominance && state >= 0 && !dominance->claim(state, depth, currentState.currentCost))
     {
-      // Get pre-calculated effects - no need to reapply rules
-      effectsList = effectsCache.getCachedEffects(substanceIndex, parentEffects);
+      ThreadCounters::add(counters.dominatedSubtrees, 1);
+      ThreadCounters::add(counters.dominatedNodes, subtreeSizes[remaining]);
+      return false;
     }
-    else
-    {
-      // Calculate effects from parent effects
-      effectsList = applySubstanceRules(
-          parentEffects,
-          substances[substanceIndex],
-          currentDepth,
-          effectsSet);
+    return true;
+  };
 
-      // Cache for potential reuse with same substance+parent combo
-      effectsCache.cacheCalculatedEffects(substanceIndex, parentEffects, effectsList);
-    }
+  // Search every unit this worker takes with the depth limit given by `limit`, a
+  // FixedDepth for the common depths, so their kernel compares against a constant and
+  // keeps its stack in an array of exactly the right size
+  auto searchUnits = [&](auto limit)
+  {
+    using Limit = decltype(limit);
+    const int depthLimit = limit.value();
+    const size_t substanceCount = substances.size();
 
-    // Always update the depth cache
-    effectsCache.cacheEffects(currentDepth, effectsList);
+    // Next substance to try at each depth below the unit's prefix
+    size_t next[Limit::capacity + 1];
 
-    // Update progress and count this combination
-    g_totalProcessedCombinations.fetch_add(1, std::memory_order_relaxed);
+    // Score every child of the mix in currentState, which is one short of the limit.
+    // Leaves never descend, so they skip the stack
+    auto searchLeaves = [&](int depth)
+    {
+      for (size_t substanceIndex = 0; substanceIndex < substanceCount && !g_shouldTerminate; ++substanceIndex)
+      {
+        currentState.addSubstance(static_cast<int>(substanceIndex), substances);
+        effectsCache.advance(static_cast<int>(substanceIndex), depth, compiled.substances[substanceIndex]);
+        counters.addNode(depth);
+        evaluateCurrentMix(depth);
+        currentState.removeLastSubstance(substances);
+      }
+    };
 
-    // Adaptively adjust progress reporting frequency
-    int reportFrequency = 10000000;
+    // Search below the mix in currentState, at the given depth, unless it's cut
+    auto descend = [&](int &depth)
+    {
+      if (!shouldDescend(depth, depthLimit))
+        return false;
+      effectsCache.expandChildren(depth + 1);
+      if (depth + 1 == depthLimit)
+      {
+        searchLeaves(depth + 1);
+        return false;
+      }
+      next[++depth] = 0;
+      return true;
+    };
 
-    // Report progress periodically
-    if (progressCallback && (g_totalProcessedCombinations.load() % reportFrequency == 0))
+    size_t unitIndex;
+    while (!g_shouldTerminate && pool.next(workerIndex, unitIndex))
     {
-      progressCallback(current.depth, g_totalProcessedCombinations.load(), expectedCombinations);
-    }
+      // Finished before a checkpoint this search was resumed from
+      if (completedUnits && completedUnits[unitIndex].load(std::memory_order_relaxed))
+        continue;
 
-    // Calculate profit for the current mix
-    int sellPriceCents = calculateFinalPrice(product.name, effectsList, effectMultipliers);
-    int costCents = currentState.currentCost;
-    int profitCents = sellPriceCents - costCents;
+      const DFSWorkUnit &unit = units[unitIndex];
+      auto unitStart = std::chrono::steady_clock::now();
 
-    // Update best mix if needed
-    if (profitCents > threadBestProfitCents)
-    {
-      threadBestMix = currentState.toMixState();
-      threadBestProfitCents = profitCents;
-      threadBestSellPriceCents = sellPriceCents;
-      threadBestCostCents = costCents;
+      // Replay the unit's prefix
+      currentState = DFSState();
+      for (int i = 0; i < unit.length; ++i)
+      {
+        currentState.addSubstance(unit.prefix[i], substances);
+        effectsCache.advance(unit.prefix[i], i + 1, compiled.substances[unit.prefix[i]]);
+      }
 
-      // Update global best mix (thread-safe)
-      std::lock_guard<std::mutex> lock(g_bestMixMutex);
-      if (threadBestProfitCents > globalBestProfitCents)
+      // Process the prefix node itself
+      evaluateCurrentMix(unit.length);
+      counters.addNode(unit.length);
+
+      // Units that own a subtree reach the search's depth limit; the rest are single nodes
+      int depth = unit.length;
+      if (unit.maxDepth > unit.length)
       {
-        globalBestMix = threadBestMix;
-        globalBestProfitCents = threadBestProfitCents;
-        globalBestSellPriceCents = threadBestSellPriceCents;
-        globalBestCostCents = threadBestCostCents;
+        descend(depth);
+      }
 
-        // Report best mix
+      while (depth > unit.length && !g_shouldTerminate)
+      {
+        // If we've exhausted substances at this depth, backtrack to its parent
+        if (next[depth] >= substanceCount)
         {
-          std::lock_guard<std::mutex> consoleLock(g_consoleMutex);
-          std::vector<std::string> mixNames = currentState.toSubstanceNames(substances);
-          std::cout << "Best mix so far: [";
-          for (size_t i = 0; i < mixNames.size(); ++i)
+          --depth;
+          if (depth > unit.length)
           {
-            if (i > 0)
-              std::cout << ", ";
-            std::cout << mixNames[i];
+            currentState.removeLastSubstance(substances);
           }
-          std::cout << "] with profit " << threadBestProfitCents / 100.0
-                    << ", price " << threadBestSellPriceCents / 100.0
-                    << ", cost " << threadBestCostCents / 100.0 << std::endl;
+          continue;
+        }
+
+        // Add the next substance and calculate its effects from the parent cached at the
+        // previous depth
+        const int substanceIndex = static_cast<int>(next[depth]++);
+        currentState.addSubstance(substanceIndex, substances);
+        effectsCache.advance(substanceIndex, depth, compiled.substances[substanceIndex]);
+
+        // Count this combination on this thread's own counters; progress is reported by
+        // whoever samples them
+        counters.addNode(depth);
+        evaluateCurrentMix(depth);
+
+        // Go deeper with the first substance, or try the next substance at this level
+        if (!descend(depth))
+        {
+          currentState.removeLastSubstance(substances);
         }
       }
+
+      // Backtracking past the prefix means the whole subtree was searched, not cut short
+      // by termination
+      if (depth == unit.length && !g_shouldTerminate)
+      {
+        ThreadCounters::add(counters.completedUnits, 1);
+        if (completedUnits)
+          completedUnits[unitIndex].store(1, std::memory_order_release);
+      }
+
+      counters.cacheHits.store(effectsCache.tableHits, std::memory_order_relaxed);
+      counters.cacheMisses.store(effectsCache.tableMisses, std::memory_order_relaxed);
+      ThreadCounters::add(counters.busyMicros, std::chrono::duration_cast<std::chrono::microseconds>(
+                                                   std::chrono::steady_clock::now() - unitStart)
+                                                   .count());
+    }
+  };
+
+  // Depths 1 to 10 have a kernel of their own, deeper searches share the generic one
+  switch (maxDepth)
+  {
+  case 1:
+    searchUnits(FixedDepth<1>());
+    break;
+  case 2:
+    searchUnits(FixedDepth<2>());
+    break;
+  case 3:
+    searchUnits(FixedDepth<3>());
+    break;
+  case 4:
+    searchUnits(FixedDepth<4>());
+    break;
+  case 5:
+    searchUnits(FixedDepth<5>());
+    break;
+  case 6:
+    searchUnits(FixedDepth<6>());
+    break;
+  case 7:
+    searchUnits(FixedDepth<7>());
+    break;
+  case 8:
+    searchUnits(FixedDepth<8>());
+    break;
+  case 9:
+    searchUnits(FixedDepth<9>());
+    break;
+  case 10:
+    searchUnits(FixedDepth<10>());
+    break;
+  default:
+    searchUnits(RuntimeDepth(maxDepth));
+    break;
+  }
+}
+
+// Seed the next depth of an anytime search with the best mix of a finished one
+static SearchSeed seedFromResult(const JsBestMixResult &result, const std::vector<Substance> &substances)
+{
+  std::vector<std::string> names;
+#ifdef __EMSCRIPTEN__
+  unsigned length = result.mixArray["length"].as<unsigned>();
+  for (unsigned i = 0; i < length; ++i)
+  {
+    names.push_back(result.mixArray[i].as<std::string>());
+  }
+#else
+  names = result.mixArray;
+#endif
+
+  SearchSeed seed;
+  for (const std::string &name : names)
+  {
+    auto it = std::find_if(substances.begin(), substances.end(),
+                           [&](const Substance &substance)
+                           { return substance.name == name; });
+    if (it == substances.end())
+      return SearchSeed();
+    seed.mix.addSubstance(static_cast<size_t>(it - substances.begin()));
+  }
+  seed.profitCents = result.profitCents;
+  seed.sellPriceCents = result.sellPriceCents;
+  seed.costCents = result.costCents;
+  seed.valid = !names.empty();
+  return seed;
+}
+
+// Iterative deepening: solve depth 1, 2, ... maxDepth in turn, each seeded with the best
+// mix of the depth before so branch-and-bound has a tight bound from the first node.
+// Each depth's result is reported as soon as it's proven, and a deadline or cancel
+// stops the search with the best result so far
+static JsBestMixResult findBestMixAnytime(
+    const Product &product,
+    const std::vector<Substance> &substances,
+    const std::unordered_map<std::string, int> &effectMultipliers,
+    int maxDepth,
+    ProgressCallback progressCallback,
+    bool useHashingOptimization,
+    const SearchOptions &options)
+{
+  SearchOptions depthOptions = options;
+  depthOptions.anytime = false;
+  depthOptions.pruning = true;
+  depthOptions.checkpointFile.clear(); // Only the last depth is long enough to checkpoint
+
+  JsBestMixResult best = JsBestMixResult();
+  bool haveBest = false;
+
+  for (int depth = 1; depth <= maxDepth; ++depth)
+  {
+    // A depth can't finish after the deadline or a cancel, so don't start it. The raised flag tells
+    // the caller the search is incomplete
+    if (stopRequested(options))
+      break;
+
+    if (depth == maxDepth)
+    {
+      depthOptions.checkpointFile = options.checkpointFile;
     }
+    JsBestMixResult result = findBestMixDFS(product, substances, effectMultipliers, depth,
+                                            progressCallback, useHashingOptimization, depthOptions);
+    bool complete = !g_shouldTerminate;
 
-    // If we haven't reached max depth, go deeper with the first substance
-    if (current.depth < maxDepth)
+    // An interrupted depth only replaces the last finished one if it found a better mix
+    if (complete || !haveBest || result.profitCents > best.profitCents)
     {
-      current.substanceIndex++;                // Move to next substance at current level
-      stack.push_back({0, current.depth + 1}); // Push the next level starting at substance 0
+      best = result;
+      haveBest = true;
     }
-    else
+
     {
-      // At max depth, try the next substance at this level
-      currentState.removeLastSubstance(substances);
-      current.substanceIndex++;
+      std::lock_guard<std::mutex> lock(g_consoleMutex);
+      std::cout << "Anytime search " << (complete ? "finished" : "stopped during") << " depth " << depth
+                << " with profit " << result.profitCents / 100.0 << std::endl;
     }
+
+    if (options.depthResultCallback)
+    {
+      options.depthResultCallback(depth, result, complete);
+    }
+
+    if (!complete)
+      break;
+    depthOptions.seed = seedFromResult(result, substances);
   }
+
+  return best;
 }
 
 // Main DFS algorithm with threading
@@ -319,47 +550,124 @@ JsBestMixResult findBestMixDFS(
     const std::unordered_map<std::string, int> &effectMultipliers,
     int maxDepth,
     ProgressCallback progressCallback,
-    bool useHashingOptimization)
+    bool useHashingOptimization,
+    const SearchOptions &options)
 {
+  // Search only the allowed substances, no deeper than an exact length asks for
+  std::vector<Substance> narrowedSubstances;
+  int narrowedDepth;
+  SearchOptions narrowedOptions;
+  if (narrowSearch(substances, maxDepth, options, narrowedSubstances, narrowedDepth, narrowedOptions))
+  {
+    return findBestMixDFS(product, narrowedSubstances, effectMultipliers, narrowedDepth,
+                          progressCallback, useHashingOptimization, narrowedOptions);
+  }
+
+  if (options.anytime)
+  {
+    return findBestMixAnytime(product, substances, effectMultipliers, maxDepth,
+                              progressCallback, useHashingOptimization, options);
+  }
+
   // Reset global counters
   g_totalProcessedCombinations = 0;
   g_shouldTerminate = false;
+  stopRequested(options);
+  g_sharedTopThresholdCents = INT_MIN;
+  g_prunedSubtrees = 0;
+  g_prunedCombinations = 0;
+  g_dominatedSubtrees = 0;
 
   // Log optimization status
   {
     std::lock_guard<std::mutex> lock(g_consoleMutex);
     std::cout << "DFS algorithm running with " << (useHashingOptimization ? "ENABLED" : "DISABLED")
-              << " hashing optimization" << std::endl;
+              << " hashing optimization and the " << RuleKernel::instructionSet() << " rule kernel" << std::endl;
   }
 
-  // Initialize best mix variables
-  MixState bestMix(maxDepth);
-  int bestProfitCents = -std::numeric_limits<int>::infinity();
-  int bestSellPriceCents = 0;
-  int bestCostCents = 0;
+  // Compile effect names and substance rules to bitmask form once for the whole search
+  CompiledEffects compiled = compileEffects(product, substances, effectMultipliers);
+  PricingContext pricing(product, compiled.registry, effectMultipliers);
+
+  // Shared transition table and sell price memo, filled lazily by all threads
+  // A table shared between searches keeps the states earlier ones already expanded
+  std::unique_ptr<TransitionTable> transitions;
+  std::unique_ptr<StatePriceCache> prices;
+  TransitionTable *transitionsPtr = nullptr;
+  if (useHashingOptimization && compiled.valid)
+  {
+    if (options.sharedTransitions && sameRuleTables(options.sharedTransitions->compiledEffects(), compiled))
+    {
+      transitionsPtr = options.sharedTransitions;
+    }
+    else
+    {
+      transitions.reset(new TransitionTable(compiled, options.transitionTableStates));
+      transitionsPtr = transitions.get();
+    }
+    prices.reset(new StatePriceCache(transitionsPtr->capacity()));
+  }
+  StatePriceCache *pricesPtr = prices.get();
 
-  // Calculate total expected combinations for progress reporting
-  // Use 64-bit integer to avoid overflow at high depths
-  int64_t totalCombinations64 = 0;
-  size_t substanceCount = std::min(static_cast<size_t>(MAX_SUBSTANCES), substances.size());
-  for (size_t i = 1; i <= static_cast<size_t>(maxDepth); ++i)
+  // Profit upper bound for branch-and-bound pruning
+  std::unique_ptr<ProfitBound> bound;
+  if (options.pruning && compiled.valid)
   {
-    // Use pow with doubles and then cast to int64_t to handle large values
-    totalCombinations64 += static_cast<int64_t>(pow(static_cast<double>(substanceCount), static_cast<double>(i)));
+    bound.reset(new ProfitBound(substances, compiled, pricing, maxDepth));
   }
+  const ProfitBound *boundPtr = bound.get();
 
-  // Use the full 64-bit value for total combinations
-  int64_t totalCombinations = totalCombinations64;
+  // Budget, effect and length constraints, checked on every mix and before every descent
+  std::unique_ptr<ConstraintFilter> constraints;
+  if (options.constraints.any() && compiled.valid)
+  {
+    constraints.reset(new ConstraintFilter(options.constraints, substances, compiled));
+  }
+  const ConstraintFilter *constraintsPtr = constraints.get();
 
-#ifndef __EMSCRIPTEN__
-  // If we'll exceed INT_MAX, print an informational message (native only)
-  if (totalCombinations64 > INT_MAX)
+  // Cheapest expansion of each (depth, effect set) state, for skipping duplicate subtrees.
+  // States are the transition table's, so it's only available with the hashing optimization
+  std::unique_ptr<DominanceTable> dominance;
+  if (options.dominance && transitionsPtr)
+  {
+    dominance.reset(new DominanceTable(transitionsPtr->capacity(), maxDepth));
+  }
+  else if (options.dominance)
   {
     std::lock_guard<std::mutex> lock(g_consoleMutex);
-    std::cout << "INFO: Total combinations (" << totalCombinations64
-              << ") exceeds INT_MAX. Using 64-bit progress reporting." << std::endl;
+    std::cout << "Dominance table needs the hashing optimization, searching without it" << std::endl;
   }
-#endif
+  DominanceTable *dominancePtr = dominance.get();
+
+  // Best mixes with distinct effect sets, when more than the single best is wanted.
+  // Threads fill their own lists, which are merged into this one when they finish
+  std::unique_ptr<TopMixList> topMixes;
+  if (options.wantsTopList())
+  {
+    topMixes.reset(new TopMixList(options));
+  }
+
+  // Initialize best mix variables
+  DFSState bestMix;
+  int bestProfitCents = -std::numeric_limits<int>::infinity();
+  int bestSellPriceCents = 0;
+  int bestCostCents = 0;
+
+  // Start from the seed mix, if any, so pruning has a bound before the first node
+  if (options.seed.valid && options.seed.mix.substanceIndices.size() <= static_cast<size_t>(maxDepth))
+  {
+    for (size_t index : options.seed.mix.substanceIndices)
+    {
+      bestMix.addSubstance(static_cast<int>(index), substances);
+    }
+    bestProfitCents = options.seed.profitCents;
+    bestSellPriceCents = options.seed.sellPriceCents;
+    bestCostCents = options.seed.costCents;
+  }
+
+  // Size of the search space for progress reporting, saturating at very large depths
+  const std::vector<int64_t> mixCounts = mixCountsByDepth(substances.size(), std::max(maxDepth, 0));
+  int64_t totalCombinations = mixCounts.back();
 
   // Initial progress report
   if (progressCallback)
@@ -367,6 +675,24 @@ JsBestMixResult findBestMixDFS(
     progressCallback(1, 0, totalCombinations);
   }
 
+  // Per-thread counters of the search, and what's done with each sample of them
+  std::unique_ptr<SearchMetrics> metrics;
+  auto reportSample = [&](const MetricsSnapshot &snapshot)
+  {
+#ifdef __EMSCRIPTEN__
+    publishSearchMetrics(snapshot);
+#endif
+    // Progress counts the mixes skipped with pruned and dominated subtrees as done too
+    if (progressCallback)
+    {
+      progressCallback(maxDepth, snapshot.coveredNodes, snapshot.totalNodes);
+    }
+    if (options.metricsCallback)
+    {
+      options.metricsCallback(snapshot.toJson());
+    }
+  };
+
   // Check if we can use threads
   bool canUseThreads = true; // Default true for native builds
 
@@ -374,47 +700,290 @@ JsBestMixResult findBestMixDFS(
 // For WebAssembly, check if threading is supported
 #ifdef __EMSCRIPTEN_PTHREADS__
   canUseThreads = emscripten_has_threading_support();
-  canUseThreads = false; // Disable threading for now
 #else
   canUseThreads = false; // No threading support in this build
 #endif
 #endif
 
-  if (canUseThreads)
+  if (!compiled.valid)
+  {
+    std::lock_guard<std::mutex> lock(g_consoleMutex);
+    std::cerr << "Error: more than " << MAX_EFFECT_IDS << " distinct effects, cannot run DFS" << std::endl;
+  }
+  else if (maxDepth > static_cast<int>(MAX_MIX_LENGTH))
+  {
+    std::lock_guard<std::mutex> lock(g_consoleMutex);
+    std::cerr << "Error: DFS supports mixes of at most " << MAX_MIX_LENGTH << " substances" << std::endl;
+  }
+  else if (substances.empty())
+  {
+    std::lock_guard<std::mutex> lock(g_consoleMutex);
+    std::cout << "No substances to search" << std::endl;
+  }
+  else if (canUseThreads)
   {
     // Multi-threaded implementation (native or WebAssembly with threading)
-    // Create a set of all effect names for efficiency
-    std::unordered_map<std::string, bool> effectsSet;
-    effectsSet.reserve(effectMultipliers.size() * 2);
-    for (const auto &pair : effectMultipliers)
+    // Split the search tree into prefix work units and let the threads steal them from each other
+    std::vector<DFSWorkUnit> units = buildDFSWorkUnits(substances.size(), maxDepth, options.prefixDepth);
+
+    // A shard of a distributed search only covers its own units
+    if (options.shardCount > 1)
+    {
+      units = selectShardUnits(units, options.shardIndex, options.shardCount);
+      totalCombinations = 0;
+      for (const DFSWorkUnit &unit : units)
+      {
+        totalCombinations += 1 + mixCounts[unit.maxDepth - unit.length];
+      }
+
+      std::lock_guard<std::mutex> lock(g_consoleMutex);
+      std::cout << "DFS shard " << options.shardIndex << " of " << options.shardCount << ": " << units.size()
+                << " work units" << std::endl;
+    }
+
+    int threadCount = options.threads > 0 ? options.threads : static_cast<int>(std::thread::hardware_concurrency());
+    threadCount = std::max(1, std::min(threadCount, static_cast<int>(units.size())));
+    WorkStealingPool pool(units.size(), threadCount);
+    std::atomic<uint8_t> *completedUnitsPtr = nullptr;
+
+#ifndef __EMSCRIPTEN__
+    // Flags of the finished work units, periodically saved with the best mix so a restarted
+    // search can skip them. The top list isn't saved, so searches keeping one aren't checkpointed
+    bool checkpointing = !options.checkpointFile.empty();
+    if (checkpointing && topMixes)
+    {
+      std::lock_guard<std::mutex> lock(g_consoleMutex);
+      std::cout << "Checkpoints don't keep a top mix list, searching without them" << std::endl;
+      checkpointing = false;
+    }
+
+    std::unique_ptr<std::atomic<uint8_t>[]> completedUnits;
+    uint64_t checkpointKey = 0;
+    int64_t resumedCombinations = 0;
+    int64_t resumedUnits = 0;
+    int64_t resumedUnitNodes = 0;
+    if (checkpointing)
+    {
+      completedUnits.reset(new std::atomic<uint8_t>[units.size()]);
+      for (size_t i = 0; i < units.size(); ++i)
+      {
+        completedUnits[i].store(0, std::memory_order_relaxed);
+      }
+      checkpointKey = computeCheckpointKey(product, substances, effectMultipliers, maxDepth, options.prefixDepth,
+                                           options.constraints, options.shardIndex, options.shardCount);
+
+      // A damaged file can still carry the right key, so its best mix must only name
+      // substances of this search
+      DFSCheckpoint checkpoint;
+      bool matches = options.resume && loadCheckpoint(options.checkpointFile, checkpoint) &&
+                     checkpoint.searchKey == checkpointKey && checkpoint.completedUnits.size() == units.size();
+      bool damaged = matches && std::any_of(checkpoint.bestMix.substanceIndices.begin(),
+                                            checkpoint.bestMix.substanceIndices.end(),
+                                            [&](size_t index)
+                                            { return index >= substances.size(); });
+      if (matches && !damaged)
+      {
+        for (size_t i = 0; i < units.size(); ++i)
+        {
+          completedUnits[i].store(checkpoint.completedUnits[i], std::memory_order_relaxed);
+          if (checkpoint.completedUnits[i])
+          {
+            resumedUnits++;
+            resumedUnitNodes += 1 + mixCounts[units[i].maxDepth - units[i].length];
+          }
+        }
+        if (checkpoint.hasBest && checkpoint.bestProfitCents > bestProfitCents)
+        {
+          bestMix = DFSState();
+          for (size_t index : checkpoint.bestMix.substanceIndices)
+          {
+            bestMix.addSubstance(static_cast<int>(index), substances);
+          }
+          bestProfitCents = checkpoint.bestProfitCents;
+          bestSellPriceCents = checkpoint.bestSellPriceCents;
+          bestCostCents = checkpoint.bestCostCents;
+        }
+        resumedCombinations = checkpoint.processedCombinations;
+
+        std::lock_guard<std::mutex> lock(g_consoleMutex);
+        std::cout << "Resuming DFS from checkpoint: " << checkpoint.completedCount() << " of " << units.size()
+                  << " work units done, best profit " << bestProfitCents / 100.0 << std::endl;
+      }
+      else if (damaged)
+      {
+        std::lock_guard<std::mutex> lock(g_consoleMutex);
+        std::cerr << "Warning: checkpoint " << options.checkpointFile
+                  << " names substances this search doesn't have, starting from scratch" << std::endl;
+      }
+      else if (options.resume)
+      {
+        std::lock_guard<std::mutex> lock(g_consoleMutex);
+        std::cout << "No checkpoint of this search in " << options.checkpointFile
+                  << ", starting from scratch" << std::endl;
+      }
+    }
+    completedUnitsPtr = completedUnits.get();
+#endif
+
+    // Workers only count into their own counters and never report. Natively a reporter
+    // thread samples the counters; JavaScript callbacks can only run on the thread that
+    // called into the module, so in WebAssembly the calling thread samples them instead
+    metrics.reset(new SearchMetrics(threadCount, maxDepth, totalCombinations, static_cast<int64_t>(units.size())));
+#ifndef __EMSCRIPTEN__
+    metrics->addResumed(resumedUnits, resumedUnitNodes);
+    std::unique_ptr<MetricsReporter> reporter;
+    if (progressCallback || options.metricsCallback)
     {
-      effectsSet[pair.first] = true;
+      reporter.reset(new MetricsReporter(*metrics, options.metricsIntervalMs, reportSample));
     }
+#endif
+    std::atomic<int> runningWorkers(threadCount);
+    std::mutex workersMutex;
+    std::condition_variable workersDone;
+
+    // Workers publish the mixes that beat their own best here, starting from the seed's
+    // profit, and never report them. The calling thread takes over every new best and
+    // reports it while it waits for them
+    SharedBestMix sharedBest(threadCount, bestProfitCents);
+    auto collectBest = [&]()
+    {
+      SharedBestMix::Entry entry;
+      if (!sharedBest.read(entry) || entry.profitCents <= bestProfitCents)
+        return;
+
+      bestMix = DFSState();
+      for (int i = 0; i < entry.length; ++i)
+      {
+        bestMix.addSubstance(entry.substanceIndices[i], substances);
+      }
+      bestProfitCents = entry.profitCents;
+      bestSellPriceCents = entry.sellPriceCents;
+      bestCostCents = entry.costCents;
+
+#ifdef __EMSCRIPTEN__
+      if (progressCallback)
+      {
+        reportBestMixFoundToJS(bestMix.toMixState(), substances, bestProfitCents, bestSellPriceCents, bestCostCents);
+      }
+#else
+      {
+        std::lock_guard<std::mutex> consoleLock(g_consoleMutex);
+        std::cout << "Best mix so far: [";
+        bestMix.printSubstanceNames(std::cout, substances);
+        std::cout << "] with profit " << bestProfitCents / 100.0
+                  << ", price " << bestSellPriceCents / 100.0
+                  << ", cost " << bestCostCents / 100.0 << std::endl;
+      }
+#endif
 
-    // Create and launch threads - one for each starting substance
+      if (options.bestMixCallback)
+      {
+        options.bestMixCallback(bestMix.toMixState(), bestProfitCents, bestSellPriceCents, bestCostCents);
+      }
+    };
+
+    // Create and launch the worker threads
     std::vector<std::thread> threads;
-    int maxThreads = std::min(16, (int)substances.size()); // Use up to 16 threads
-    threads.reserve(maxThreads);
+    threads.reserve(threadCount);
+    std::vector<TopMixList> threadTopMixes(topMixes ? threadCount : 0, TopMixList(options));
 
-    for (size_t i = 0; i < substances.size() && i < maxThreads; ++i)
+    for (int i = 0; i < threadCount; ++i)
     {
+      TopMixList *threadTop = topMixes ? &threadTopMixes[i] : nullptr;
       threads.emplace_back(
-          dfsThreadWorker,
-          std::ref(product),
-          std::ref(substances),
-          std::ref(effectMultipliers),
-          i,
-          maxDepth,
-          totalCombinations,
-          std::ref(bestMix),
-          std::ref(bestProfitCents),
-          std::ref(bestSellPriceCents),
-          std::ref(bestCostCents),
-          progressCallback,
-          useHashingOptimization);
-    }
-
-    // Wait for all threads to complete
+          [&, i, threadTop]()
+          {
+            dfsThreadWorker(product, substances, compiled, pricing, units, pool, i, maxDepth, sharedBest,
+                            metrics->thread(i), transitionsPtr, pricesPtr, boundPtr, threadTop,
+                            dominancePtr, completedUnitsPtr, constraintsPtr);
+            runningWorkers.fetch_sub(1, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(workersMutex);
+            workersDone.notify_all();
+          });
+    }
+
+#ifdef __EMSCRIPTEN__
+    // Report progress, metrics and new best mixes while the workers run
+    while (runningWorkers.load(std::memory_order_acquire) > 0)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(options.metricsIntervalMs));
+      stopRequested(options);
+      reportSample(metrics->snapshot());
+      collectBest();
+    }
+#endif
+
+#ifndef __EMSCRIPTEN__
+    // Save the finished units first and the best mix second: every flagged unit's mixes
+    // reached the best before its flag was set, so the saved best covers them
+    auto writeCheckpoint = [&]()
+    {
+      DFSCheckpoint checkpoint;
+      checkpoint.searchKey = checkpointKey;
+      checkpoint.completedUnits.resize(units.size());
+      for (size_t i = 0; i < units.size(); ++i)
+      {
+        checkpoint.completedUnits[i] = completedUnits[i].load(std::memory_order_acquire);
+      }
+      collectBest();
+      checkpoint.hasBest = bestMix.depth > 0;
+      checkpoint.bestMix = bestMix.toMixState();
+      checkpoint.bestProfitCents = bestProfitCents;
+      checkpoint.bestSellPriceCents = bestSellPriceCents;
+      checkpoint.bestCostCents = bestCostCents;
+      checkpoint.processedCombinations = resumedCombinations + metrics->snapshot().nodes;
+
+      if (!saveCheckpoint(options.checkpointFile, checkpoint))
+      {
+        std::lock_guard<std::mutex> lock(g_consoleMutex);
+        std::cerr << "Warning: could not write checkpoint " << options.checkpointFile << std::endl;
+      }
+      return checkpoint.completedCount();
+    };
+
+    // Trade best profits with the other shards of a distributed search, and bound this one
+    // with theirs. A top list is bounded by its own threshold instead, so it doesn't take them
+    // The key leaves out the shard, so every shard of the search trades the same bound
+    const uint64_t boundKey = options.boundExchange
+                                  ? computeCheckpointKey(product, substances, effectMultipliers, maxDepth,
+                                                         options.prefixDepth, options.constraints)
+                                  : 0;
+    auto exchangeBound = [&]()
+    {
+      if (options.boundExchange && !topMixes)
+      {
+        sharedBest.raise(options.boundExchange(boundKey, sharedBest.profitCents()));
+      }
+    };
+
+    // Report new best mixes while the workers run, stop them at the deadline or on cancel,
+    // when they return the best mix found so far, and checkpoint the search at every interval
+    auto nextCheckpoint = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.checkpointIntervalMs);
+    while (runningWorkers.load(std::memory_order_acquire) > 0)
+    {
+      auto wake = std::chrono::steady_clock::now() + std::chrono::milliseconds(DEADLINE_POLL_MS);
+      if (options.hasDeadline())
+      {
+        wake = std::min(wake, options.deadline);
+      }
+      {
+        std::unique_lock<std::mutex> lock(workersMutex);
+        workersDone.wait_until(lock, wake, [&]()
+                               { return runningWorkers.load(std::memory_order_acquire) == 0; });
+      }
+      stopRequested(options);
+      collectBest();
+      exchangeBound();
+
+      if (checkpointing && !g_shouldTerminate && std::chrono::steady_clock::now() >= nextCheckpoint)
+      {
+        writeCheckpoint();
+        nextCheckpoint = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.checkpointIntervalMs);
+      }
+    }
+#endif
+
+    // Wait for all threads to complete, and take over the mixes they published last
     for (auto &thread : threads)
     {
       if (thread.joinable())
@@ -422,50 +991,92 @@ JsBestMixResult findBestMixDFS(
         thread.join();
       }
     }
+    collectBest();
+#ifndef __EMSCRIPTEN__
+    exchangeBound();
+#endif
+
+#ifndef __EMSCRIPTEN__
+    if (reporter)
+    {
+      reporter->stop();
+    }
+
+    // An interrupted search keeps its checkpoint to be resumed, a finished one doesn't need it
+    if (checkpointing && g_shouldTerminate)
+    {
+      size_t saved = writeCheckpoint();
+      std::lock_guard<std::mutex> lock(g_consoleMutex);
+      std::cout << "Saved a checkpoint of " << saved << " of " << units.size()
+                << " finished work units to " << options.checkpointFile << std::endl;
+    }
+    else if (checkpointing)
+    {
+      removeCheckpoint(options.checkpointFile);
+    }
+#endif
+
+    for (const TopMixList &threadTop : threadTopMixes)
+    {
+      topMixes->merge(threadTop);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(g_consoleMutex);
+      std::cout << "DFS work pool: " << units.size() << " units on " << threadCount
+                << " threads, " << pool.stealCount() << " steals" << std::endl;
+    }
   }
   else
   {
-    // Single-threaded WebAssembly fallback
-    // Create a set of all effect names for efficiency
-    std::unordered_map<std::string, bool> effectsSet;
-    effectsSet.reserve(effectMultipliers.size() * 2);
-    for (const auto &pair : effectMultipliers)
+    // Single-threaded WebAssembly fallback, with each starting substance as a work unit
+    metrics.reset(new SearchMetrics(1, maxDepth, totalCombinations, static_cast<int64_t>(substances.size())));
+    ThreadCounters &counters = metrics->thread(0);
+    auto lastSample = std::chrono::steady_clock::now();
+
+    // Whether the constraints let a mix be scored at all
+    auto acceptsMix = [&](const DFSState &state, EffectMask effects, int depth)
     {
-      effectsSet[pair.first] = true;
-    }
+      return !constraintsPtr || constraintsPtr->accepts(effects, state.currentCost, depth);
+    };
+
+    // Offer a mix to the top list, if one is kept
+    auto offerTopMix = [&](const DFSState &state, EffectMask effects, int depth,
+                           int profitCents, int sellPriceCents, int costCents)
+    {
+      if (topMixes && topMixes->admits(profitCents, costCents, depth))
+      {
+        topMixes->insert(state.toMixState(), effects, profitCents, sellPriceCents, costCents);
+      }
+    };
 
-    int64_t processedCombinations = 0;
+    RuleKernel kernel(compiled);
 
     // Process each substance as a starting point in sequence
-    for (size_t startIdx = 0; startIdx < substances.size(); ++startIdx)
+    for (size_t startIdx = 0; startIdx < substances.size() && !g_shouldTerminate; ++startIdx)
     {
       // Initialize state with the starting substance
       DFSState currentState;
       currentState.addSubstance(startIdx, substances);
-      processedCombinations++;
+      counters.addNode(1);
+      auto startTime = std::chrono::steady_clock::now();
 
-      // Initialize the optimized effects cache with the hashing option
-      EffectsCache effectsCache(maxDepth, product.initialEffect, useHashingOptimization);
+      // Initialize the optimized effects cache on top of the shared transition table
+      EffectsCache effectsCache(maxDepth, compiled.initialEffects, transitionsPtr, pricesPtr, &kernel);
 
       // Calculate effects for the first substance
-      std::vector<std::string> effectsList = applySubstanceRules(
-          effectsCache.depthCache[0], substances[startIdx], 1, effectsSet);
-
-      // Cache the effects at depth 1
-      effectsCache.cacheEffects(1, effectsList);
-
-      // Also cache in the substance-specific map for potential reuse
-      effectsCache.cacheCalculatedEffects(startIdx, effectsCache.depthCache[0], effectsList);
+      effectsCache.advance(static_cast<int>(startIdx), 1, compiled.substances[startIdx]);
 
       // Calculate profit for starting substance
-      int sellPriceCents = calculateFinalPrice(product.name, effectsList, effectMultipliers);
+      int sellPriceCents = effectsCache.getSellPrice(1, pricing);
       int costCents = currentState.currentCost;
       int profitCents = sellPriceCents - costCents;
 
       // Update best mix if better
-      if (profitCents > bestProfitCents)
+      bool accepted = acceptsMix(currentState, effectsCache.depthCache[1], 1);
+      if (accepted && profitCents > bestProfitCents)
       {
-        bestMix = currentState.toMixState();
+        bestMix = currentState;
         bestProfitCents = profitCents;
         bestSellPriceCents = sellPriceCents;
         bestCostCents = costCents;
@@ -474,41 +1085,81 @@ JsBestMixResult findBestMixDFS(
         // Report to JavaScript
         if (progressCallback)
         {
-          reportBestMixFoundToJS(bestMix, substances, bestProfitCents, bestSellPriceCents, bestCostCents);
+          reportBestMixFoundToJS(bestMix.toMixState(), substances, bestProfitCents, bestSellPriceCents, bestCostCents);
         }
 #endif
       }
+      if (accepted)
+      {
+        offerTopMix(currentState, effectsCache.depthCache[1], 1, profitCents, sellPriceCents, costCents);
+      }
 
-      // Stack-based DFS (simulating recursion for WebAssembly)
+      // Stack-based DFS (simulating recursion for WebAssembly). Depths 2 to maxDepth each
+      // take one entry, and maxDepth was checked against MAX_MIX_LENGTH, so a fixed array
+      // holds the whole stack like in the threaded kernels
       struct StackEntry
       {
         size_t substanceIndex;
-        size_t depth;
+        int depth;
       };
 
-      std::vector<StackEntry> stack;
-      stack.reserve(maxDepth);
+      StackEntry stack[MAX_MIX_LENGTH];
+      size_t stackSize = 0;
+
+      // Skip subtrees the constraints rule out, subtrees whose profit bound can't beat the
+      // best mix so far, and subtrees whose effect set was already expanded at this depth
+      // for no more than this mix costs
+      auto shouldDescend = [&](int depth)
+      {
+        int remaining = maxDepth - depth;
+        if (constraintsPtr && !constraintsPtr->canExtend(effectsCache.depthCache[depth], currentState.currentCost, depth))
+        {
+          ThreadCounters::add(counters.prunedSubtrees, 1);
+          ThreadCounters::add(counters.prunedNodes, mixCounts[remaining]);
+          return false;
+        }
+
+        if (boundPtr)
+        {
+          int bestKnown = topMixes ? topMixes->thresholdCents() : bestProfitCents;
+          if (boundPtr->maxExtensionProfit(effectsCache.depthCache[depth], currentState.currentCost, remaining) <= bestKnown)
+          {
+            ThreadCounters::add(counters.prunedSubtrees, 1);
+            ThreadCounters::add(counters.prunedNodes, mixCounts[remaining]);
+            return false;
+          }
+        }
+
+        int32_t state = effectsCache.depthStates[depth];
+        if (dominancePtr && state >= 0 && !dominancePtr->claim(state, depth, currentState.currentCost))
+        {
+          ThreadCounters::add(counters.dominatedSubtrees, 1);
+          ThreadCounters::add(counters.dominatedNodes, mixCounts[remaining]);
+          return false;
+        }
+        return true;
+      };
 
       // Add first entry for depth 2 if we should go deeper
-      if (maxDepth > 1)
+      if (maxDepth > 1 && shouldDescend(1))
       {
-        stack.push_back({0, 2});
+        effectsCache.expandChildren(2);
+        stack[stackSize++] = {0, 2};
       }
 
-      // Progress reporting variables
+      // Mixes since the deadline, the cancellation token and the sample time were last checked
       int batchSize = 0;
-      const int reportInterval = 1000;
 
       // Process the DFS stack
-      while (!stack.empty())
+      while (stackSize > 0 && !g_shouldTerminate)
       {
         // Get current stack entry
-        StackEntry &current = stack.back();
+        StackEntry &current = stack[stackSize - 1];
 
         // If we've exhausted substances at this depth, backtrack
         if (current.substanceIndex >= substances.size())
         {
-          stack.pop_back();
+          --stackSize;
           // Backtrack if we have more than just the initial substance
           if (currentState.depth > 1)
           {
@@ -520,60 +1171,38 @@ JsBestMixResult findBestMixDFS(
         // Add the current substance
         currentState.addSubstance(current.substanceIndex, substances);
 
-        // Calculate effects efficiently, checking for cached results first
+        // Calculate effects from the parent effects cached at the previous depth
         const int substanceIndex = current.substanceIndex;
-        const size_t currentDepth = current.depth;
-        const auto &parentEffects = effectsCache.depthCache[currentDepth - 1];
-
-        // Use direct cache lookup using the substance+parent combo
-        if (effectsCache.hasCalculatedEffects(substanceIndex, parentEffects))
-        {
-          // Get pre-calculated effects - no need to reapply rules
-          effectsList = effectsCache.getCachedEffects(substanceIndex, parentEffects);
-        }
-        else
-        {
-          // Calculate effects from parent effects
-          effectsList = applySubstanceRules(
-              parentEffects,
-              substances[substanceIndex],
-              currentDepth,
-              effectsSet);
-
-          // Cache for potential reuse with same substance+parent combo
-          effectsCache.cacheCalculatedEffects(substanceIndex, parentEffects, effectsList);
-        }
-
-        // Always update the depth cache
-        effectsCache.cacheEffects(currentDepth, effectsList);
+        const int currentDepth = current.depth;
+        effectsCache.advance(substanceIndex, currentDepth, compiled.substances[substanceIndex]);
 
         // Count this combination
-        processedCombinations++;
+        counters.addNode(currentDepth);
         batchSize++;
 
-        // Adaptive progress reporting frequency
-        int reportFrequency = reportInterval;
-        if (current.depth > 5)
+        // Sample the counters periodically, at most once per metrics interval
+        if (batchSize >= CLOCK_CHECK_INTERVAL)
         {
-          reportFrequency = reportInterval * (current.depth - 4);
-        }
-
-        // Report progress periodically
-        if (progressCallback && batchSize >= reportFrequency)
-        {
-          progressCallback(current.depth, processedCombinations, totalCombinations);
           batchSize = 0;
+          stopRequested(options);
+          auto now = std::chrono::steady_clock::now();
+          if (now - lastSample >= std::chrono::milliseconds(options.metricsIntervalMs))
+          {
+            lastSample = now;
+            reportSample(metrics->snapshot());
+          }
         }
 
-        // Calculate profit for the current mix
-        sellPriceCents = calculateFinalPrice(product.name, effectsList, effectMultipliers);
+        // Calculate profit for the current mix, if the constraints accept it
+        accepted = acceptsMix(currentState, effectsCache.depthCache[currentDepth], currentDepth);
+        sellPriceCents = accepted ? effectsCache.getSellPrice(currentDepth, pricing) : 0;
         costCents = currentState.currentCost;
         profitCents = sellPriceCents - costCents;
 
         // Update best mix if better
-        if (profitCents > bestProfitCents)
+        if (accepted && profitCents > bestProfitCents)
         {
-          bestMix = currentState.toMixState();
+          bestMix = currentState;
           bestProfitCents = profitCents;
           bestSellPriceCents = sellPriceCents;
           bestCostCents = costCents;
@@ -582,16 +1211,22 @@ JsBestMixResult findBestMixDFS(
           // Report to JavaScript
           if (progressCallback)
           {
-            reportBestMixFoundToJS(bestMix, substances, bestProfitCents, bestSellPriceCents, bestCostCents);
+            reportBestMixFoundToJS(bestMix.toMixState(), substances, bestProfitCents, bestSellPriceCents, bestCostCents);
           }
 #endif
         }
+        if (accepted)
+        {
+          offerTopMix(currentState, effectsCache.depthCache[currentDepth], currentDepth,
+                      profitCents, sellPriceCents, costCents);
+        }
 
         // If we haven't reached max depth, go deeper with the first substance
-        if (current.depth < maxDepth)
+        if (current.depth < maxDepth && shouldDescend(currentDepth))
         {
-          current.substanceIndex++;                // Move to next substance at current level
-          stack.push_back({0, current.depth + 1}); // Push next level starting at substance 0
+          effectsCache.expandChildren(currentDepth + 1);
+          current.substanceIndex++;                    // Move to next substance at current level
+          stack[stackSize++] = {0, current.depth + 1}; // Push next level starting at substance 0
         }
         else
         {
@@ -601,20 +1236,63 @@ JsBestMixResult findBestMixDFS(
         }
       }
 
-      // Report progress after finishing this starting substance
-      if (progressCallback && batchSize > 0)
+      ThreadCounters::add(counters.cacheHits, effectsCache.tableHits);
+      ThreadCounters::add(counters.cacheMisses, effectsCache.tableMisses);
+      ThreadCounters::add(counters.busyMicros, std::chrono::duration_cast<std::chrono::microseconds>(
+                                                   std::chrono::steady_clock::now() - startTime)
+                                                   .count());
+      if (stackSize == 0)
       {
-        progressCallback(maxDepth, processedCombinations, totalCombinations);
+        ThreadCounters::add(counters.completedUnits, 1);
       }
+
+      // Report after finishing this starting substance
+      reportSample(metrics->snapshot());
     }
   }
 
+  // Search statistics come from the final sample of the counters
+  if (metrics)
+  {
+    MetricsSnapshot snapshot = metrics->snapshot();
+    g_totalProcessedCombinations = snapshot.nodes;
+    g_prunedSubtrees = snapshot.prunedSubtrees;
+    g_prunedCombinations = snapshot.prunedNodes;
+    g_dominatedSubtrees = snapshot.dominatedSubtrees;
+#ifdef __EMSCRIPTEN__
+    publishSearchMetrics(snapshot);
+#endif
+  }
+
   // Final progress report
   if (progressCallback)
   {
     progressCallback(maxDepth, totalCombinations, totalCombinations);
   }
 
+  if (bound)
+  {
+    int64_t pruned = g_prunedCombinations.load();
+    std::lock_guard<std::mutex> lock(g_consoleMutex);
+    std::cout << "Branch-and-bound pruned " << g_prunedSubtrees.load() << " subtrees, skipping "
+              << pruned << " of " << totalCombinations << " combinations ("
+              << (totalCombinations > 0 ? 100.0 * pruned / totalCombinations : 0.0) << "%)" << std::endl;
+  }
+
+  if (dominance)
+  {
+    std::lock_guard<std::mutex> lock(g_consoleMutex);
+    std::cout << "Dominance table skipped " << g_dominatedSubtrees.load()
+              << " subtrees that repeat an already expanded state" << std::endl;
+  }
+
+  if (transitionsPtr)
+  {
+    std::lock_guard<std::mutex> lock(g_consoleMutex);
+    std::cout << "Transition table: " << transitionsPtr->stateCount() << "/" << transitionsPtr->capacity()
+              << " states" << std::endl;
+  }
+
   // Create the result
   JsBestMixResult result;
 
@@ -642,5 +1320,7 @@ JsBestMixResult findBestMixDFS(
   result.sellPrice = bestSellPriceCents / 100.0;
   result.cost = bestCostCents / 100.0;
 
+  setTopMixes(result, topMixes.get(), bestMix.toMixState(), substances);
+
   return result;
 }
@@ -1,9 +1,20 @@
 #pragma once
 
 #include "types.h"
+#include "effects.h"
+#include "pricing.h"
+#include "state_table.h"
+#include "rule_kernel.h"
+#include "work_pool.h"
+#include "profit_bound.h"
+#include "top_k.h"
+#include "constraints.h"
+#include "metrics.h"
+#include "shared_best.h"
 #include <vector>
 #include <string>
 #include <string_view>
+#include <ostream>
 #include <unordered_map>
 #include <atomic>
 #include <mutex>
@@ -15,7 +26,7 @@ struct EffectsCache;
 struct DFSState
 {
   // Use a larger fixed-size array to handle deeper searches without reallocation
-  int substanceIndices[16]; // Support up to 16 substances in a mix for better future-proofing
+  int substanceIndices[MAX_MIX_LENGTH]; // Support up to MAX_MIX_LENGTH substances in a mix
   int depth;                // Current depth in the search
   int currentCost;          // Track the current mix cost in cents (integer)
 
@@ -36,121 +47,200 @@ struct DFSState
   // Copy the current state to a MixState for compatibility with existing code
   MixState toMixState() const;
 
+  // Write the substance names as a comma-separated list without building temporaries
+  void printSubstanceNames(std::ostream &out, const std::vector<Substance> &substances) const;
+
   // Get a unique hash for the current state (for potential memoization)
   uint64_t getHash() const { return stateHash; }
 };
 
 // Effects cache optimized for DFS traversal
-// Stores effects at each depth to avoid recalculating them
+// Stores the effects at each depth of the current path to avoid recalculating them
 struct EffectsCache
 {
-  // Primary cache: full effects list for each depth
-  std::vector<std::vector<std::string>> depthCache;
-
-  // Secondary cache: substance+parent effects hash -> resulting effects
-  // This allows reusing effects calculations even when they don't fall on the same depth
-  std::unordered_map<uint64_t, std::vector<std::string>> effectsMap;
-
-  // String pool for shared strings to minimize allocations
-  std::unordered_map<std::string, std::string> stringPool;
-
-  // Flag to control whether to use advanced caching via hashing
-  bool useHashingOptimization;
-
-  EffectsCache(int maxDepth, const std::string &initialEffect, bool enableHashing = true)
-      : useHashingOptimization(enableHashing)
+  // Effect mask at each depth
+  std::vector<EffectMask> depthCache;
+
+  // State ID in the shared transition table at each depth (-1 if not in the table)
+  std::vector<int32_t> depthStates;
+
+  // Shared transition table and sell price memo, null when hashing is disabled
+  TransitionTable *transitions;
+  StatePriceCache *prices;
+
+  // Children of the mix cached at depth - 1 for every substance, one row per depth. Filled
+  // by expandChildren when the transition table can't serve that mix
+  const RuleKernel *kernel;
+  size_t substanceCount;
+  std::vector<EffectMask> childEffects;
+  std::vector<uint8_t> childrenReady;
+
+  // Steps answered by a known transition, and steps that had to apply rules (filling a
+  // transition table row, or without a table state)
+  int64_t tableHits;
+  int64_t tableMisses;
+
+  EffectsCache(int maxDepth, EffectMask initialEffects, TransitionTable *transitions, StatePriceCache *prices,
+               const RuleKernel *kernel = nullptr)
+      : depthCache(maxDepth + 1, 0),
+        depthStates(maxDepth + 1, -1),
+        transitions(transitions),
+        prices(prices),
+        kernel(kernel),
+        substanceCount(kernel ? kernel->substanceCount() : 0),
+        childEffects((maxDepth + 1) * substanceCount, 0),
+        childrenReady(maxDepth + 1, 0),
+        tableHits(0),
+        tableMisses(0)
   {
-    depthCache.resize(maxDepth + 1);
-    depthCache[0].push_back(initialEffect);
-    stringPool[initialEffect] = initialEffect; // Add initial effect to pool
-  }
-
-  // Get shared string reference
-  const std::string &getPooledString(const std::string &str)
-  {
-    auto it = stringPool.find(str);
-    if (it != stringPool.end())
+    depthCache[0] = initialEffects;
+    if (transitions)
     {
-      return it->second;
+      depthStates[0] = transitions->getStateId(initialEffects);
     }
-    auto result = stringPool.emplace(str, str);
-    return result.first->second;
   }
 
-  // Add effects to cache
-  void cacheEffects(int depth, const std::vector<std::string> &effects)
+  // Expand every child of the mix cached at depth - 1 at once, unless the transition
+  // table already serves them
+  void expandChildren(int depth)
   {
-    depthCache[depth] = effects;
-  }
-
-  // Get a unique hash for substance + parent effects
-  static uint64_t getEffectsHash(int substanceIndex, const std::vector<std::string> &parentEffects)
-  {
-    uint64_t hash = static_cast<uint64_t>(substanceIndex) << 32;
-    for (const auto &effect : parentEffects)
+    if (kernel && depthStates[depth - 1] < 0)
     {
-      // Simple hash combination
-      hash = hash ^ std::hash<std::string>{}(effect);
+      kernel->expand(depthCache[depth - 1], depth, &childEffects[depth * substanceCount]);
+      childrenReady[depth] = 1;
     }
-    return hash;
   }
 
-  // Check if we already calculated these effects
-  bool hasCalculatedEffects(int substanceIndex, const std::vector<std::string> &parentEffects)
+  // Calculate and cache the effects of adding a substance at the given depth. Once the
+  // shared table is warm this is a single lookup instead of a rule application
+  EffectMask advance(int substanceIndex, int depth, const CompiledSubstance &substance)
   {
-    if (!useHashingOptimization)
-      return false; // Skip hash-based caching if disabled
-
-    uint64_t hash = getEffectsHash(substanceIndex, parentEffects);
-    return effectsMap.find(hash) != effectsMap.end();
-  }
+    int32_t parentState = depthStates[depth - 1];
+    int64_t missesBefore = tableMisses;
+    int32_t state = parentState >= 0 ? transitions->getSuccessor(parentState, substanceIndex, depth, &tableMisses) : -1;
 
-  // Cache calculated effects with substance+parent hash
-  void cacheCalculatedEffects(int substanceIndex, const std::vector<std::string> &parentEffects,
-                              const std::vector<std::string> &resultEffects)
-  {
-    if (!useHashingOptimization)
-      return; // Skip hash-based caching if disabled
+    EffectMask effects;
+    if (state >= 0)
+    {
+      effects = transitions->getMask(state);
+      if (tableMisses == missesBefore)
+        tableHits++;
+    }
+    else
+    {
+      if (childrenReady[depth])
+        effects = childEffects[depth * substanceCount + substanceIndex];
+      else if (kernel)
+        effects = kernel->apply(depthCache[depth - 1], substanceIndex, depth);
+      else
+        effects = applySubstanceRulesMask(depthCache[depth - 1], substance, depth);
+      if (tableMisses == missesBefore)
+        tableMisses++;
+    }
+    depthCache[depth] = effects;
+    depthStates[depth] = state;
 
-    uint64_t hash = getEffectsHash(substanceIndex, parentEffects);
-    effectsMap[hash] = resultEffects;
+    // The children expanded below the previous mix at this depth are stale now
+    if (static_cast<size_t>(depth) + 1 < childrenReady.size())
+    {
+      childrenReady[depth + 1] = 0;
+    }
+    return effects;
   }
 
-  // Get cached effects
-  const std::vector<std::string> &getCachedEffects(int substanceIndex, const std::vector<std::string> &parentEffects)
+  // Get the sell price of the effects cached at a depth, using the shared memo when possible
+  int getSellPrice(int depth, const PricingContext &pricing)
   {
-    uint64_t hash = getEffectsHash(substanceIndex, parentEffects);
-    return effectsMap[hash];
+    int32_t state = depthStates[depth];
+    if (state >= 0)
+    {
+      return prices->getPrice(state, depthCache[depth], pricing);
+    }
+    return pricing.sellPrice(depthCache[depth]);
   }
 };
 
 // Global variables for thread synchronization in DFS algorithm
-extern std::mutex g_bestMixMutex;
 extern std::atomic<int64_t> g_totalProcessedCombinations;
 extern std::atomic<bool> g_shouldTerminate;
+
+// Raise g_shouldTerminate once the search's deadline has passed or its cancellation token
+// was cancelled. Every engine polls it; workers only read the flag. Returns true if the
+// search should stop
+bool stopRequested(const SearchOptions &options);
+
+// Best top-list threshold of any worker; replaces the best profit as the pruning bound in top-K searches
+extern std::atomic<int> g_sharedTopThresholdCents;
+
+// Branch-and-bound statistics for the current search
+extern std::atomic<int64_t> g_prunedSubtrees;
+extern std::atomic<int64_t> g_prunedCombinations;
+
+// Subtrees skipped because their (depth, effect set) state was already expanded at no higher cost
+extern std::atomic<int64_t> g_dominatedSubtrees;
 extern const int MAX_SUBSTANCES;
 extern const int MAX_DEPTH;
 
-// Worker function for DFS threading
+// Longest supported DFS work unit prefix
+const int MAX_DFS_PREFIX_DEPTH = 4;
+
+// One unit of DFS work: the mix formed by a substance prefix and, when maxDepth is
+// greater than the prefix length, every mix extending it up to maxDepth
+struct DFSWorkUnit
+{
+  int prefix[MAX_DFS_PREFIX_DEPTH];
+  int length;
+  int maxDepth;
+};
+
+// Split the DFS search tree into work units covering every mix exactly once: single-node
+// units for mixes shorter than prefixDepth, then one subtree unit per full-length prefix
+std::vector<DFSWorkUnit> buildDFSWorkUnits(size_t substanceCount, int maxDepth, int prefixDepth);
+
+// Keep the units of one shard of a distributed search: every shardCount-th unit, starting
+// at shardIndex. Neighbouring prefixes go to different shards, so shards get similar work
+std::vector<DFSWorkUnit> selectShardUnits(const std::vector<DFSWorkUnit> &units, int shardIndex, int shardCount);
+
+// Worker function for DFS threading - takes work units from the pool until none are left.
+// Depths 1 to 10 run a kernel compiled for that depth, deeper searches a generic one.
+// Mixes that beat the worker's best so far are published to `best` in slot workerIndex,
+// without reporting them. When a bound is given, subtrees that can't beat it are skipped.
+// When a top list is given, mixes are also offered to it and g_sharedTopThresholdCents is the bound.
+// When completion flags are given, units already flagged are skipped and each unit searched to the
+// end is flagged, after its mixes have reached the global best.
+// When constraints are given, only mixes they accept are scored and subtrees they rule out are skipped
 void dfsThreadWorker(
     const Product &product,
     const std::vector<Substance> &substances,
-    const std::unordered_map<std::string, int> &effectMultipliers,
-    int startSubstanceIndex,
+    const CompiledEffects &compiled,
+    const PricingContext &pricing,
+    const std::vector<DFSWorkUnit> &units,
+    WorkStealingPool &pool,
+    int workerIndex,
     int maxDepth,
-    int64_t expectedCombinations,
-    MixState &globalBestMix,
-    int &globalBestProfitCents,
-    int &globalBestSellPriceCents,
-    int &globalBestCostCents,
-    ProgressCallback progressCallback,
-    bool useHashingOptimization = true);
-
-// Main DFS algorithm with threading
+    SharedBestMix &best,
+    ThreadCounters &counters,
+    TransitionTable *transitions = nullptr,
+    StatePriceCache *prices = nullptr,
+    const ProfitBound *bound = nullptr,
+    TopMixList *topMixes = nullptr,
+    DominanceTable *dominance = nullptr,
+    std::atomic<uint8_t> *completedUnits = nullptr,
+    const ConstraintFilter *constraints = nullptr);
+
+// Main DFS algorithm with threading. With options.anytime it solves each depth up to
+// maxDepth in turn and reports every one through options.depthResultCallback. A passed
+// options.deadline or a cancelled options.cancellation stops the search with the best mix
+// so far and leaves g_shouldTerminate raised, so callers can tell the result is incomplete.
+// Only mixes within options.constraints are returned. With options.shardCount > 1 only the
+// shard's own work units are searched. With options.boundExchange the best profit is traded
+// with the other shards while the search runs, so the result only holds a mix when this
+// shard found one that beat every shard's best at the time
 JsBestMixResult findBestMixDFS(
     const Product &product,
     const std::vector<Substance> &substances,
     const std::unordered_map<std::string, int> &effectMultipliers,
     int maxDepth,
     ProgressCallback progressCallback = nullptr,
-    bool useHashingOptimization = true);
+    bool useHashingOptimization = true,
+    const SearchOptions &options = SearchOptions());
@@ -0,0 +1,181 @@
+#include <string>
+#include <vector>
+#include <cmath>
+#include <memory>
+#include <algorithm>
+
+#include "types.h"
+#include "effects.h"
+#include "pricing.h"
+#include "dp_algorithm.h"
+#include "incremental.h"
+#include "reporter.h"
+#include "json_parser.h"
+
+// Include Emscripten headers only when building for WebAssembly
+#ifdef __EMSCRIPTEN__
+#include <emscripten/emscripten.h>
+#include <emscripten/bind.h>
+#include <emscripten/val.h>
+using namespace emscripten;
+#endif
+
+// Parse JSON input and run the DP solver
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+JsBestMixResult findBestMixDPJson(
+    std::string productJson,
+    std::string substancesJson,
+    std::string effectMultipliersJson,
+    std::string substanceRulesJson,
+    int maxDepth)
+{
+  // Parse JSON inputs
+  Product product = parseProductJson(productJson);
+  std::vector<Substance> substances = parseSubstancesJson(substancesJson);
+  std::unordered_map<std::string, int> effectMultipliers = parseEffectMultipliersJson(effectMultipliersJson);
+  applySubstanceRulesJson(substances, substanceRulesJson);
+
+  // Run the DP algorithm without progress reporting
+  return findBestMixDP(product, substances, effectMultipliers, maxDepth, nullptr);
+}
+
+// Parse JSON input and run the DP solver with progress reporting and search options
+JsBestMixResult findBestMixDPJsonWithOptions(
+    const std::string &productJson,
+    const std::string &substancesJson,
+    const std::string &effectMultipliersJson,
+    const std::string &substanceRulesJson,
+    int maxDepth,
+    bool reportProgress,
+    const SearchOptions &options)
+{
+  Product product = parseProductJson(productJson);
+  std::vector<Substance> substances = parseSubstancesJson(substancesJson);
+  std::unordered_map<std::string, int> effectMultipliers = parseEffectMultipliersJson(effectMultipliersJson);
+  applySubstanceRulesJson(substances, substanceRulesJson);
+
+  // Function pointer for progress reporting in console mode
+  extern void reportProgressToConsole(int depth, int64_t processed, int64_t total);
+
+  // Run the DP algorithm with progress reporting if enabled
+#ifdef __EMSCRIPTEN__
+  if (reportProgress)
+  {
+    // Use the WebAssembly-specific progress reporting function, from which JavaScript
+    // can stop the search through cancelSearch()
+    SearchOptions cancellableOptions = options;
+    cancellableOptions.cancellation = startCancellableSearch();
+    return findBestMixDP(product, substances, effectMultipliers, maxDepth, reportProgressToJS, cancellableOptions);
+  }
+  else
+#else
+  if (reportProgress)
+  {
+    return findBestMixDP(product, substances, effectMultipliers, maxDepth, reportProgressToConsole, options);
+  }
+  else
+#endif
+  {
+    return findBestMixDP(product, substances, effectMultipliers, maxDepth, nullptr, options);
+  }
+}
+
+// Parse JSON input and run the DP solver with progress reporting
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+JsBestMixResult findBestMixDPJsonWithProgress(
+    std::string productJson,
+    std::string substancesJson,
+    std::string effectMultipliersJson,
+    std::string substanceRulesJson,
+    int maxDepth,
+    bool reportProgress)
+{
+  return findBestMixDPJsonWithOptions(
+      productJson, substancesJson, effectMultipliersJson, substanceRulesJson,
+      maxDepth, reportProgress, SearchOptions());
+}
+
+// Parse JSON input and run the DP solver, also returning the topK best mixes with distinct effect sets
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+JsBestMixResult findBestMixDPJsonTopK(
+    std::string productJson,
+    std::string substancesJson,
+    std::string effectMultipliersJson,
+    std::string substanceRulesJson,
+    int maxDepth,
+    bool reportProgress,
+    int topK)
+{
+  SearchOptions options;
+  options.topK = static_cast<size_t>(std::max(1, topK));
+  return findBestMixDPJsonWithOptions(
+      productJson, substancesJson, effectMultipliersJson, substanceRulesJson,
+      maxDepth, reportProgress, options);
+}
+
+// Parse JSON input and run the DP solver under the constraints in constraintsJson (see
+// parseSearchConstraintsJson), also returning the topK best mixes with distinct effect sets
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+JsBestMixResult findBestMixDPJsonConstrained(
+    std::string productJson,
+    std::string substancesJson,
+    std::string effectMultipliersJson,
+    std::string substanceRulesJson,
+    int maxDepth,
+    bool reportProgress,
+    int topK,
+    std::string constraintsJson)
+{
+  SearchOptions options;
+  options.topK = static_cast<size_t>(std::max(1, topK));
+  options.constraints = parseSearchConstraintsJson(constraintsJson);
+  return findBestMixDPJsonWithOptions(
+      productJson, substancesJson, effectMultipliersJson, substanceRulesJson,
+      maxDepth, reportProgress, options);
+}
+
+// Parse JSON input and solve with the incremental solver. Calls with the same product
+// effect and rules reuse the state graph of the previous call and only re-score it, so
+// changed costs or multipliers are answered in milliseconds
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_KEEPALIVE
+#endif
+JsBestMixResult findBestMixIncrementalJson(
+    std::string productJson,
+    std::string substancesJson,
+    std::string effectMultipliersJson,
+    std::string substanceRulesJson,
+    int maxDepth,
+    int topK)
+{
+  Product product = parseProductJson(productJson);
+  std::vector<Substance> substances = parseSubstancesJson(substancesJson);
+  std::unordered_map<std::string, int> effectMultipliers = parseEffectMultipliersJson(effectMultipliersJson);
+  applySubstanceRulesJson(substances, substanceRulesJson);
+
+  SearchOptions options;
+  options.topK = static_cast<size_t>(std::max(1, topK));
+  return findBestMixIncremental(product, substances, effectMultipliers, maxDepth, options);
+}
+
+// Emscripten bindings - only include in WebAssembly build
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_BINDINGS(dp_module)
+{
+  // Reuse the JsBestMixResult binding from BFS module
+  function("findBestMixDPJson", &findBestMixDPJson);
+  function("findBestMixDPJsonWithProgress", &findBestMixDPJsonWithProgress);
+  function("findBestMixDPJsonTopK", &findBestMixDPJsonTopK);
+  function("findBestMixDPJsonConstrained", &findBestMixDPJsonConstrained);
+  function("findBestMixIncrementalJson", &findBestMixIncrementalJson);
+  function("clearIncrementalStateGraph", &clearIncrementalStateGraph);
+}
+#endif
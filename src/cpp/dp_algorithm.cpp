@@ -0,0 +1,301 @@
+#include "dp_algorithm.h"
+#include "pricing.h"
+#include "reporter.h"
+#include "top_k.h"
+#include "constraints.h"
+#include "rule_kernel.h"
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <atomic>
+#include <memory>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/val.h>
+using namespace emscripten;
+#endif
+
+// External cancellation flag and its deadline and token check (defined in dfs_algorithm.cpp)
+extern std::atomic<bool> g_shouldTerminate;
+bool stopRequested(const SearchOptions &options);
+
+// Parents expanded between two looks at the clock and the cancellation token
+static const size_t STOP_CHECK_PARENTS = 1024;
+
+DPScorer::DPScorer(const SearchOptions &options, const ConstraintFilter *constraints, int maxDepth)
+    : options(options),
+      constraints(constraints),
+      bestMix(maxDepth),
+      bestProfitCents(0),
+      bestSellPriceCents(0),
+      bestCostCents(0),
+      layerBestParent(-1),
+      layerBestSubstance(-1)
+{
+  // Every state's cheapest path is scored at each depth, so the top list is exact as well
+  if (options.wantsTopList())
+  {
+    topMixes.reset(new TopMixList(options));
+  }
+
+  // Start from the seed mix, if any
+  if (options.seed.valid && options.seed.mix.substanceIndices.size() <= static_cast<size_t>(maxDepth))
+  {
+    bestMix = options.seed.mix;
+    bestProfitCents = options.seed.profitCents;
+    bestSellPriceCents = options.seed.sellPriceCents;
+    bestCostCents = options.seed.costCents;
+  }
+}
+
+void DPScorer::offerTopMix(const std::vector<DPLayer> &layers, int depth, int32_t parentIndex, int substanceIndex,
+                           EffectMask effects, int profitCents, int sellPriceCents, int costCents)
+{
+  if (topMixes->admits(profitCents, costCents, depth))
+  {
+    topMixes->insert(reconstructMix(layers, depth, parentIndex, substanceIndex),
+                     effects, profitCents, sellPriceCents, costCents);
+  }
+}
+
+void DPScorer::finishLayer(const std::vector<DPLayer> &layers, int depth, const std::vector<Substance> &substances,
+                           ProgressCallback progressCallback)
+{
+  if (layerBestParent < 0)
+    return;
+
+  bestMix = reconstructMix(layers, depth, layerBestParent, layerBestSubstance);
+  layerBestParent = -1;
+  layerBestSubstance = -1;
+
+#ifdef __EMSCRIPTEN__
+  if (progressCallback)
+  {
+    reportBestMixFoundToJS(bestMix, substances, bestProfitCents, bestSellPriceCents, bestCostCents);
+  }
+#else
+  (void)progressCallback;
+  std::cout << "Best mix so far: [";
+  for (size_t i = 0; i < bestMix.substanceIndices.size(); ++i)
+  {
+    if (i > 0)
+      std::cout << ", ";
+    std::cout << substances[bestMix.substanceIndices[i]].name;
+  }
+  std::cout << "] with profit " << bestProfitCents / 100.0
+            << ", price " << bestSellPriceCents / 100.0
+            << ", cost " << bestCostCents / 100.0
+            << " at depth " << depth << std::endl;
+
+  if (options.bestMixCallback)
+  {
+    options.bestMixCallback(bestMix, bestProfitCents, bestSellPriceCents, bestCostCents);
+  }
+#endif
+}
+
+JsBestMixResult DPScorer::result(const std::vector<Substance> &substances) const
+{
+  JsBestMixResult result;
+
+  // Convert best mix to an array using substance names
+  std::vector<std::string> bestMixNames = bestMix.toSubstanceNames(substances);
+
+#ifdef __EMSCRIPTEN__
+  // WebAssembly version: convert to JavaScript array
+  val jsArray = val::array();
+  for (size_t i = 0; i < bestMixNames.size(); ++i)
+  {
+    jsArray.set(i, val(bestMixNames[i]));
+  }
+  result.mixArray = jsArray;
+#else
+  // Native version: use std::vector directly
+  result.mixArray = bestMixNames;
+#endif
+
+  // Store monetary values in both cents and dollars in the result
+  result.profitCents = bestProfitCents;
+  result.sellPriceCents = bestSellPriceCents;
+  result.costCents = bestCostCents;
+
+  // Convert cents to dollars for backward compatibility
+  result.profit = bestProfitCents / 100.0;
+  result.sellPrice = bestSellPriceCents / 100.0;
+  result.cost = bestCostCents / 100.0;
+
+  setTopMixes(result, topMixes.get(), bestMix, substances);
+
+  return result;
+}
+
+MixState DPScorer::reconstructMix(const std::vector<DPLayer> &layers, int depth, int32_t parentIndex,
+                                  int substanceIndex)
+{
+  InlineVector<size_t, MAX_MIX_LENGTH> reversed;
+  reversed.push_back(substanceIndex);
+
+  for (int layer = depth - 1; layer >= 1; --layer)
+  {
+    const DPStateEntry &entry = layers[layer].entries[parentIndex];
+    reversed.push_back(entry.substanceIndex);
+    parentIndex = entry.parentIndex;
+  }
+
+  MixState mix(depth);
+  for (size_t i = reversed.size(); i > 0; --i)
+  {
+    mix.addSubstance(reversed[i - 1]);
+  }
+  return mix;
+}
+
+// Dynamic-programming search over (depth, effect set) states
+JsBestMixResult findBestMixDP(
+    const Product &product,
+    const std::vector<Substance> &substances,
+    const std::unordered_map<std::string, int> &effectMultipliers,
+    int maxDepth,
+    ProgressCallback progressCallback,
+    const SearchOptions &options)
+{
+  // Search only the allowed substances, no deeper than an exact length asks for
+  std::vector<Substance> narrowedSubstances;
+  int narrowedDepth;
+  SearchOptions narrowedOptions;
+  if (narrowSearch(substances, maxDepth, options, narrowedSubstances, narrowedDepth, narrowedOptions))
+  {
+    return findBestMixDP(product, narrowedSubstances, effectMultipliers, narrowedDepth, progressCallback, narrowedOptions);
+  }
+
+  // Clear a stop left over from an earlier search, then honor this one's deadline and token
+  g_shouldTerminate = false;
+  stopRequested(options);
+
+  // Compile effect names and substance rules to bitmask form once for the whole search
+  CompiledEffects compiled = compileEffects(product, substances, effectMultipliers);
+  PricingContext pricing(product, compiled.registry, effectMultipliers);
+
+  // Budget, effect and length constraints. The cheapest path to a state is also the one
+  // most likely to fit the budget, so filtering states keeps the search exact
+  std::unique_ptr<ConstraintFilter> constraints;
+  if (options.constraints.any() && compiled.valid)
+  {
+    constraints.reset(new ConstraintFilter(options.constraints, substances, compiled));
+  }
+  DPScorer scorer(options, constraints.get(), maxDepth);
+
+  if (!compiled.valid)
+  {
+    std::cerr << "Error: more than " << MAX_EFFECT_IDS << " distinct effects, cannot run DP" << std::endl;
+    maxDepth = 0;
+  }
+  else if (maxDepth > static_cast<int>(MAX_MIX_LENGTH))
+  {
+    std::cerr << "Error: the DP engine supports mixes of at most " << MAX_MIX_LENGTH << " substances" << std::endl;
+    maxDepth = 0;
+  }
+  else if (substances.size() > std::numeric_limits<uint8_t>::max())
+  {
+    std::cerr << "Error: the DP engine supports at most "
+              << static_cast<int>(std::numeric_limits<uint8_t>::max()) << " substances" << std::endl;
+    maxDepth = 0;
+  }
+
+  // Layer 0 holds only the product's initial effects. The final layer is never stored:
+  // its states have no successors, so only its best candidate is remembered
+  std::vector<DPLayer> layers(1);
+  layers[0].entries.push_back({compiled.initialEffects, 0, -1, 0});
+
+  // Every parent is expanded by all substances, so children are computed a row at a time
+  RuleKernel kernel(compiled);
+  std::vector<EffectMask> children(substances.size());
+
+  int64_t processedTransitions = 0;
+  size_t storedStates = 1;
+
+  if (progressCallback)
+  {
+    progressCallback(1, 0, maxDepth);
+  }
+
+  for (int depth = 1; depth <= maxDepth && !g_shouldTerminate; ++depth)
+  {
+    const std::vector<DPStateEntry> &previous = layers[depth - 1].entries;
+    const bool storeLayer = depth < maxDepth;
+
+    DPLayer next;
+    LayerIndex index(storeLayer ? previous.size() * 4 : 0);
+    if (storeLayer)
+    {
+      next.entries.reserve(previous.size() * 4);
+    }
+
+    for (size_t parentIndex = 0; parentIndex < previous.size(); ++parentIndex)
+    {
+      // A cancelled search stops mid-layer and keeps the best mix found so far. The
+      // deadline and token are polled every few parents, the flag on every one
+      if (g_shouldTerminate.load(std::memory_order_relaxed) ||
+          (parentIndex % STOP_CHECK_PARENTS == 0 && stopRequested(options)))
+        break;
+
+      const DPStateEntry parent = previous[parentIndex];
+      kernel.expand(parent.effects, depth, children.data());
+
+      for (size_t substanceIndex = 0; substanceIndex < substances.size(); ++substanceIndex)
+      {
+        EffectMask effects = children[substanceIndex];
+        int costCents = parent.costCents + substances[substanceIndex].cost;
+
+        // Every candidate the constraints accept is scored, so the cheapest path to each
+        // state is always considered
+        scorer.offer(layers, depth, static_cast<int32_t>(parentIndex), static_cast<int>(substanceIndex),
+                     effects, costCents, [&]() { return pricing.sellPrice(effects); });
+
+        // States no constraint-satisfying mix extends aren't expanded further
+        if (storeLayer && scorer.canExtend(effects, costCents, depth))
+        {
+          // Keep only the cheapest path to each effect set at this depth
+          index.reserveFor(next.entries);
+          int32_t &slot = index.find(effects, next.entries);
+          if (slot < 0)
+          {
+            slot = static_cast<int32_t>(next.entries.size());
+            next.entries.push_back({effects, costCents, static_cast<int32_t>(parentIndex),
+                                    static_cast<uint8_t>(substanceIndex)});
+          }
+          else if (costCents < next.entries[slot].costCents)
+          {
+            DPStateEntry &entry = next.entries[slot];
+            entry.costCents = costCents;
+            entry.parentIndex = static_cast<int32_t>(parentIndex);
+            entry.substanceIndex = static_cast<uint8_t>(substanceIndex);
+          }
+        }
+      }
+    }
+
+    processedTransitions += static_cast<int64_t>(previous.size() * substances.size());
+
+    // Reconstruct and report the recipe if this depth improved the best mix
+    scorer.finishLayer(layers, depth, substances, progressCallback);
+
+    if (storeLayer)
+    {
+      storedStates += next.entries.size();
+      layers.push_back(std::move(next));
+    }
+
+    if (progressCallback)
+    {
+      progressCallback(depth, depth, maxDepth);
+    }
+  }
+
+#ifndef __EMSCRIPTEN__
+  std::cout << "DP explored " << processedTransitions << " transitions over "
+            << storedStates << " stored states" << std::endl;
+#endif
+
+  return scorer.result(substances);
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "types.h"
+#include "effects.h"
+#include "top_k.h"
+#include "constraints.h"
+#include <memory>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+// One (depth, effect set) state of the dynamic-programming search
+struct DPStateEntry
+{
+  EffectMask effects;     // Effect set reached at this depth
+  int costCents;          // Minimum cost of any mix reaching this effect set at this depth
+  int32_t parentIndex;    // Index of the predecessor entry in the previous layer (-1 at depth 0)
+  uint8_t substanceIndex; // Substance added to the predecessor to reach this entry
+};
+
+// All states reachable at one depth, with the cheapest path to each
+struct DPLayer
+{
+  std::vector<DPStateEntry> entries;
+};
+
+// Open-addressing index from effect mask to position in a layer being built, kept at
+// most half full. Layers hold DPStateEntry records or bare effect masks
+class LayerIndex
+{
+public:
+  explicit LayerIndex(size_t expectedEntries = 0)
+  {
+    size_t capacity = 16;
+    while (capacity < expectedEntries * 2)
+    {
+      capacity <<= 1;
+    }
+    slots.assign(capacity, -1);
+  }
+
+  // Get the slot for a mask: it holds the position, or -1 if the mask isn't in the layer yet
+  template <typename Entry>
+  int32_t &find(EffectMask mask, const std::vector<Entry> &layer)
+  {
+    size_t slotMask = slots.size() - 1;
+    size_t slot = hashEffectMask(mask) & slotMask;
+    while (slots[slot] >= 0 && maskOf(layer[slots[slot]]) != mask)
+    {
+      slot = (slot + 1) & slotMask;
+    }
+    return slots[slot];
+  }
+
+  // Grow before an insertion would make the index more than half full
+  template <typename Entry>
+  void reserveFor(const std::vector<Entry> &layer)
+  {
+    if ((layer.size() + 1) * 2 <= slots.size())
+      return;
+
+    slots.assign(slots.size() * 2, -1);
+    for (size_t i = 0; i < layer.size(); ++i)
+    {
+      find(maskOf(layer[i]), layer) = static_cast<int32_t>(i);
+    }
+  }
+
+private:
+  static EffectMask maskOf(EffectMask mask) { return mask; }
+  static EffectMask maskOf(const DPStateEntry &entry) { return entry.effects; }
+
+  std::vector<int32_t> slots;
+};
+
+// Scoring shared by the DP passes of findBestMixDP and StateGraph::solve, so both pick
+// the same mixes. Candidates are offered in edge order (parents in layer order, then
+// substances in order) and only a strictly better profit replaces the best mix, so ties
+// go to the first candidate. The best mix starts from the seed, if any, and otherwise
+// must beat not mixing at all, like in the DFS and BFS engines
+class DPScorer
+{
+public:
+  DPScorer(const SearchOptions &options, const ConstraintFilter *constraints, int maxDepth);
+
+  // Score the mix that adds a substance to entry parentIndex of layers[depth - 1], unless
+  // the constraints reject it. sellPrice() is only called for accepted mixes
+  template <typename SellPrice>
+  void offer(const std::vector<DPLayer> &layers, int depth, int32_t parentIndex, int substanceIndex,
+             EffectMask effects, int costCents, SellPrice sellPrice)
+  {
+    if (constraints && !constraints->accepts(effects, costCents, depth))
+      return;
+
+    int sellPriceCents = sellPrice();
+    int profitCents = sellPriceCents - costCents;
+    if (profitCents > bestProfitCents)
+    {
+      bestProfitCents = profitCents;
+      bestSellPriceCents = sellPriceCents;
+      bestCostCents = costCents;
+      layerBestParent = parentIndex;
+      layerBestSubstance = substanceIndex;
+    }
+
+    if (topMixes)
+    {
+      offerTopMix(layers, depth, parentIndex, substanceIndex, effects, profitCents, sellPriceCents, costCents);
+    }
+  }
+
+  // Whether a state is worth storing for the next depth: some constraint-satisfying mix
+  // must extend it
+  bool canExtend(EffectMask effects, int costCents, int depth) const
+  {
+    return !constraints || constraints->canExtend(effects, costCents, depth);
+  }
+
+  // Rebuild and report the best mix if the layer at `depth` improved it. With a progress
+  // callback the WebAssembly build reports it to JavaScript
+  void finishLayer(const std::vector<DPLayer> &layers, int depth, const std::vector<Substance> &substances,
+                   ProgressCallback progressCallback = nullptr);
+
+  JsBestMixResult result(const std::vector<Substance> &substances) const;
+
+  // Follow predecessor links back from a final (parent entry, substance) pair to rebuild
+  // the recipe
+  static MixState reconstructMix(const std::vector<DPLayer> &layers, int depth, int32_t parentIndex,
+                                 int substanceIndex);
+
+private:
+  void offerTopMix(const std::vector<DPLayer> &layers, int depth, int32_t parentIndex, int substanceIndex,
+                   EffectMask effects, int profitCents, int sellPriceCents, int costCents);
+
+  const SearchOptions &options;
+  const ConstraintFilter *constraints;
+  std::unique_ptr<TopMixList> topMixes;
+
+  MixState bestMix;
+  int bestProfitCents;
+  int bestSellPriceCents;
+  int bestCostCents;
+
+  // Best candidate of the layer being scored, as (parent entry, substance)
+  int32_t layerBestParent;
+  int layerBestSubstance;
+};
+
+// Dynamic-programming search over (depth, effect set) states.
+// Profit only depends on the final effect set and the total cost, so keeping the
+// cheapest path to each state at each depth is exact and scales with the number of
+// distinct states instead of substances^depth sequences
+JsBestMixResult findBestMixDP(
+    const Product &product,
+    const std::vector<Substance> &substances,
+    const std::unordered_map<std::string, int> &effectMultipliers,
+    int maxDepth,
+    ProgressCallback progressCallback = nullptr,
+    const SearchOptions &options = SearchOptions());
@@ -1,4 +1,174 @@
 #include "effects.h"
+#include <algorithm>
+
+// EffectRegistry implementation
+int EffectRegistry::intern(const std::string &name)
+{
+  auto it = ids.find(name);
+  if (it != ids.end())
+  {
+    return it->second;
+  }
+
+  if (names.size() >= static_cast<size_t>(MAX_EFFECT_IDS))
+  {
+    return -1;
+  }
+
+  int id = static_cast<int>(names.size());
+  names.push_back(name);
+  ids[name] = id;
+  return id;
+}
+
+int EffectRegistry::find(const std::string &name) const
+{
+  auto it = ids.find(name);
+  return it != ids.end() ? it->second : -1;
+}
+
+EffectMask EffectRegistry::toMask(const std::vector<std::string> &effects) const
+{
+  EffectMask mask = 0;
+  for (const auto &effect : effects)
+  {
+    int id = find(effect);
+    if (id >= 0)
+    {
+      mask |= EffectMask(1) << id;
+    }
+  }
+  return mask;
+}
+
+std::vector<std::string> EffectRegistry::toNames(EffectMask mask) const
+{
+  std::vector<std::string> result;
+  for (size_t id = 0; id < names.size(); ++id)
+  {
+    if (mask & (EffectMask(1) << id))
+    {
+      result.push_back(names[id]);
+    }
+  }
+  return result;
+}
+
+// Intern a name and return its bit, clearing the valid flag if the registry overflows
+static EffectMask internBit(CompiledEffects &compiled, const std::string &name)
+{
+  if (name.empty())
+  {
+    return 0;
+  }
+
+  int id = compiled.registry.intern(name);
+  if (id < 0)
+  {
+    compiled.valid = false;
+    return 0;
+  }
+  return EffectMask(1) << id;
+}
+
+static EffectMask internMask(CompiledEffects &compiled, const std::vector<std::string> &names)
+{
+  EffectMask mask = 0;
+  for (const auto &name : names)
+  {
+    mask |= internBit(compiled, name);
+  }
+  return mask;
+}
+
+// Compile substances and the product's initial effect to bitmask form
+CompiledEffects compileEffects(
+    const Product &product,
+    const std::vector<Substance> &substances,
+    const std::unordered_map<std::string, int> &effectMultipliers)
+{
+  CompiledEffects compiled;
+  compiled.valid = true;
+
+  // Intern multiplier names in sorted order so IDs don't depend on hash map iteration order
+  std::vector<std::string> multiplierNames;
+  multiplierNames.reserve(effectMultipliers.size());
+  for (const auto &pair : effectMultipliers)
+  {
+    multiplierNames.push_back(pair.first);
+  }
+  std::sort(multiplierNames.begin(), multiplierNames.end());
+  internMask(compiled, multiplierNames);
+
+  compiled.initialEffects = internBit(compiled, product.initialEffect);
+
+  compiled.substances.reserve(substances.size());
+  for (const auto &substance : substances)
+  {
+    CompiledSubstance cs;
+    cs.defaultEffectBit = internBit(compiled, substance.defaultEffect);
+    cs.rules.reserve(substance.rules.size());
+
+    for (const auto &rule : substance.rules)
+    {
+      CompiledRule cr;
+      cr.conditionMask = internMask(compiled, rule.condition);
+      cr.ifNotPresentMask = internMask(compiled, rule.ifNotPresent);
+      cr.targetBit = internBit(compiled, rule.target);
+      cr.withBit = internBit(compiled, rule.withEffect);
+
+      if (rule.type == "replace" && !rule.withEffect.empty())
+        cr.action = RULE_REPLACE;
+      else if (rule.type == "add")
+        cr.action = RULE_ADD;
+      else
+        cr.action = RULE_NONE;
+
+      cs.rules.push_back(cr);
+    }
+
+    compiled.substances.push_back(cs);
+  }
+
+  return compiled;
+}
+
+static bool sameRule(const CompiledRule &a, const CompiledRule &b)
+{
+  return a.conditionMask == b.conditionMask && a.ifNotPresentMask == b.ifNotPresentMask &&
+         a.targetBit == b.targetBit && a.withBit == b.withBit && a.action == b.action;
+}
+
+static bool sameSubstance(const CompiledSubstance &a, const CompiledSubstance &b)
+{
+  return a.defaultEffectBit == b.defaultEffectBit && a.rules.size() == b.rules.size() &&
+         std::equal(a.rules.begin(), a.rules.end(), b.rules.begin(), sameRule);
+}
+
+bool sameCompiledSubstances(const std::vector<CompiledSubstance> &a, const std::vector<CompiledSubstance> &b)
+{
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), sameSubstance);
+}
+
+bool sameRuleTables(const CompiledEffects &a, const CompiledEffects &b)
+{
+  // Equal names mean equal effect IDs, so masks of both rule sets mean the same effects
+  return a.registry.names == b.registry.names && sameCompiledSubstances(a.substances, b.substances);
+}
+
+// Calculate the effect mask for a mix from scratch
+EffectMask calculateEffectsMaskForMix(
+    const MixState &mixState,
+    const CompiledEffects &compiled)
+{
+  EffectMask effects = compiled.initialEffects;
+  for (size_t i = 0; i < mixState.substanceIndices.size(); ++i)
+  {
+    effects = applySubstanceRulesMask(
+        effects, compiled.substances[mixState.substanceIndices[i]], static_cast<int>(i + 1));
+  }
+  return effects;
+}
 
 // Apply substance rules to current effects
 std::vector<std::string> applySubstanceRules(
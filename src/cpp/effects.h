@@ -4,6 +4,160 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Bitmask representation of an effect set - bit N is set when the effect with ID N is present
+typedef uint64_t EffectMask;
+
+// Maximum number of distinct effect names that fit in an EffectMask
+const int MAX_EFFECT_IDS = 64;
+
+// Index of the lowest set bit (mask must be non-zero)
+inline int countTrailingZeros(EffectMask mask)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(mask);
+#endif
+}
+
+// Number of effects in a mask
+inline int countEffects(EffectMask mask)
+{
+#ifdef _MSC_VER
+  return static_cast<int>(__popcnt64(mask));
+#else
+  return __builtin_popcountll(mask);
+#endif
+}
+
+// Mix the bits of an effect mask for hash set slot selection
+inline uint64_t hashEffectMask(EffectMask mask)
+{
+  uint64_t h = mask * 0x9E3779B97F4A7C15ULL;
+  return h ^ (h >> 29);
+}
+
+// Interns effect names to small integer IDs (bit positions in an EffectMask)
+struct EffectRegistry
+{
+  std::vector<std::string> names;
+  std::unordered_map<std::string, int> ids;
+
+  // Get the ID for an effect name, adding it if needed. Returns -1 when the registry is full
+  int intern(const std::string &name);
+
+  // Get the ID for an effect name without adding it. Returns -1 if unknown
+  int find(const std::string &name) const;
+
+  // Convert a list of effect names to a mask (unknown names are ignored)
+  EffectMask toMask(const std::vector<std::string> &effects) const;
+
+  // Convert a mask back to a list of effect names
+  std::vector<std::string> toNames(EffectMask mask) const;
+
+  size_t size() const { return names.size(); }
+};
+
+// Rule actions compiled from the "replace"/"add" strings
+enum RuleAction : uint8_t
+{
+  RULE_NONE = 0, // Rule can never change the effect set (e.g. "replace" without withEffect)
+  RULE_REPLACE,
+  RULE_ADD
+};
+
+// A SubstanceRule with its conditions compiled to mask tests
+struct CompiledRule
+{
+  EffectMask conditionMask;    // All of these must be present
+  EffectMask ifNotPresentMask; // None of these may be present
+  EffectMask targetBit;        // Effect replaced (replace) or added (add)
+  EffectMask withBit;          // Replacement effect (replace only)
+  RuleAction action;
+};
+
+// A Substance with its rules compiled against an EffectRegistry
+struct CompiledSubstance
+{
+  EffectMask defaultEffectBit;
+  std::vector<CompiledRule> rules;
+};
+
+// Substances and the product's initial effect compiled to bitmask form, built once per search
+struct CompiledEffects
+{
+  EffectRegistry registry;
+  std::vector<CompiledSubstance> substances;
+  EffectMask initialEffects;
+  bool valid; // False if the effect names didn't fit in an EffectMask
+
+  CompiledEffects() : initialEffects(0), valid(false) {}
+};
+
+// Intern all effect names and compile the substance rules to mask operations.
+// Effect multiplier names are interned first so their IDs are stable across products
+CompiledEffects compileEffects(
+    const Product &product,
+    const std::vector<Substance> &substances,
+    const std::unordered_map<std::string, int> &effectMultipliers);
+
+// Whether two lists of compiled substances have the same default effects and rules
+bool sameCompiledSubstances(const std::vector<CompiledSubstance> &a, const std::vector<CompiledSubstance> &b);
+
+// Whether two compilations give every effect the same ID and every substance the same
+// rules, so effect masks and transitions of one are valid for the other. Their initial
+// effects may differ
+bool sameRuleTables(const CompiledEffects &a, const CompiledEffects &b);
+
+// Apply compiled substance rules to an effect mask - no heap allocation
+inline EffectMask applySubstanceRulesMask(
+    EffectMask currentEffects,
+    const CompiledSubstance &substance,
+    int recipeLength)
+{
+  EffectMask newEffects = currentEffects;
+
+  // Conditions and exclusions are always tested against the original effects
+  for (const CompiledRule &rule : substance.rules)
+  {
+    if ((currentEffects & rule.conditionMask) != rule.conditionMask ||
+        (currentEffects & rule.ifNotPresentMask) != 0)
+      continue;
+
+    if (rule.action == RULE_REPLACE)
+    {
+      if ((newEffects & rule.targetBit) && !(newEffects & rule.withBit))
+      {
+        newEffects = (newEffects & ~rule.targetBit) | rule.withBit;
+      }
+    }
+    else if (rule.action == RULE_ADD)
+    {
+      newEffects |= rule.targetBit;
+    }
+  }
+
+  // Ensure default effect is present
+  if (recipeLength < 9)
+  {
+    newEffects |= substance.defaultEffectBit;
+  }
+
+  return newEffects;
+}
+
+// Calculate the effect mask for a mix from scratch
+EffectMask calculateEffectsMaskForMix(
+    const MixState &mixState,
+    const CompiledEffects &compiled);
 
 // Apply substance rules to current effects
 std::vector<std::string> applySubstanceRules(
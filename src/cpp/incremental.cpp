@@ -0,0 +1,243 @@
+#include "incremental.h"
+#include "dp_algorithm.h"
+#include "top_k.h"
+#include "rule_kernel.h"
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/val.h>
+using namespace emscripten;
+#endif
+
+// External cancellation flag and its deadline and token check (defined in dfs_algorithm.cpp)
+extern std::atomic<bool> g_shouldTerminate;
+bool stopRequested(const SearchOptions &options);
+
+// Parents expanded between two looks at the clock and the cancellation token
+static const size_t STOP_CHECK_PARENTS = 1024;
+
+StateGraph::StateGraph(const CompiledEffects &compiled, int maxDepth)
+    : effectNames(compiled.registry.names),
+      compiledSubstances(compiled.substances),
+      initialEffects(compiled.initialEffects)
+{
+  const size_t substanceCount = compiled.substances.size();
+  RuleKernel kernel(compiled);
+  std::vector<EffectMask> children(substanceCount);
+
+  layers.resize(1);
+  layers[0].push_back(compiled.initialEffects);
+  successors.resize(1);
+
+  // States enter each layer in the order the DP engine stores them, so both engines
+  // break ties between equally profitable mixes the same way
+  for (int depth = 1; depth <= maxDepth; ++depth)
+  {
+    const std::vector<EffectMask> &previous = layers[depth - 1];
+    std::vector<EffectMask> layer;
+    std::vector<int32_t> edges;
+    edges.reserve(previous.size() * substanceCount);
+    LayerIndex index;
+
+    for (EffectMask parent : previous)
+    {
+      kernel.expand(parent, depth, children.data());
+      for (size_t s = 0; s < substanceCount; ++s)
+      {
+        index.reserveFor(layer);
+        int32_t &slot = index.find(children[s], layer);
+        if (slot < 0)
+        {
+          slot = static_cast<int32_t>(layer.size());
+          layer.push_back(children[s]);
+        }
+        edges.push_back(slot);
+      }
+    }
+
+    layers.push_back(std::move(layer));
+    successors.push_back(std::move(edges));
+  }
+}
+
+bool StateGraph::matches(const CompiledEffects &compiled, int maxDepth) const
+{
+  // Equal names mean equal effect IDs, so masks of both rule sets mean the same effects
+  return maxDepth <= depth() &&
+         compiled.initialEffects == initialEffects &&
+         compiled.registry.names == effectNames &&
+         sameCompiledSubstances(compiled.substances, compiledSubstances);
+}
+
+size_t StateGraph::stateCount() const
+{
+  size_t count = 0;
+  for (const std::vector<EffectMask> &layer : layers)
+  {
+    count += layer.size();
+  }
+  return count;
+}
+
+JsBestMixResult StateGraph::solve(
+    const std::vector<Substance> &substances,
+    const PricingContext &pricing,
+    int maxDepth,
+    const SearchOptions &options,
+    const ConstraintFilter *constraints) const
+{
+  const size_t substanceCount = substances.size();
+  maxDepth = std::min(maxDepth, depth());
+  DPScorer scorer(options, constraints, maxDepth);
+
+  // Cheapest path to every state of the layers before the last one, in the DP engine's
+  // layout so paths are rebuilt the same way. A cost of INT_MAX marks an unreached state
+  std::vector<DPLayer> paths(1);
+  paths[0].entries.push_back({initialEffects, 0, -1, 0});
+  std::vector<int> statePrices;
+
+  for (int depth = 1; depth <= maxDepth && !g_shouldTerminate; ++depth)
+  {
+    const std::vector<DPStateEntry> &previous = paths[depth - 1].entries;
+    const std::vector<int32_t> &edges = successors[depth];
+    const bool storeLayer = depth < maxDepth;
+
+    // Price each state once rather than once per edge leading to it
+    const std::vector<EffectMask> &layer = layers[depth];
+    statePrices.resize(layer.size());
+    for (size_t i = 0; i < layer.size(); ++i)
+    {
+      statePrices[i] = pricing.sellPrice(layer[i]);
+    }
+
+    DPLayer next;
+    if (storeLayer)
+    {
+      next.entries.resize(layer.size());
+      for (size_t i = 0; i < layer.size(); ++i)
+      {
+        next.entries[i] = {layer[i], std::numeric_limits<int>::max(), -1, 0};
+      }
+    }
+
+    for (size_t parentIndex = 0; parentIndex < previous.size(); ++parentIndex)
+    {
+      // A cancelled search stops mid-layer and keeps the best mix found so far. The
+      // deadline and token are polled every few parents, the flag on every one
+      if (g_shouldTerminate.load(std::memory_order_relaxed) ||
+          (parentIndex % STOP_CHECK_PARENTS == 0 && stopRequested(options)))
+        break;
+
+      // States only reached by paths the constraints cut have no path to extend
+      const int parentCostCents = previous[parentIndex].costCents;
+      if (parentCostCents == std::numeric_limits<int>::max())
+        continue;
+
+      const int32_t *row = &edges[parentIndex * substanceCount];
+
+      for (size_t substanceIndex = 0; substanceIndex < substanceCount; ++substanceIndex)
+      {
+        int32_t child = row[substanceIndex];
+        int costCents = parentCostCents + substances[substanceIndex].cost;
+        scorer.offer(paths, depth, static_cast<int32_t>(parentIndex), static_cast<int>(substanceIndex),
+                     layer[child], costCents, [&]() { return statePrices[child]; });
+
+        if (storeLayer && costCents < next.entries[child].costCents &&
+            scorer.canExtend(layer[child], costCents, depth))
+        {
+          DPStateEntry &entry = next.entries[child];
+          entry.costCents = costCents;
+          entry.parentIndex = static_cast<int32_t>(parentIndex);
+          entry.substanceIndex = static_cast<uint8_t>(substanceIndex);
+        }
+      }
+    }
+
+    scorer.finishLayer(paths, depth, substances);
+
+    if (storeLayer)
+    {
+      paths.push_back(std::move(next));
+    }
+  }
+
+  return scorer.result(substances);
+}
+
+// State graph of the last incremental search. Held by shared_ptr so a search that
+// replaces it doesn't free the graph under another search still scoring it
+static std::mutex g_stateGraphMutex;
+static std::shared_ptr<const StateGraph> g_stateGraph;
+
+JsBestMixResult findBestMixIncremental(
+    const Product &product,
+    const std::vector<Substance> &substances,
+    const std::unordered_map<std::string, int> &effectMultipliers,
+    int maxDepth,
+    const SearchOptions &options)
+{
+  // Score only the allowed substances, no deeper than an exact length asks for
+  std::vector<Substance> narrowedSubstances;
+  int narrowedDepth;
+  SearchOptions narrowedOptions;
+  if (narrowSearch(substances, maxDepth, options, narrowedSubstances, narrowedDepth, narrowedOptions))
+  {
+    return findBestMixIncremental(product, narrowedSubstances, effectMultipliers, narrowedDepth, narrowedOptions);
+  }
+
+  // Clear a stop left over from an earlier search, then honor this one's deadline and token
+  g_shouldTerminate = false;
+  stopRequested(options);
+
+  CompiledEffects compiled = compileEffects(product, substances, effectMultipliers);
+
+  // Inputs the graph can't represent are reported by the DP engine, which shares its limits
+  if (!compiled.valid || maxDepth > static_cast<int>(MAX_MIX_LENGTH) ||
+      substances.size() > std::numeric_limits<uint8_t>::max())
+  {
+    return findBestMixDP(product, substances, effectMultipliers, maxDepth, nullptr, options);
+  }
+
+  std::shared_ptr<const StateGraph> graph;
+  bool rebuilt = false;
+  {
+    std::lock_guard<std::mutex> lock(g_stateGraphMutex);
+    if (!g_stateGraph || !g_stateGraph->matches(compiled, maxDepth))
+    {
+      // Free the old graph before building its replacement
+      g_stateGraph.reset();
+      g_stateGraph = std::make_shared<const StateGraph>(compiled, maxDepth);
+      rebuilt = true;
+    }
+    graph = g_stateGraph;
+  }
+
+#ifndef __EMSCRIPTEN__
+  std::cout << (rebuilt ? "Built" : "Reusing") << " a state graph of " << graph->stateCount()
+            << " states to depth " << graph->depth() << std::endl;
+#else
+  (void)rebuilt;
+#endif
+
+  // Constraints filter the cheapest paths of each solve, never the graph, which doesn't
+  // depend on costs
+  std::unique_ptr<ConstraintFilter> constraints;
+  if (options.constraints.any())
+  {
+    constraints.reset(new ConstraintFilter(options.constraints, substances, compiled));
+  }
+
+  PricingContext pricing(product, compiled.registry, effectMultipliers);
+  return graph->solve(substances, pricing, maxDepth, options, constraints.get());
+}
+
+void clearIncrementalStateGraph()
+{
+  std::lock_guard<std::mutex> lock(g_stateGraphMutex);
+  g_stateGraph.reset();
+}
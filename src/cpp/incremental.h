@@ -0,0 +1,62 @@
+#pragma once
+
+#include "types.h"
+#include "effects.h"
+#include "pricing.h"
+#include "constraints.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+// Effect-state graph of one product and rule set. Layer d holds every effect set
+// reachable with d substances, and adding substance s to state i of layer d - 1 leads
+// to state successors[d][i * substanceCount + s] of layer d. The graph only depends on
+// the rules, not on costs or multipliers, so it's built once and re-scored after price
+// changes without applying any rules
+class StateGraph
+{
+public:
+  StateGraph(const CompiledEffects &compiled, int maxDepth);
+
+  // Whether the graph was built from the same effect names, initial effects and rules,
+  // and is deep enough for a search to maxDepth
+  bool matches(const CompiledEffects &compiled, int maxDepth) const;
+
+  int depth() const { return static_cast<int>(layers.size()) - 1; }
+  size_t stateCount() const;
+
+  // Best mix (and top list) for the substances' current costs and the given prices: one
+  // dynamic-programming pass over the stored transitions, keeping the cheapest path to
+  // each state. Scores through the same DPScorer as findBestMixDP, so it finds the same
+  // mix, only scoring mixes the constraints accept when given
+  JsBestMixResult solve(
+      const std::vector<Substance> &substances,
+      const PricingContext &pricing,
+      int maxDepth,
+      const SearchOptions &options,
+      const ConstraintFilter *constraints = nullptr) const;
+
+private:
+  std::vector<std::vector<EffectMask>> layers;
+  std::vector<std::vector<int32_t>> successors; // successors[d] leads from layer d - 1 to layer d
+
+  // What the graph was built from
+  std::vector<std::string> effectNames;
+  std::vector<CompiledSubstance> compiledSubstances;
+  EffectMask initialEffects;
+};
+
+// Search like findBestMixDP, reusing the state graph of the previous call when the
+// product's initial effect and the substances' rules are unchanged. Then only the
+// re-scoring pass runs, so changing a substance cost, an effect multiplier or the
+// base price is answered without redoing any rule application
+JsBestMixResult findBestMixIncremental(
+    const Product &product,
+    const std::vector<Substance> &substances,
+    const std::unordered_map<std::string, int> &effectMultipliers,
+    int maxDepth,
+    const SearchOptions &options = SearchOptions());
+
+// Drop the kept state graph, e.g. to free its memory
+void clearIncrementalStateGraph();
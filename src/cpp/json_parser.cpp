@@ -1,4 +1,5 @@
 #include "json_parser.h"
+#include <algorithm>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
@@ -10,6 +11,11 @@ Product parseProductJson(const std::string &productJson)
   json doc = json::parse(productJson);
   product.name = doc["name"].get<std::string>();
   product.initialEffect = doc["initialEffect"].get<std::string>();
+  // Base price in dollars, like substance costs; optional for older callers
+  if (doc.contains("basePrice") && doc["basePrice"].is_number())
+  {
+    product.basePriceCents = static_cast<int>(std::round(doc["basePrice"].get<double>() * 100.0));
+  }
   return product;
 }
 
@@ -112,3 +118,31 @@ void applySubstanceRulesJson(
     }
   }
 }
+
+// Parse search constraints from JSON
+SearchConstraints parseSearchConstraintsJson(const std::string &constraintsJson)
+{
+  SearchConstraints constraints;
+  if (constraintsJson.empty())
+    return constraints;
+
+  json doc = json::parse(constraintsJson);
+  if (doc.contains("maxCost") && doc["maxCost"].is_number())
+  {
+    constraints.maxCostCents = static_cast<int>(std::round(doc["maxCost"].get<double>() * 100.0));
+  }
+  if (doc.contains("requiredEffects"))
+  {
+    constraints.requiredEffects = doc["requiredEffects"].get<std::vector<std::string>>();
+  }
+  if (doc.contains("forbiddenEffects"))
+  {
+    constraints.forbiddenEffects = doc["forbiddenEffects"].get<std::vector<std::string>>();
+  }
+  if (doc.contains("allowedSubstances"))
+  {
+    constraints.allowedSubstances = doc["allowedSubstances"].get<std::vector<std::string>>();
+  }
+  constraints.exactLength = std::max(0, doc.value("exactLength", 0));
+  return constraints;
+}
@@ -18,3 +18,8 @@ std::unordered_map<std::string, int> parseEffectMultipliersJson(const std::strin
 void applySubstanceRulesJson(
     std::vector<Substance> &substances,
     const std::string &substanceRulesJson);
+
+// Parse search constraints from a JSON object {"maxCost", "requiredEffects",
+// "forbiddenEffects", "allowedSubstances", "exactLength"}; every field is optional and
+// maxCost is in dollars. An empty string gives no constraints
+SearchConstraints parseSearchConstraintsJson(const std::string &constraintsJson);
@@ -0,0 +1,225 @@
+#include "metrics.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Time constant of the throughput average, in seconds
+static const double THROUGHPUT_SMOOTHING_SECONDS = 5.0;
+
+std::vector<int64_t> mixCountsByDepth(size_t substanceCount, int maxDepth)
+{
+  std::vector<int64_t> counts(std::max(maxDepth, 0) + 1, 0);
+  const int64_t limit = std::numeric_limits<int64_t>::max();
+  const int64_t branching = std::max<int64_t>(static_cast<int64_t>(substanceCount), 1);
+  int64_t levelSize = 1;
+  for (int depth = 1; depth <= maxDepth; ++depth)
+  {
+    levelSize = levelSize > limit / branching ? limit : levelSize * branching;
+    counts[depth] = counts[depth - 1] > limit - levelSize ? limit : counts[depth - 1] + levelSize;
+  }
+  return counts;
+}
+
+void ThreadCounters::reset()
+{
+  nodes.store(0, std::memory_order_relaxed);
+  for (std::atomic<int64_t> &count : depthNodes)
+  {
+    count.store(0, std::memory_order_relaxed);
+  }
+  cacheHits.store(0, std::memory_order_relaxed);
+  cacheMisses.store(0, std::memory_order_relaxed);
+  prunedSubtrees.store(0, std::memory_order_relaxed);
+  prunedNodes.store(0, std::memory_order_relaxed);
+  dominatedSubtrees.store(0, std::memory_order_relaxed);
+  dominatedNodes.store(0, std::memory_order_relaxed);
+  completedUnits.store(0, std::memory_order_relaxed);
+  busyMicros.store(0, std::memory_order_relaxed);
+}
+
+double MetricsSnapshot::cacheHitRate() const
+{
+  int64_t lookups = cacheHits + cacheMisses;
+  return lookups > 0 ? static_cast<double>(cacheHits) / lookups : 0.0;
+}
+
+std::string MetricsSnapshot::toJson() const
+{
+  nlohmann::ordered_json json;
+  json["elapsedSeconds"] = elapsedSeconds;
+  json["nodes"] = nodes;
+  json["totalNodes"] = totalNodes;
+  json["nodesPerSecond"] = nodesPerSecond;
+  json["depthNodes"] = depthNodes;
+  json["cacheHits"] = cacheHits;
+  json["cacheMisses"] = cacheMisses;
+  json["cacheHitRate"] = cacheHitRate();
+  json["prunedSubtrees"] = prunedSubtrees;
+  json["prunedNodes"] = prunedNodes;
+  json["dominatedSubtrees"] = dominatedSubtrees;
+  json["dominatedNodes"] = dominatedNodes;
+  json["threadUtilization"] = threadUtilization;
+  json["coveredNodes"] = coveredNodes;
+  json["remainingNodes"] = remainingNodes;
+  json["completedUnits"] = completedUnits;
+  json["totalUnits"] = totalUnits;
+  json["progress"] = progress;
+  json["coveredPerSecond"] = coveredPerSecond;
+  json["etaSeconds"] = etaSeconds;
+  return json.dump();
+}
+
+ThroughputEstimator::ThroughputEstimator() : lastSeconds(0.0), lastCovered(0), rate(-1.0) {}
+
+double ThroughputEstimator::update(double elapsedSeconds, int64_t covered)
+{
+  // A sample at the start only sets where the count starts from
+  double interval = elapsedSeconds - lastSeconds;
+  if (interval <= 0.0)
+  {
+    if (rate < 0.0)
+      lastCovered = covered;
+    return rate;
+  }
+
+  // Samples closer together than the time constant move the average by less
+  double sampleRate = (covered - lastCovered) / interval;
+  double weight = 1.0 - std::exp(-interval / THROUGHPUT_SMOOTHING_SECONDS);
+  rate = rate < 0.0 ? sampleRate : rate + weight * (sampleRate - rate);
+  lastSeconds = elapsedSeconds;
+  lastCovered = covered;
+  return rate;
+}
+
+double ThroughputEstimator::etaSeconds(int64_t remaining) const
+{
+  if (remaining <= 0)
+    return 0.0;
+  return rate > 0.0 ? remaining / rate : -1.0;
+}
+
+SearchMetrics::SearchMetrics(int threadCount, int maxDepth, int64_t totalNodes, int64_t totalUnits)
+    : counters(threadCount > 0 ? threadCount : 1),
+      maxDepth(maxDepth),
+      totalNodes(totalNodes),
+      totalUnits(totalUnits),
+      resumedUnits(0),
+      resumedNodes(0),
+      start(std::chrono::steady_clock::now())
+{
+}
+
+void SearchMetrics::addResumed(int64_t units, int64_t nodes)
+{
+  resumedUnits += units;
+  resumedNodes += nodes;
+}
+
+MetricsSnapshot SearchMetrics::snapshot() const
+{
+  MetricsSnapshot snapshot;
+  snapshot.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  snapshot.nodes = 0;
+  snapshot.totalNodes = totalNodes;
+  snapshot.depthNodes.assign(maxDepth, 0);
+  snapshot.cacheHits = 0;
+  snapshot.cacheMisses = 0;
+  snapshot.prunedSubtrees = 0;
+  snapshot.prunedNodes = 0;
+  snapshot.dominatedSubtrees = 0;
+  snapshot.dominatedNodes = 0;
+  snapshot.completedUnits = resumedUnits;
+  snapshot.totalUnits = totalUnits;
+
+  for (const ThreadCounters &thread : counters)
+  {
+    snapshot.nodes += thread.nodes.load(std::memory_order_relaxed);
+    for (int depth = 1; depth <= maxDepth; ++depth)
+    {
+      snapshot.depthNodes[depth - 1] += thread.depthNodes[depth].load(std::memory_order_relaxed);
+    }
+    snapshot.cacheHits += thread.cacheHits.load(std::memory_order_relaxed);
+    snapshot.cacheMisses += thread.cacheMisses.load(std::memory_order_relaxed);
+    snapshot.prunedSubtrees += thread.prunedSubtrees.load(std::memory_order_relaxed);
+    snapshot.prunedNodes += thread.prunedNodes.load(std::memory_order_relaxed);
+    snapshot.dominatedSubtrees += thread.dominatedSubtrees.load(std::memory_order_relaxed);
+    snapshot.dominatedNodes += thread.dominatedNodes.load(std::memory_order_relaxed);
+    snapshot.completedUnits += thread.completedUnits.load(std::memory_order_relaxed);
+
+    double busySeconds = thread.busyMicros.load(std::memory_order_relaxed) / 1e6;
+    snapshot.threadUtilization.push_back(
+        snapshot.elapsedSeconds > 0 ? std::min(1.0, busySeconds / snapshot.elapsedSeconds) : 0.0);
+  }
+
+  snapshot.nodesPerSecond = snapshot.elapsedSeconds > 0 ? snapshot.nodes / snapshot.elapsedSeconds : 0.0;
+
+  // Counters are sampled while workers write them, so clamp what was covered to the total
+  int64_t searched = snapshot.nodes + snapshot.prunedNodes + snapshot.dominatedNodes;
+  snapshot.coveredNodes = std::min(totalNodes, resumedNodes + searched);
+  snapshot.remainingNodes = totalNodes - snapshot.coveredNodes;
+  snapshot.progress = totalNodes > 0 ? static_cast<double>(snapshot.coveredNodes) / totalNodes : 1.0;
+  {
+    std::lock_guard<std::mutex> lock(throughputMutex);
+    snapshot.coveredPerSecond = std::max(0.0, throughput.update(snapshot.elapsedSeconds, searched));
+    snapshot.etaSeconds = throughput.etaSeconds(snapshot.remainingNodes);
+  }
+  return snapshot;
+}
+
+MetricsReporter::MetricsReporter(const SearchMetrics &metrics, int intervalMs, SampleCallback sample)
+    : metrics(metrics),
+      intervalMs(intervalMs > 0 ? intervalMs : 1),
+      sample(sample),
+      stopping(false),
+      thread(&MetricsReporter::run, this)
+{
+}
+
+MetricsReporter::~MetricsReporter()
+{
+  stop();
+}
+
+void MetricsReporter::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  if (thread.joinable())
+  {
+    thread.join();
+  }
+}
+
+void MetricsReporter::run()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!stopping)
+  {
+    wake.wait_for(lock, std::chrono::milliseconds(intervalMs));
+
+    // Sample without holding the lock, so stop() never waits on a slow callback
+    lock.unlock();
+    sample(metrics.snapshot());
+    lock.lock();
+  }
+}
+
+static std::mutex g_latestMetricsMutex;
+static std::string g_latestMetricsJson;
+
+void publishSearchMetrics(const MetricsSnapshot &snapshot)
+{
+  std::string json = snapshot.toJson();
+  std::lock_guard<std::mutex> lock(g_latestMetricsMutex);
+  g_latestMetricsJson.swap(json);
+}
+
+std::string latestSearchMetricsJson()
+{
+  std::lock_guard<std::mutex> lock(g_latestMetricsMutex);
+  return g_latestMetricsJson;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "types.h"
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+// Search counters of one worker thread. Only the owning thread writes them, with a
+// relaxed load and store rather than a read-modify-write, and each block is padded to
+// whole cache lines so workers never write to a line another worker uses. Readers
+// sample them at any time without synchronizing with the worker
+struct alignas(64) ThreadCounters
+{
+  std::atomic<int64_t> nodes;                         // Mixes evaluated
+  std::atomic<int64_t> depthNodes[MAX_MIX_LENGTH + 1]; // Mixes evaluated per recipe length
+  std::atomic<int64_t> cacheHits;                     // EffectsCache steps served by the transition table
+  std::atomic<int64_t> cacheMisses;                   // EffectsCache steps that applied the rules
+  std::atomic<int64_t> prunedSubtrees;                // Subtrees cut by branch-and-bound
+  std::atomic<int64_t> prunedNodes;                   // Mixes in those subtrees
+  std::atomic<int64_t> dominatedSubtrees;             // Subtrees skipped by the dominance table
+  std::atomic<int64_t> dominatedNodes;                // Mixes in those subtrees
+  std::atomic<int64_t> completedUnits;                // Work units searched to the end
+  std::atomic<int64_t> busyMicros;                    // Time spent on work units
+
+  ThreadCounters() { reset(); }
+
+  void reset();
+
+  static void add(std::atomic<int64_t> &counter, int64_t amount)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+
+  // Count one evaluated mix of the given length
+  void addNode(int depth)
+  {
+    add(nodes, 1);
+    add(depthNodes[depth], 1);
+  }
+};
+
+// Number of mixes of 1..depth substances, indexed by depth, which is also the size of the
+// subtree below a mix with that many levels left. Saturates instead of overflowing
+std::vector<int64_t> mixCountsByDepth(size_t substanceCount, int maxDepth);
+
+// Totals of all threads' counters at one point of a search
+struct MetricsSnapshot
+{
+  double elapsedSeconds;
+  int64_t nodes;
+  int64_t totalNodes; // Size of the search space, for progress
+  double nodesPerSecond;
+  std::vector<int64_t> depthNodes;
+  int64_t cacheHits;
+  int64_t cacheMisses;
+  int64_t prunedSubtrees;
+  int64_t prunedNodes;
+  int64_t dominatedSubtrees;
+  int64_t dominatedNodes;
+  std::vector<double> threadUtilization; // Busy fraction of each thread's wall time
+
+  // Progress. Every mix of the search space is either evaluated, skipped with a pruned or
+  // dominated subtree, or was searched before a resumed checkpoint, so coveredNodes reaches
+  // totalNodes exactly when the search finishes, whatever was cut
+  int64_t coveredNodes;
+  int64_t remainingNodes;
+  int64_t completedUnits;
+  int64_t totalUnits;
+  double progress;          // coveredNodes / totalNodes
+  double coveredPerSecond;  // Smoothed rate at which coveredNodes grows
+  double etaSeconds;        // Time left at that rate, or -1 before there is one
+
+  // Fraction of EffectsCache steps served by the transition table
+  double cacheHitRate() const;
+
+  // One line of JSON, without the trailing newline
+  std::string toJson() const;
+};
+
+// Remaining time of a search from successive (elapsed, covered) samples. The rate is an
+// exponential moving average over a few seconds, so it follows a search that speeds up as
+// its bound tightens without jumping with every sample
+class ThroughputEstimator
+{
+public:
+  ThroughputEstimator();
+
+  // Add a sample and return the smoothed rate
+  double update(double elapsedSeconds, int64_t covered);
+
+  // Seconds to cover `remaining` more at the smoothed rate, or -1 without a rate yet
+  double etaSeconds(int64_t remaining) const;
+
+private:
+  double lastSeconds;
+  int64_t lastCovered;
+  double rate;
+};
+
+// Per-thread counters of one search
+class SearchMetrics
+{
+public:
+  SearchMetrics(int threadCount, int maxDepth, int64_t totalNodes, int64_t totalUnits = 0);
+
+  ThreadCounters &thread(int index) { return counters[index]; }
+  int threadCount() const { return static_cast<int>(counters.size()); }
+
+  // Count work units finished before a resumed checkpoint, with the mixes they cover,
+  // toward progress but not toward this run's throughput. Call before the workers start
+  void addResumed(int64_t units, int64_t nodes);
+
+  // Totals of the counters. Safe to call from any thread
+  MetricsSnapshot snapshot() const;
+
+private:
+  std::vector<ThreadCounters> counters;
+  int maxDepth;
+  int64_t totalNodes;
+  int64_t totalUnits;
+  int64_t resumedUnits;
+  int64_t resumedNodes;
+  std::chrono::steady_clock::time_point start;
+
+  // Snapshots may be taken by the reporter and the checkpoint writer at once
+  mutable std::mutex throughputMutex;
+  mutable ThroughputEstimator throughput;
+};
+
+// Samples a SearchMetrics on its own thread every interval and hands each snapshot to
+// `sample`, so workers never call progress callbacks or take locks themselves. A last
+// sample is taken when the reporter is stopped
+class MetricsReporter
+{
+public:
+  typedef std::function<void(const MetricsSnapshot &)> SampleCallback;
+
+  MetricsReporter(const SearchMetrics &metrics, int intervalMs, SampleCallback sample);
+  ~MetricsReporter();
+
+  void stop();
+
+private:
+  void run();
+
+  const SearchMetrics &metrics;
+  int intervalMs;
+  SampleCallback sample;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping;
+  std::thread thread;
+};
+
+// Latest snapshot of the running search as JSON, for WebAssembly callers that poll
+// instead of receiving callbacks. Empty until a search publishes one
+void publishSearchMetrics(const MetricsSnapshot &snapshot);
+std::string latestSearchMetricsJson();
@@ -20,24 +20,42 @@ int calculateFinalPrice(
     }
   }
 
-  // Determine base price from product name (in integer cents)
-  // Default to Weed pricing (35.00)
-  int basePriceInCents = 3500; // $35.00 by default
+  // Formula: basePrice * (1.0 + totalMultiplier/100)
+  int basePriceInCents = defaultBasePriceCents(productName);
+  return basePriceInCents + (basePriceInCents * totalMultiplier) / 100;
+}
 
-  // Check for specific product types
+int defaultBasePriceCents(const std::string &productName)
+{
+  // Check for specific product types, otherwise use Weed pricing ($35.00)
   if (productName.find("Meth") != std::string::npos)
-    basePriceInCents = 7000; // $70.00
-  else if (productName.find("Cocaine") != std::string::npos)
-    basePriceInCents = 15000; // $150.00
-  // Otherwise keep default Weed price
+    return 7000; // $70.00
+  if (productName.find("Cocaine") != std::string::npos)
+    return 15000; // $150.00
+  return 3500;
+}
 
-  // Calculate final price using integer arithmetic
-  // Formula: basePrice * (1.0 + totalMultiplier/100)
-  // = (basePrice * 100 + basePrice * totalMultiplier) / 100
-  int finalPriceInCents = basePriceInCents + (basePriceInCents * totalMultiplier) / 100;
+int productBasePriceCents(const Product &product)
+{
+  return product.basePriceCents > 0 ? product.basePriceCents : defaultBasePriceCents(product.name);
+}
 
-  // Return the price in cents directly, no rounding needed
-  return finalPriceInCents;
+PricingContext::PricingContext(
+    const Product &product,
+    const EffectRegistry &registry,
+    const std::unordered_map<std::string, int> &effectMultipliers)
+    : basePriceCents(productBasePriceCents(product)),
+      multiplierTable(MAX_EFFECT_IDS, 0)
+{
+  // Effects without a multiplier keep 0
+  for (const auto &pair : effectMultipliers)
+  {
+    int id = registry.find(pair.first);
+    if (id >= 0)
+    {
+      multiplierTable[id] = pair.second;
+    }
+  }
 }
 
 // Calculate the total cost of a mix in cents
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "types.h"
+#include "effects.h"
+#include "rule_kernel.h"
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -11,7 +13,39 @@ int calculateFinalPrice(
     const std::vector<std::string> &currentEffects,
     const std::unordered_map<std::string, int> &effectMultipliers);
 
+// Base price (in cents) of products that don't state one, derived from the product name
+int defaultBasePriceCents(const std::string &productName);
+
+// Base price (in cents) of a product: the one it states, or the default for its name
+int productBasePriceCents(const Product &product);
+
 // Calculate the total cost of a mix (in cents)
 int calculateFinalCost(
     const MixState &mixState,
     const std::vector<Substance> &substances);
+
+// Everything needed to price an effect set, resolved once per search: scoring a mix is
+// a multiplier sum over a dense table and one multiply, with no string work
+struct PricingContext
+{
+  int basePriceCents;
+  std::vector<int> multiplierTable; // Multiplier (x100) per effect ID, MAX_EFFECT_IDS entries
+
+  PricingContext(
+      const Product &product,
+      const EffectRegistry &registry,
+      const std::unordered_map<std::string, int> &effectMultipliers);
+
+  // Selling price (in cents) for a total effect multiplier (x100). Never decreases as the
+  // multiplier grows
+  int priceFromMultiplier(int totalMultiplier) const
+  {
+    return basePriceCents + (basePriceCents * totalMultiplier) / 100;
+  }
+
+  // Selling price (in cents) of an effect set
+  int sellPrice(EffectMask effects) const
+  {
+    return priceFromMultiplier(sumEffectMultipliers(effects, multiplierTable.data()));
+  }
+};
@@ -0,0 +1,90 @@
+#include "profit_bound.h"
+#include "pricing.h"
+#include "metrics.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+ProfitBound::ProfitBound(
+    const std::vector<Substance> &substances,
+    const CompiledEffects &compiled,
+    const PricingContext &pricing,
+    int maxDepth)
+    : pricing(pricing),
+      maxStepGain(0),
+      maxStepGrowth(0),
+      minSubstanceCost(std::numeric_limits<int>::max()),
+      subtreeSizes(mixCountsByDepth(substances.size(), maxDepth))
+{
+  const std::vector<int> &multiplierTable = pricing.multiplierTable;
+  auto multiplierOf = [&](EffectMask bit)
+  {
+    return bit ? multiplierTable[countTrailingZeros(bit)] : 0;
+  };
+
+  // Each rule changes at most one effect per step, so a substance can gain at most the sum of
+  // its rules' positive deltas plus its default effect. Chained replacements telescope
+  for (const CompiledSubstance &substance : compiled.substances)
+  {
+    int gain = std::max(0, multiplierOf(substance.defaultEffectBit));
+    int growth = substance.defaultEffectBit ? 1 : 0;
+
+    for (const CompiledRule &rule : substance.rules)
+    {
+      if (rule.action == RULE_REPLACE)
+      {
+        gain += std::max(0, multiplierOf(rule.withBit) - multiplierOf(rule.targetBit));
+      }
+      else if (rule.action == RULE_ADD)
+      {
+        gain += std::max(0, multiplierOf(rule.targetBit));
+        growth++;
+      }
+    }
+
+    maxStepGain = std::max(maxStepGain, gain);
+    maxStepGrowth = std::max(maxStepGrowth, growth);
+  }
+
+  // No mix can hold more than every known effect
+  std::vector<int> positive;
+  for (size_t id = 0; id < compiled.registry.size(); ++id)
+  {
+    if (multiplierTable[id] > 0)
+    {
+      positive.push_back(multiplierTable[id]);
+    }
+  }
+  std::sort(positive.begin(), positive.end(), std::greater<int>());
+
+  topPositiveSums.assign(compiled.registry.size() + 1, 0);
+  for (size_t n = 1; n < topPositiveSums.size(); ++n)
+  {
+    topPositiveSums[n] = topPositiveSums[n - 1] + (n <= positive.size() ? positive[n - 1] : 0);
+  }
+
+  for (const Substance &substance : substances)
+  {
+    minSubstanceCost = std::min(minSubstanceCost, substance.cost);
+  }
+  if (substances.empty())
+  {
+    minSubstanceCost = 0;
+  }
+}
+
+int ProfitBound::maxExtensionProfit(EffectMask effects, int costCents, int remainingDepth) const
+{
+  int currentMultiplier = sumEffectMultipliers(effects, pricing.multiplierTable.data());
+
+  // Bound the final multiplier both by per-step gains and by the best effects that could fit
+  int64_t stepBound = static_cast<int64_t>(currentMultiplier) + static_cast<int64_t>(remainingDepth) * maxStepGain;
+  size_t maxEffects = std::min(topPositiveSums.size() - 1,
+                               static_cast<size_t>(countEffects(effects) + remainingDepth * maxStepGrowth));
+  int multiplierBound = static_cast<int>(std::min<int64_t>(stepBound, topPositiveSums[maxEffects]));
+
+  // Every extension adds at least one substance
+  int minAdditionalCost = minSubstanceCost >= 0 ? minSubstanceCost : minSubstanceCost * remainingDepth;
+
+  return pricing.priceFromMultiplier(multiplierBound) - (costCents + minAdditionalCost);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "types.h"
+#include "effects.h"
+#include "pricing.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Admissible upper bound on the profit of any mix extending a given one, used for
+// branch-and-bound pruning. The bound never underestimates, so pruning subtrees whose
+// bound can't beat the best mix found so far leaves the result unchanged
+class ProfitBound
+{
+public:
+  ProfitBound(
+      const std::vector<Substance> &substances,
+      const CompiledEffects &compiled,
+      const PricingContext &pricing,
+      int maxDepth);
+
+  // Upper bound on the profit of mixes that add 1..remainingDepth substances to a mix
+  // with the given effects and cost
+  int maxExtensionProfit(EffectMask effects, int costCents, int remainingDepth) const;
+
+  // Number of mixes in the subtree below a node with remainingDepth levels left
+  int64_t subtreeSize(int remainingDepth) const { return subtreeSizes[remainingDepth]; }
+
+private:
+  const PricingContext &pricing;
+
+  // Most any single substance can raise the total multiplier, or the effect count
+  int maxStepGain;
+  int maxStepGrowth;
+
+  // Sum of the N largest positive multipliers, indexed by N
+  std::vector<int> topPositiveSums;
+
+  // Cheapest substance, for the minimum cost of going one level deeper
+  int minSubstanceCost;
+
+  std::vector<int64_t> subtreeSizes;
+};
@@ -1,6 +1,20 @@
 #include "reporter.h"
 
 #ifdef __EMSCRIPTEN__
+// Token of the running search. The module runs one search at a time
+static CancellationToken g_jsCancellation;
+
+CancellationToken *startCancellableSearch()
+{
+  g_jsCancellation.reset();
+  return &g_jsCancellation;
+}
+
+void cancelSearch()
+{
+  g_jsCancellation.cancel();
+}
+
 // Unified JavaScript-compatible progress reporting function
 void reportProgressToJS(int depth, int64_t processed, int64_t total)
 {
@@ -91,4 +105,27 @@ void reportBestMixFoundToJS(const MixState &bestMix,
     global.call<void>("postMessage", message);
   }
 }
+
+// Report one depth's result of an anytime search to JavaScript
+void reportDepthResultToJS(int depth, const JsBestMixResult &result, bool complete)
+{
+  emscripten::val resultObj = emscripten::val::object();
+  resultObj.set("depth", depth);
+  resultObj.set("complete", complete);
+  resultObj.set("mixArray", result.mixArray);
+  resultObj.set("profit", result.profit);
+  resultObj.set("sellPrice", result.sellPrice);
+  resultObj.set("cost", result.cost);
+
+  emscripten::val global = emscripten::val::global("self");
+  if (global.hasOwnProperty("reportDepthResult"))
+  {
+    global.call<void>("reportDepthResult", resultObj);
+  }
+  else if (global.hasOwnProperty("postMessage"))
+  {
+    resultObj.set("type", "depthResult");
+    global.call<void>("postMessage", resultObj);
+  }
+}
 #endif
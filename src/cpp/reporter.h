@@ -14,4 +14,15 @@ void reportBestMixFoundToJS(const MixState &bestMix,
 // This is used by both BFS and DFS algorithms
 void reportProgressToJS(int depth, int64_t processed, int64_t total);
 
+// Report one depth's result of an anytime search to JavaScript
+void reportDepthResultToJS(int depth, const JsBestMixResult &result, bool complete);
+
+// Reset the token that cancelSearch() cancels and return it for a starting search's
+// options.cancellation
+CancellationToken *startCancellableSearch();
+
+// Cancel the running search, which then returns its best mix so far. Called from
+// JavaScript, typically from the progress callback once the page asked to stop
+void cancelSearch();
+
 #endif
\ No newline at end of file
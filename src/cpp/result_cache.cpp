@@ -0,0 +1,276 @@
+#include "result_cache.h"
+#include "pricing.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// 64-bit FNV-1a, fed length-prefixed fields so adjacent strings can't run together
+class ContentHasher
+{
+public:
+  ContentHasher() : hash(0xcbf29ce484222325ULL) {}
+
+  void add(const std::string &value)
+  {
+    add(static_cast<int64_t>(value.size()));
+    addBytes(value.data(), value.size());
+  }
+
+  void add(int64_t value)
+  {
+    addBytes(&value, sizeof(value));
+  }
+
+  void add(const std::vector<std::string> &values)
+  {
+    add(static_cast<int64_t>(values.size()));
+    for (const std::string &value : values)
+    {
+      add(value);
+    }
+  }
+
+  uint64_t value() const { return hash; }
+
+private:
+  void addBytes(const void *data, size_t size)
+  {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+      hash ^= bytes[i];
+      hash *= 0x100000001b3ULL;
+    }
+  }
+
+  uint64_t hash;
+};
+
+uint64_t computeResultCacheKey(
+    const Product &product,
+    const std::vector<Substance> &substances,
+    const std::unordered_map<std::string, int> &effectMultipliers,
+    const SearchConstraints &constraints)
+{
+  ContentHasher hasher;
+  hasher.add(product.name);
+  hasher.add(product.initialEffect);
+  // The resolved base price, so a stated price equal to the name default shares entries
+  hasher.add(static_cast<int64_t>(productBasePriceCents(product)));
+
+  // Substance order matters: it decides which of several equally good mixes is reported
+  hasher.add(static_cast<int64_t>(substances.size()));
+  for (const Substance &substance : substances)
+  {
+    hasher.add(substance.name);
+    hasher.add(static_cast<int64_t>(substance.cost));
+    hasher.add(substance.defaultEffect);
+    hasher.add(static_cast<int64_t>(substance.rules.size()));
+    for (const SubstanceRule &rule : substance.rules)
+    {
+      hasher.add(rule.type);
+      hasher.add(rule.condition);
+      hasher.add(rule.ifNotPresent);
+      hasher.add(rule.target);
+      hasher.add(rule.withEffect);
+    }
+  }
+
+  // Multipliers come from an unordered map, so hash them in name order
+  std::vector<std::pair<std::string, int>> multipliers(effectMultipliers.begin(), effectMultipliers.end());
+  std::sort(multipliers.begin(), multipliers.end());
+  hasher.add(static_cast<int64_t>(multipliers.size()));
+  for (const auto &multiplier : multipliers)
+  {
+    hasher.add(multiplier.first);
+    hasher.add(static_cast<int64_t>(multiplier.second));
+  }
+
+  // Unconstrained searches keep the keys they had before constraints existed
+  if (constraints.any())
+  {
+    hasher.add(static_cast<int64_t>(constraints.maxCostCents));
+    hasher.add(constraints.requiredEffects);
+    hasher.add(constraints.forbiddenEffects);
+    hasher.add(constraints.allowedSubstances);
+    hasher.add(static_cast<int64_t>(constraints.exactLength));
+  }
+
+  return hasher.value();
+}
+
+bool seedFromCachedResult(const CachedResult &cached, const std::vector<Substance> &substances, SearchSeed &seed)
+{
+  seed = SearchSeed();
+  for (const std::string &name : cached.mix)
+  {
+    auto it = std::find_if(substances.begin(), substances.end(),
+                           [&](const Substance &substance)
+                           { return substance.name == name; });
+    if (it == substances.end() || seed.mix.substanceIndices.size() >= MAX_MIX_LENGTH)
+      return false;
+    seed.mix.addSubstance(static_cast<size_t>(it - substances.begin()));
+  }
+  seed.profitCents = cached.profitCents;
+  seed.sellPriceCents = cached.sellPriceCents;
+  seed.costCents = cached.costCents;
+  seed.valid = true;
+  return true;
+}
+
+JsBestMixResult toBestMixResult(const CachedResult &cached)
+{
+  JsBestMixResult result;
+  result.mixArray = cached.mix;
+  result.profitCents = cached.profitCents;
+  result.sellPriceCents = cached.sellPriceCents;
+  result.costCents = cached.costCents;
+  result.profit = cached.profitCents / 100.0;
+  result.sellPrice = cached.sellPriceCents / 100.0;
+  result.cost = cached.costCents / 100.0;
+  result.topMixes.push_back({cached.mix, cached.profitCents, cached.sellPriceCents, cached.costCents, 0});
+  return result;
+}
+
+ResultCache::ResultCache(const std::string &path, size_t maxEntries)
+    : path(path), maxEntries(std::max<size_t>(maxEntries, 1)), orderChanged(false)
+{
+  load();
+}
+
+ResultCache::~ResultCache()
+{
+  if (orderChanged)
+    save();
+}
+
+bool ResultCache::find(uint64_t key, int depth, CachedResult &result)
+{
+  for (size_t i = 0; i < entries.size(); ++i)
+  {
+    if (entries[i].key == key && entries[i].result.depth == depth)
+    {
+      result = entries[i].result;
+
+      // Move the entry to the most recently used end
+      Entry entry = entries[i];
+      entries.erase(entries.begin() + i);
+      entries.push_back(entry);
+      orderChanged = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ResultCache::findShallower(uint64_t key, int depth, CachedResult &result) const
+{
+  bool found = false;
+  for (const Entry &entry : entries)
+  {
+    if (entry.key == key && entry.result.depth < depth && (!found || entry.result.depth > result.depth))
+    {
+      result = entry.result;
+      found = true;
+    }
+  }
+  return found;
+}
+
+void ResultCache::store(uint64_t key, const CachedResult &result)
+{
+  entries.erase(std::remove_if(entries.begin(), entries.end(),
+                               [&](const Entry &entry)
+                               { return entry.key == key && entry.result.depth == result.depth; }),
+                entries.end());
+  entries.push_back({key, result});
+
+  if (entries.size() > maxEntries)
+  {
+    entries.erase(entries.begin(), entries.begin() + (entries.size() - maxEntries));
+  }
+  save();
+}
+
+// One entry per line: key, depth, profit, sell price, cost, then the mix names, tab-separated
+void ResultCache::load()
+{
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line))
+  {
+    std::istringstream fields(line);
+    std::string field;
+    std::vector<std::string> parts;
+    while (std::getline(fields, field, '\t'))
+    {
+      parts.push_back(field);
+    }
+    if (parts.size() < 5)
+      continue;
+
+    try
+    {
+      Entry entry;
+      entry.key = std::stoull(parts[0], nullptr, 16);
+      entry.result.depth = std::stoi(parts[1]);
+      entry.result.profitCents = std::stoi(parts[2]);
+      entry.result.sellPriceCents = std::stoi(parts[3]);
+      entry.result.costCents = std::stoi(parts[4]);
+      entry.result.mix.assign(parts.begin() + 5, parts.end());
+      entries.push_back(entry);
+    }
+    catch (const std::exception &)
+    {
+      // Skip corrupt lines rather than discarding the whole cache
+    }
+  }
+
+  if (entries.size() > maxEntries)
+  {
+    entries.erase(entries.begin(), entries.begin() + (entries.size() - maxEntries));
+  }
+}
+
+void ResultCache::save()
+{
+  // Write to a temporary file of this process first, so readers never see a half-written
+  // cache and concurrent runs never write into each other's file
+#ifdef _WIN32
+  std::string tempPath = path + "." + std::to_string(_getpid()) + ".tmp";
+#else
+  std::string tempPath = path + "." + std::to_string(getpid()) + ".tmp";
+#endif
+  orderChanged = false;
+  {
+    std::ofstream file(tempPath, std::ios::trunc);
+    if (!file)
+      return;
+
+    for (const Entry &entry : entries)
+    {
+      char key[17];
+      std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(entry.key));
+      file << key << '\t' << entry.result.depth << '\t' << entry.result.profitCents << '\t'
+           << entry.result.sellPriceCents << '\t' << entry.result.costCents;
+      for (const std::string &name : entry.result.mix)
+      {
+        file << '\t' << name;
+      }
+      file << '\n';
+    }
+  }
+
+#ifdef _WIN32
+  std::remove(path.c_str()); // Windows won't rename over an existing file
+#endif
+  if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+    std::remove(tempPath.c_str());
+}
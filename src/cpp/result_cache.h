@@ -0,0 +1,76 @@
+#pragma once
+
+#include "types.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// Default location and size of the on-disk result cache used by the native calculator
+const char *const DEFAULT_RESULT_CACHE_FILE = ".bfs_result_cache.tsv";
+const size_t DEFAULT_RESULT_CACHE_ENTRIES = 256;
+
+// A best mix stored in the result cache
+struct CachedResult
+{
+  int depth;
+  std::vector<std::string> mix;
+  int profitCents;
+  int sellPriceCents;
+  int costCents;
+};
+
+// Content hash of everything that determines a search result apart from the depth:
+// the product, the substances with their rules, the effect multipliers and the constraints
+uint64_t computeResultCacheKey(
+    const Product &product,
+    const std::vector<Substance> &substances,
+    const std::unordered_map<std::string, int> &effectMultipliers,
+    const SearchConstraints &constraints = SearchConstraints());
+
+// Turn a cached result into a search seed by mapping its substance names back to indices.
+// Returns false if the mix uses a substance that isn't in the list
+bool seedFromCachedResult(const CachedResult &cached, const std::vector<Substance> &substances, SearchSeed &seed);
+
+// Build the calculator result for a cached entry
+JsBestMixResult toBestMixResult(const CachedResult &cached);
+
+// Small LRU cache of search results persisted to a tab-separated file.
+// The file is rewritten when a result is stored, and on destruction when lookups changed
+// the LRU order. Each process writes its own temporary file and renames it into place,
+// so the file stays readable after a crash and concurrent runs never see a partial one
+class ResultCache
+{
+public:
+  ResultCache(const std::string &path, size_t maxEntries = DEFAULT_RESULT_CACHE_ENTRIES);
+  ~ResultCache();
+
+  ResultCache(const ResultCache &) = delete;
+  ResultCache &operator=(const ResultCache &) = delete;
+
+  // Look up the result for a key at exactly this depth, marking it recently used
+  bool find(uint64_t key, int depth, CachedResult &result);
+
+  // Look up the deepest cached result for a key below this depth. Its mix is still a
+  // valid mix at the deeper depth, so it's a lower bound on the best profit there
+  bool findShallower(uint64_t key, int depth, CachedResult &result) const;
+
+  // Add or replace the result for (key, result.depth), evicting the least recently used
+  // entries beyond the size limit
+  void store(uint64_t key, const CachedResult &result);
+
+private:
+  struct Entry
+  {
+    uint64_t key;
+    CachedResult result;
+  };
+
+  void load();
+  void save();
+
+  std::string path;
+  size_t maxEntries;
+  std::vector<Entry> entries; // Least recently used first
+  bool orderChanged;          // Lookups reordered the entries since the last save
+};
@@ -0,0 +1,223 @@
+#include "rule_kernel.h"
+
+// The kernels are picked at compile time: native builds use -march=native and the
+// WebAssembly build is compiled with -msimd128, so the widest available unit is known
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+RuleKernel::RuleKernel(const CompiledEffects &compiled)
+{
+  for (size_t s = 0; s < compiled.substances.size(); ++s)
+  {
+    const CompiledSubstance &substance = compiled.substances[s];
+    defaultBits.push_back(substance.defaultEffectBit);
+    ruleStarts.push_back(static_cast<uint32_t>(conditionMasks.size()));
+
+    for (const CompiledRule &rule : substance.rules)
+    {
+      // Rules that can't change the effect set are dropped
+      if (rule.action == RULE_NONE)
+        continue;
+
+      conditionMasks.push_back(rule.conditionMask);
+      ifNotPresentMasks.push_back(rule.ifNotPresentMask);
+      targetBits.push_back(rule.targetBit);
+      withBits.push_back(rule.withBit);
+      actions.push_back(rule.action);
+      ruleSubstances.push_back(static_cast<uint32_t>(s));
+    }
+  }
+
+  ruleStarts.push_back(static_cast<uint32_t>(conditionMasks.size()));
+
+  // Pad to whole blocks with rules that need every effect present and none present
+  while (conditionMasks.size() % RULE_BLOCK != 0)
+  {
+    conditionMasks.push_back(~EffectMask(0));
+    ifNotPresentMasks.push_back(~EffectMask(0));
+    targetBits.push_back(0);
+    withBits.push_back(0);
+    actions.push_back(RULE_NONE);
+    ruleSubstances.push_back(0);
+  }
+}
+
+const char *RuleKernel::instructionSet()
+{
+#if defined(__AVX2__)
+  return "AVX2";
+#elif defined(__SSE4_1__)
+  return "SSE4.1";
+#elif defined(__wasm_simd128__)
+  return "WASM SIMD128";
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  return "NEON";
+#else
+  return "scalar";
+#endif
+}
+
+// A rule fires when all of its condition effects and none of its excluded effects are present
+uint32_t RuleKernel::firedRules(EffectMask parent, size_t first) const
+{
+  const EffectMask *conditions = &conditionMasks[first];
+  const EffectMask *exclusions = &ifNotPresentMasks[first];
+  uint32_t fired = 0;
+
+#if defined(__AVX2__)
+  const __m256i p = _mm256_set1_epi64x(static_cast<long long>(parent));
+  const __m256i zero = _mm256_setzero_si256();
+  for (size_t i = 0; i < RULE_BLOCK; i += 4)
+  {
+    __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(conditions + i));
+    __m256i n = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(exclusions + i));
+    __m256i hasAll = _mm256_cmpeq_epi64(_mm256_and_si256(p, c), c);
+    __m256i hasNone = _mm256_cmpeq_epi64(_mm256_and_si256(p, n), zero);
+    int lanes = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_and_si256(hasAll, hasNone)));
+    fired |= static_cast<uint32_t>(lanes) << i;
+  }
+#elif defined(__SSE4_1__)
+  const __m128i p = _mm_set1_epi64x(static_cast<long long>(parent));
+  const __m128i zero = _mm_setzero_si128();
+  for (size_t i = 0; i < RULE_BLOCK; i += 2)
+  {
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(conditions + i));
+    __m128i n = _mm_loadu_si128(reinterpret_cast<const __m128i *>(exclusions + i));
+    __m128i hasAll = _mm_cmpeq_epi64(_mm_and_si128(p, c), c);
+    __m128i hasNone = _mm_cmpeq_epi64(_mm_and_si128(p, n), zero);
+    int lanes = _mm_movemask_pd(_mm_castsi128_pd(_mm_and_si128(hasAll, hasNone)));
+    fired |= static_cast<uint32_t>(lanes) << i;
+  }
+#elif defined(__wasm_simd128__)
+  const v128_t p = wasm_i64x2_splat(static_cast<int64_t>(parent));
+  const v128_t zero = wasm_i64x2_splat(0);
+  for (size_t i = 0; i < RULE_BLOCK; i += 2)
+  {
+    v128_t c = wasm_v128_load(conditions + i);
+    v128_t n = wasm_v128_load(exclusions + i);
+    v128_t hasAll = wasm_i64x2_eq(wasm_v128_and(p, c), c);
+    v128_t hasNone = wasm_i64x2_eq(wasm_v128_and(p, n), zero);
+    fired |= static_cast<uint32_t>(wasm_i64x2_bitmask(wasm_v128_and(hasAll, hasNone))) << i;
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const uint64x2_t p = vdupq_n_u64(parent);
+  for (size_t i = 0; i < RULE_BLOCK; i += 2)
+  {
+    uint64x2_t c = vld1q_u64(conditions + i);
+    uint64x2_t n = vld1q_u64(exclusions + i);
+    uint64x2_t hasAll = vceqq_u64(vandq_u64(p, c), c);
+    uint64x2_t hasNone = vceqzq_u64(vandq_u64(p, n));
+    uint64x2_t lanes = vandq_u64(hasAll, hasNone);
+    fired |= static_cast<uint32_t>((vgetq_lane_u64(lanes, 0) & 1) | ((vgetq_lane_u64(lanes, 1) & 1) << 1)) << i;
+  }
+#else
+  for (size_t i = 0; i < RULE_BLOCK; ++i)
+  {
+    if ((parent & conditions[i]) == conditions[i] && (parent & exclusions[i]) == 0)
+    {
+      fired |= uint32_t(1) << i;
+    }
+  }
+#endif
+
+  return fired;
+}
+
+void RuleKernel::expand(EffectMask parent, int recipeLength, EffectMask *children) const
+{
+  const size_t substanceCount = defaultBits.size();
+  for (size_t s = 0; s < substanceCount; ++s)
+  {
+    children[s] = parent;
+  }
+
+  // Rules are visited in their original order, so each substance sees its own rules in
+  // sequence exactly as applySubstanceRulesMask applies them
+  for (size_t first = 0; first < conditionMasks.size(); first += RULE_BLOCK)
+  {
+    uint32_t fired = firedRules(parent, first);
+    while (fired)
+    {
+      size_t rule = first + countTrailingZeros(fired);
+      fired &= fired - 1;
+
+      applyRule(children[ruleSubstances[rule]], rule);
+    }
+  }
+
+  // Ensure default effects are present
+  if (recipeLength < 9)
+  {
+    for (size_t s = 0; s < substanceCount; ++s)
+    {
+      children[s] |= defaultBits[s];
+    }
+  }
+}
+
+int sumEffectMultipliers(EffectMask mask, const int *multiplierTable)
+{
+#if defined(__AVX2__)
+  const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+  __m256i total = _mm256_setzero_si256();
+  for (int i = 0; i < MAX_EFFECT_IDS / 8; ++i)
+  {
+    __m256i bits = _mm256_set1_epi32(static_cast<int>((mask >> (i * 8)) & 0xff));
+    __m256i present = _mm256_cmpeq_epi32(_mm256_and_si256(bits, laneBits), laneBits);
+    __m256i multipliers = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(multiplierTable + i * 8));
+    total = _mm256_add_epi32(total, _mm256_and_si256(present, multipliers));
+  }
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(total), _mm256_extracti128_si256(total, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+  return _mm_cvtsi128_si32(sum);
+#elif defined(__SSE4_1__)
+  const __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+  __m128i total = _mm_setzero_si128();
+  for (int i = 0; i < MAX_EFFECT_IDS / 4; ++i)
+  {
+    __m128i bits = _mm_set1_epi32(static_cast<int>((mask >> (i * 4)) & 0xf));
+    __m128i present = _mm_cmpeq_epi32(_mm_and_si128(bits, laneBits), laneBits);
+    __m128i multipliers = _mm_loadu_si128(reinterpret_cast<const __m128i *>(multiplierTable + i * 4));
+    total = _mm_add_epi32(total, _mm_and_si128(present, multipliers));
+  }
+  total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0x4e));
+  total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0xb1));
+  return _mm_cvtsi128_si32(total);
+#elif defined(__wasm_simd128__)
+  const v128_t laneBits = wasm_i32x4_make(1, 2, 4, 8);
+  v128_t total = wasm_i32x4_splat(0);
+  for (int i = 0; i < MAX_EFFECT_IDS / 4; ++i)
+  {
+    v128_t bits = wasm_i32x4_splat(static_cast<int32_t>((mask >> (i * 4)) & 0xf));
+    v128_t present = wasm_i32x4_eq(wasm_v128_and(bits, laneBits), laneBits);
+    total = wasm_i32x4_add(total, wasm_v128_and(present, wasm_v128_load(multiplierTable + i * 4)));
+  }
+  return wasm_i32x4_extract_lane(total, 0) + wasm_i32x4_extract_lane(total, 1) +
+         wasm_i32x4_extract_lane(total, 2) + wasm_i32x4_extract_lane(total, 3);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const uint32x4_t laneBits = {1, 2, 4, 8};
+  int32x4_t total = vdupq_n_s32(0);
+  for (int i = 0; i < MAX_EFFECT_IDS / 4; ++i)
+  {
+    uint32x4_t present = vtstq_u32(vdupq_n_u32(static_cast<uint32_t>((mask >> (i * 4)) & 0xf)), laneBits);
+    total = vaddq_s32(total, vandq_s32(vreinterpretq_s32_u32(present), vld1q_s32(multiplierTable + i * 4)));
+  }
+  return vaddvq_s32(total);
+#else
+  int total = 0;
+  while (mask)
+  {
+    total += multiplierTable[countTrailingZeros(mask)];
+    mask &= mask - 1;
+  }
+  return total;
+#endif
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "effects.h"
+#include <vector>
+#include <cstdint>
+
+// All substances' compiled rules flattened into parallel arrays, so one parent effect set
+// can be tested against a block of rule conditions with a few SIMD compares instead of
+// one rule at a time. Used to expand every child of a mix in one call. Each substance's
+// rules are a contiguous range of the arrays, so a single step reads a few cache lines
+// instead of chasing a per-substance rule vector
+class RuleKernel
+{
+public:
+  // Rules whose conditions are tested per step; the arrays are padded to a multiple of this
+  static const size_t RULE_BLOCK = 8;
+
+  explicit RuleKernel(const CompiledEffects &compiled);
+
+  // Effects of adding each substance to `parent` at the given recipe length, written to
+  // children[0 .. substanceCount()). Same result as applySubstanceRulesMask per substance
+  void expand(EffectMask parent, int recipeLength, EffectMask *children) const;
+
+  // Effects of adding one substance to `parent` at the given recipe length. Same result
+  // as applySubstanceRulesMask
+  EffectMask apply(EffectMask parent, size_t substance, int recipeLength) const
+  {
+    EffectMask effects = parent;
+    for (uint32_t rule = ruleStarts[substance]; rule < ruleStarts[substance + 1]; ++rule)
+    {
+      // Conditions and exclusions are always tested against the original effects
+      if ((parent & conditionMasks[rule]) == conditionMasks[rule] && (parent & ifNotPresentMasks[rule]) == 0)
+      {
+        applyRule(effects, rule);
+      }
+    }
+
+    if (recipeLength < 9)
+    {
+      effects |= defaultBits[substance];
+    }
+    return effects;
+  }
+
+  size_t substanceCount() const { return defaultBits.size(); }
+
+  // Instruction set the condition tests were compiled for
+  static const char *instructionSet();
+
+private:
+  // Bit i is set when rule `first + i` fires for the parent, for one block of rules
+  uint32_t firedRules(EffectMask parent, size_t first) const;
+
+  // Apply the action of a rule that fired
+  void applyRule(EffectMask &effects, size_t rule) const
+  {
+    if (actions[rule] == RULE_REPLACE)
+    {
+      if ((effects & targetBits[rule]) && !(effects & withBits[rule]))
+      {
+        effects = (effects & ~targetBits[rule]) | withBits[rule];
+      }
+    }
+    else
+    {
+      effects |= targetBits[rule];
+    }
+  }
+
+  // Rule conditions, padded with rules that can never fire
+  std::vector<EffectMask> conditionMasks;
+  std::vector<EffectMask> ifNotPresentMasks;
+
+  // Rule actions and the substance each rule belongs to
+  std::vector<EffectMask> targetBits;
+  std::vector<EffectMask> withBits;
+  std::vector<RuleAction> actions;
+  std::vector<uint32_t> ruleSubstances;
+
+  // Substance s owns rules [ruleStarts[s], ruleStarts[s + 1])
+  std::vector<uint32_t> ruleStarts;
+
+  std::vector<EffectMask> defaultBits;
+};
+
+// Sum of the multipliers of the effects in a mask. `multiplierTable` holds MAX_EFFECT_IDS
+// entries indexed by effect ID; the sum is taken over all slots with lane masks, which
+// avoids the unpredictable branch of a loop over set bits
+int sumEffectMultipliers(EffectMask mask, const int *multiplierTable);
@@ -0,0 +1,484 @@
+#include "shard.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+// Ordered, so result fields keep the calculator's order
+using json = nlohmann::ordered_json;
+
+// Fields of a mix, shared by the result and its top list
+static json mixJson(const std::vector<std::string> &mixArray, int profitCents, int sellPriceCents, int costCents)
+{
+  return json{{"mixArray", mixArray},
+              {"profitCents", profitCents},
+              {"sellPriceCents", sellPriceCents},
+              {"costCents", costCents}};
+}
+
+std::string formatShardResultJson(const ShardResult &shard)
+{
+  const JsBestMixResult &result = shard.result;
+  json doc{{"shard", {{"index", shard.index}, {"count", shard.count}, {"maxDepth", shard.maxDepth},
+                      {"complete", shard.complete}}}};
+  doc.update(mixJson(result.mixArray, result.profitCents, result.sellPriceCents, result.costCents));
+
+  json topMixes = json::array();
+  for (const RankedMixResult &ranked : result.topMixes)
+  {
+    json entry = mixJson(ranked.mixArray, ranked.profitCents, ranked.sellPriceCents, ranked.costCents);
+
+    // Hex, since JSON readers may not keep 64-bit integers exact
+    char effects[19];
+    std::snprintf(effects, sizeof(effects), "%llx", static_cast<unsigned long long>(ranked.effects));
+    entry["effects"] = effects;
+    topMixes.push_back(entry);
+  }
+  doc["topMixes"] = topMixes;
+  doc["counters"] = {{"nodes", shard.nodes},
+                     {"prunedSubtrees", shard.prunedSubtrees},
+                     {"prunedNodes", shard.prunedNodes},
+                     {"dominatedSubtrees", shard.dominatedSubtrees}};
+  return doc.dump(2);
+}
+
+ShardResult parseShardResultJson(const std::string &shardJson)
+{
+  try
+  {
+    json doc = json::parse(shardJson);
+    const json &info = doc.at("shard");
+
+    ShardResult shard;
+    shard.index = info.at("index").get<int>();
+    shard.count = info.at("count").get<int>();
+    shard.maxDepth = info.value("maxDepth", 0);
+    shard.complete = info.value("complete", true);
+
+    JsBestMixResult &result = shard.result;
+    result.mixArray = doc.at("mixArray").get<std::vector<std::string>>();
+    result.profitCents = doc.at("profitCents").get<int>();
+    result.sellPriceCents = doc.at("sellPriceCents").get<int>();
+    result.costCents = doc.at("costCents").get<int>();
+    result.profit = result.profitCents / 100.0;
+    result.sellPrice = result.sellPriceCents / 100.0;
+    result.cost = result.costCents / 100.0;
+
+    for (const json &entry : doc.value("topMixes", json::array()))
+    {
+      result.topMixes.push_back({entry.at("mixArray").get<std::vector<std::string>>(),
+                                 entry.at("profitCents").get<int>(),
+                                 entry.at("sellPriceCents").get<int>(),
+                                 entry.at("costCents").get<int>(),
+                                 std::stoull(entry.value("effects", std::string("0")), nullptr, 16)});
+    }
+
+    const json counters = doc.value("counters", json::object());
+    shard.nodes = counters.value("nodes", int64_t(0));
+    shard.prunedSubtrees = counters.value("prunedSubtrees", int64_t(0));
+    shard.prunedNodes = counters.value("prunedNodes", int64_t(0));
+    shard.dominatedSubtrees = counters.value("dominatedSubtrees", int64_t(0));
+
+    if (shard.count < 1 || shard.index < 0 || shard.index >= shard.count)
+      throw std::runtime_error("invalid shard " + std::to_string(shard.index) + "/" + std::to_string(shard.count));
+    return shard;
+  }
+  catch (const std::runtime_error &)
+  {
+    throw;
+  }
+  catch (const std::exception &e)
+  {
+    throw std::runtime_error(std::string("Invalid shard result: ") + e.what());
+  }
+}
+
+JsBestMixResult mergeShardResults(const std::vector<ShardResult> &shards, size_t topK,
+                                  std::vector<std::string> &warnings)
+{
+  JsBestMixResult merged;
+  merged.profitCents = std::numeric_limits<int>::min();
+  merged.sellPriceCents = 0;
+  merged.costCents = 0;
+
+  int count = shards.empty() ? 0 : shards[0].count;
+  std::vector<int> seen(std::max(count, 0), 0);
+  for (const ShardResult &shard : shards)
+  {
+    if (shard.count != count)
+    {
+      warnings.push_back("shard " + std::to_string(shard.index) + " is one of " + std::to_string(shard.count) +
+                         " shards, not " + std::to_string(count));
+      continue;
+    }
+    if (seen[shard.index]++)
+      warnings.push_back("shard " + std::to_string(shard.index) + " was given more than once");
+    if (!shard.complete)
+      warnings.push_back("shard " + std::to_string(shard.index) + " didn't finish its search");
+    if (shard.maxDepth != shards[0].maxDepth)
+      warnings.push_back("shard " + std::to_string(shard.index) + " searched to depth " +
+                         std::to_string(shard.maxDepth) + ", not " + std::to_string(shards[0].maxDepth));
+
+    // A shard without a mix found nothing better than the others' bound
+    const JsBestMixResult &result = shard.result;
+    if (!result.mixArray.empty() && result.profitCents > merged.profitCents)
+    {
+      merged.mixArray = result.mixArray;
+      merged.profitCents = result.profitCents;
+      merged.sellPriceCents = result.sellPriceCents;
+      merged.costCents = result.costCents;
+    }
+
+    // Each effect set keeps its best mix of any shard
+    for (const RankedMixResult &ranked : result.topMixes)
+    {
+      auto same = std::find_if(merged.topMixes.begin(), merged.topMixes.end(), [&](const RankedMixResult &other)
+                               { return ranked.effects != 0 && other.effects == ranked.effects; });
+      if (same == merged.topMixes.end())
+        merged.topMixes.push_back(ranked);
+      else if (ranked.profitCents > same->profitCents)
+        *same = ranked;
+    }
+  }
+  for (int i = 0; i < count; ++i)
+  {
+    if (!seen[i])
+      warnings.push_back("shard " + std::to_string(i) + " of " + std::to_string(count) + " is missing");
+  }
+
+  if (merged.mixArray.empty())
+    merged.profitCents = 0;
+  merged.profit = merged.profitCents / 100.0;
+  merged.sellPrice = merged.sellPriceCents / 100.0;
+  merged.cost = merged.costCents / 100.0;
+
+  std::stable_sort(merged.topMixes.begin(), merged.topMixes.end(), [](const RankedMixResult &a, const RankedMixResult &b)
+                   { return a.profitCents > b.profitCents; });
+  if (merged.topMixes.size() > topK)
+    merged.topMixes.resize(topK);
+  return merged;
+}
+
+#ifndef _WIN32
+
+// Time between two checks of the hub's stop token
+static const int HUB_POLL_MS = 200;
+
+// Shortest time between two trades of a client with the hub
+static const int BOUND_EXCHANGE_INTERVAL_MS = 250;
+
+// Longest wait of a client for the hub's answer
+static const int BOUND_EXCHANGE_TIMEOUT_MS = 1000;
+
+// Bytes of a client's message: the search key, then its best profit
+static const int BOUND_MESSAGE_BYTES = 12;
+
+static void encodeProfit(int profitCents, unsigned char *bytes)
+{
+  uint32_t value = static_cast<uint32_t>(profitCents);
+  for (int i = 0; i < 4; ++i)
+  {
+    bytes[i] = static_cast<unsigned char>(value >> (8 * i));
+  }
+}
+
+static int decodeProfit(const unsigned char *bytes)
+{
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    value |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+  }
+  return static_cast<int32_t>(value);
+}
+
+static void encodeSearchKey(uint64_t key, unsigned char *bytes)
+{
+  for (int i = 0; i < 8; ++i)
+  {
+    bytes[i] = static_cast<unsigned char>(key >> (8 * i));
+  }
+}
+
+static uint64_t decodeSearchKey(const unsigned char *bytes)
+{
+  uint64_t key = 0;
+  for (int i = 0; i < 8; ++i)
+  {
+    key |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+  }
+  return key;
+}
+
+int runBoundHub(int port, const CancellationToken *stop)
+{
+  int listener = socket(AF_INET6, SOCK_STREAM, 0);
+  bool ipv6 = listener >= 0;
+  if (!ipv6)
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0)
+  {
+    std::cerr << "Error: Could not open a socket: " << std::strerror(errno) << std::endl;
+    return 1;
+  }
+
+  int yes = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+  int bound;
+  if (ipv6)
+  {
+    // Accept IPv4 clients as well
+    int no = 0;
+    setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, &no, sizeof(no));
+    sockaddr_in6 address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons(static_cast<uint16_t>(port));
+    bound = bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+  }
+  else
+  {
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    bound = bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+  }
+  if (bound < 0 || listen(listener, 64) < 0)
+  {
+    std::cerr << "Error: Could not listen on port " << port << ": " << std::strerror(errno) << std::endl;
+    close(listener);
+    return 1;
+  }
+  std::cout << "Bound hub listening on port " << port << std::endl;
+
+  // One poll set for the listener and every client; a client's partial message waits in
+  // its buffer until the rest arrives
+  struct Client
+  {
+    unsigned char message[BOUND_MESSAGE_BYTES];
+    int received;
+  };
+  std::vector<pollfd> sockets(1, pollfd{listener, POLLIN, 0});
+  std::vector<Client> clients(1);
+
+  // Best profit sent for each search key, so searches never prune with each other's bounds
+  std::unordered_map<uint64_t, int> bestProfitCents;
+
+  while (!(stop && stop->cancelled()))
+  {
+    if (poll(sockets.data(), sockets.size(), HUB_POLL_MS) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      std::cerr << "Error: Bound hub poll failed: " << std::strerror(errno) << std::endl;
+      break;
+    }
+
+    for (size_t i = sockets.size(); i-- > 1;)
+    {
+      if (!sockets[i].revents)
+        continue;
+
+      Client &client = clients[i];
+      ssize_t count = recv(sockets[i].fd, client.message + client.received, BOUND_MESSAGE_BYTES - client.received, 0);
+      bool open = count > 0;
+      if (open)
+      {
+        client.received += static_cast<int>(count);
+      }
+      if (open && client.received == BOUND_MESSAGE_BYTES)
+      {
+        client.received = 0;
+        uint64_t key = decodeSearchKey(client.message);
+        int profitCents = decodeProfit(client.message + 8);
+        auto best = bestProfitCents.emplace(key, std::numeric_limits<int>::min()).first;
+        if (profitCents > best->second)
+        {
+          best->second = profitCents;
+          char keyText[17];
+          std::snprintf(keyText, sizeof(keyText), "%016llx", static_cast<unsigned long long>(key));
+          std::cout << "Best bound so far for search " << keyText << ": " << profitCents / 100.0 << std::endl;
+        }
+        unsigned char reply[4];
+        encodeProfit(best->second, reply);
+        open = send(sockets[i].fd, reply, sizeof(reply), MSG_NOSIGNAL) == sizeof(reply);
+      }
+      if (!open)
+      {
+        close(sockets[i].fd);
+        sockets.erase(sockets.begin() + i);
+        clients.erase(clients.begin() + i);
+      }
+    }
+
+    if (sockets[0].revents & POLLIN)
+    {
+      int connection = accept(listener, nullptr, nullptr);
+      if (connection >= 0)
+      {
+        setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        sockets.push_back(pollfd{connection, POLLIN, 0});
+        clients.push_back(Client{{0}, 0});
+      }
+    }
+  }
+
+  for (const pollfd &socket : sockets)
+  {
+    close(socket.fd);
+  }
+  return 0;
+}
+
+// Connection of one search to the hub, shared by the copies of its BoundExchange
+struct BoundHubClient
+{
+  std::string host;
+  std::string port;
+  int connection;
+  uint64_t searchKey; // Search the best profit belongs to
+  int bestProfitCents;
+  std::chrono::steady_clock::time_point lastExchange;
+  std::mutex mutex;
+
+  BoundHubClient() : connection(-1), searchKey(0), bestProfitCents(std::numeric_limits<int>::min()) {}
+  ~BoundHubClient()
+  {
+    if (connection >= 0)
+      close(connection);
+  }
+
+  bool connect()
+  {
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0)
+      return false;
+
+    for (addrinfo *address = addresses; address && connection < 0; address = address->ai_next)
+    {
+      connection = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+      if (connection < 0)
+        continue;
+      if (::connect(connection, address->ai_addr, address->ai_addrlen) < 0)
+      {
+        close(connection);
+        connection = -1;
+      }
+    }
+    freeaddrinfo(addresses);
+    if (connection < 0)
+      return false;
+
+    int yes = 1;
+    setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    timeval timeout{BOUND_EXCHANGE_TIMEOUT_MS / 1000, (BOUND_EXCHANGE_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return true;
+  }
+
+  // Send the profit and read the hub's bound, dropping the connection on any failure so
+  // the next trade reconnects
+  bool trade(int profitCents)
+  {
+    if (connection < 0 && !connect())
+      return false;
+
+    unsigned char message[BOUND_MESSAGE_BYTES];
+    encodeSearchKey(searchKey, message);
+    encodeProfit(profitCents, message + 8);
+    bool ok = send(connection, message, sizeof(message), MSG_NOSIGNAL) == sizeof(message);
+    int received = 0;
+    while (ok && received < 4)
+    {
+      ssize_t count = recv(connection, message + received, 4 - received, 0);
+      ok = count > 0;
+      received += ok ? static_cast<int>(count) : 0;
+    }
+    if (!ok)
+    {
+      close(connection);
+      connection = -1;
+      return false;
+    }
+    bestProfitCents = std::max(bestProfitCents, decodeProfit(message));
+    return true;
+  }
+};
+
+BoundExchange connectBoundHub(const std::string &address)
+{
+  size_t colon = address.rfind(':');
+  if (colon == std::string::npos || colon == 0 || colon + 1 == address.size())
+    throw std::runtime_error("Bound hub address must be HOST:PORT, not " + address);
+
+  std::shared_ptr<BoundHubClient> client = std::make_shared<BoundHubClient>();
+  client->host = address.substr(0, colon);
+  client->port = address.substr(colon + 1);
+  if (client->host.size() > 2 && client->host.front() == '[' && client->host.back() == ']')
+    client->host = client->host.substr(1, client->host.size() - 2);
+
+  return [client](uint64_t searchKey, int profitCents)
+  {
+    std::lock_guard<std::mutex> lock(client->mutex);
+
+    // A bound heard of for another search says nothing about this one
+    bool newSearch = searchKey != client->searchKey;
+    if (newSearch)
+    {
+      client->searchKey = searchKey;
+      client->bestProfitCents = std::numeric_limits<int>::min();
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    bool improved = profitCents > client->bestProfitCents;
+    if (newSearch || improved || now - client->lastExchange >= std::chrono::milliseconds(BOUND_EXCHANGE_INTERVAL_MS))
+    {
+      client->lastExchange = now;
+      if (!client->trade(profitCents))
+        client->bestProfitCents = std::max(client->bestProfitCents, profitCents);
+    }
+    return std::max(client->bestProfitCents, profitCents);
+  };
+}
+
+#else
+
+int runBoundHub(int, const CancellationToken *)
+{
+  std::cerr << "Error: The bound hub isn't supported on this platform" << std::endl;
+  return 1;
+}
+
+BoundExchange connectBoundHub(const std::string &)
+{
+  throw std::runtime_error("Sharing the bound isn't supported on this platform");
+}
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "types.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Distributed DFS: every node runs the same search with --shard i/N and explores only
+// its shard of the prefix work units (see selectShardUnits). Each writes a partial result,
+// and --merge combines them into the result of the whole search.
+//
+// Shards may share their best profit through a bound hub, so each one prunes with the
+// best mix of all of them. The hub speaks TCP: a client sends the key of its search as a
+// u64 and its best profit in cents as an i32, both little-endian, and the hub answers
+// with the best profit it has been sent for that key. One hub can serve any number of
+// searches, one after another or at once, without their bounds mixing.
+
+// Partial result of one shard
+struct ShardResult
+{
+  int index;
+  int count;
+  int maxDepth;
+  bool complete; // False when a deadline or a cancel stopped the shard
+  JsBestMixResult result;
+
+  // Search counters of the shard (see dfs_algorithm.h)
+  int64_t nodes;
+  int64_t prunedSubtrees;
+  int64_t prunedNodes;
+  int64_t dominatedSubtrees;
+
+  ShardResult()
+      : index(0), count(1), maxDepth(0), complete(true), result(),
+        nodes(0), prunedSubtrees(0), prunedNodes(0), dominatedSubtrees(0) {}
+};
+
+// Format a shard's result as JSON. Top list entries keep their effect sets, so the merge
+// can tell entries of different shards with the same effects apart
+std::string formatShardResultJson(const ShardResult &shard);
+
+// Parse a shard result written by formatShardResultJson. Throws std::runtime_error when
+// the JSON isn't one
+ShardResult parseShardResultJson(const std::string &shardJson);
+
+// Combine the results of every shard of a search: the most profitable mix of any shard,
+// and the topK best mixes with distinct effect sets of all their top lists. Missing,
+// duplicate and incomplete shards are reported in warnings, since the result then may
+// not be the best one
+JsBestMixResult mergeShardResults(const std::vector<ShardResult> &shards, size_t topK,
+                                  std::vector<std::string> &warnings);
+
+// Serve a bound hub on a TCP port until stop is cancelled. Returns 0, or 1 when the port
+// can't be served
+int runBoundHub(int port, const CancellationToken *stop);
+
+// Bound exchange for SearchOptions::boundExchange that trades with the hub at host:port.
+// It talks to the hub at most every few hundred milliseconds and keeps the best bound it
+// has heard of for the search when the hub can't be reached, so a lost hub only costs
+// pruning
+BoundExchange connectBoundHub(const std::string &address);
@@ -0,0 +1,94 @@
+#include "shared_best.h"
+#include <algorithm>
+
+MixState SharedBestMix::Entry::toMixState() const
+{
+  MixState mix(length);
+  for (int i = 0; i < length; ++i)
+  {
+    mix.addSubstance(static_cast<size_t>(substanceIndices[i]));
+  }
+  return mix;
+}
+
+SharedBestMix::SharedBestMix(int workerCount, int initialProfitCents)
+    : word(pack(initialProfitCents, 0)), slots(new Slot[std::max(1, workerCount)])
+{
+  for (int i = 0; i < std::max(1, workerCount); ++i)
+  {
+    slots[i].sequence.store(0, std::memory_order_relaxed);
+    slots[i].length.store(0, std::memory_order_relaxed);
+  }
+}
+
+bool SharedBestMix::publish(int worker, const int *substanceIndices, int length,
+                            int profitCents, int sellPriceCents, int costCents)
+{
+  uint64_t current = word.load(std::memory_order_relaxed);
+  if (profitCents <= profitOf(current))
+    return false;
+
+  // Only this worker writes its slot, so a plain load of the sequence is enough
+  Slot &slot = slots[worker];
+  uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+  slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.length.store(length, std::memory_order_relaxed);
+  slot.profitCents.store(profitCents, std::memory_order_relaxed);
+  slot.sellPriceCents.store(sellPriceCents, std::memory_order_relaxed);
+  slot.costCents.store(costCents, std::memory_order_relaxed);
+  for (int i = 0; i < length; ++i)
+  {
+    slot.substanceIndices[i].store(substanceIndices[i], std::memory_order_relaxed);
+  }
+  slot.sequence.store(sequence + 2, std::memory_order_release);
+
+  // Raise the word unless another worker got further in the meantime. A reader may see the
+  // new slot before the word names it, which only ever shows a better mix than the word's
+  const uint64_t desired = pack(profitCents, static_cast<uint32_t>(worker) + 1);
+  while (profitCents > profitOf(current))
+  {
+    if (word.compare_exchange_weak(current, desired, std::memory_order_release, std::memory_order_relaxed))
+      return true;
+  }
+  return false;
+}
+
+void SharedBestMix::raise(int profitCents)
+{
+  // Keep the holder: its mix is still the best one this search found
+  uint64_t current = word.load(std::memory_order_relaxed);
+  while (profitCents > profitOf(current))
+  {
+    if (word.compare_exchange_weak(current, pack(profitCents, holderOf(current)), std::memory_order_relaxed))
+      return;
+  }
+}
+
+bool SharedBestMix::read(Entry &entry) const
+{
+  uint32_t holder = holderOf(word.load(std::memory_order_acquire));
+  if (holder == 0)
+    return false;
+
+  const Slot &slot = slots[holder - 1];
+  while (true)
+  {
+    uint32_t before = slot.sequence.load(std::memory_order_acquire);
+    if (before & 1)
+      continue;
+
+    entry.length = slot.length.load(std::memory_order_relaxed);
+    entry.profitCents = slot.profitCents.load(std::memory_order_relaxed);
+    entry.sellPriceCents = slot.sellPriceCents.load(std::memory_order_relaxed);
+    entry.costCents = slot.costCents.load(std::memory_order_relaxed);
+    for (int i = 0; i < entry.length && i < static_cast<int>(MAX_MIX_LENGTH); ++i)
+    {
+      entry.substanceIndices[i] = slot.substanceIndices[i].load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) == before)
+      return true;
+  }
+}
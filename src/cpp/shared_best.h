@@ -0,0 +1,70 @@
+#pragma once
+
+#include "types.h"
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+// Best mix of a parallel search, shared without locks. The best profit and the worker
+// holding it are packed into one word that only rises, through a CAS. Each worker
+// publishes its mixes into a slot of its own, so a worker that finds a better mix never
+// waits on another one or on whoever reports it. Reporters poll the word and copy the
+// holder's slot
+class SharedBestMix
+{
+public:
+  // Copy of a published mix and its prices
+  struct Entry
+  {
+    int substanceIndices[MAX_MIX_LENGTH];
+    int length;
+    int profitCents;
+    int sellPriceCents;
+    int costCents;
+
+    MixState toMixState() const;
+  };
+
+  // Published mixes have to beat initialProfitCents
+  SharedBestMix(int workerCount, int initialProfitCents);
+
+  // Best profit so far, for bounds
+  int profitCents() const { return profitOf(word.load(std::memory_order_relaxed)); }
+
+  // Publish a worker's mix if it beats the best so far, and return whether it did. Only
+  // one thread at a time may publish into a worker's slot
+  bool publish(int worker, const int *substanceIndices, int length,
+               int profitCents, int sellPriceCents, int costCents);
+
+  // Raise the best profit to a bound found elsewhere, such as another node's best, without
+  // a mix to go with it. Mixes published later have to beat it
+  void raise(int profitCents);
+
+  // Copy the best published mix. Returns false if no mix was published
+  bool read(Entry &entry) const;
+
+private:
+  // Profit in the high half, 1 + the holding worker in the low half (0 = none)
+  static uint64_t pack(int profitCents, uint32_t holder)
+  {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(profitCents)) << 32) | holder;
+  }
+  static int profitOf(uint64_t packed) { return static_cast<int32_t>(static_cast<uint32_t>(packed >> 32)); }
+  static uint32_t holderOf(uint64_t packed) { return static_cast<uint32_t>(packed); }
+
+  // A worker's latest published mix behind a sequence lock: the sequence is odd while the
+  // worker rewrites the slot, and readers retry when it changed under them. A cache line
+  // per slot, so workers don't contend on each other's
+  struct alignas(64) Slot
+  {
+    std::atomic<uint32_t> sequence;
+    std::atomic<int> length;
+    std::atomic<int> profitCents;
+    std::atomic<int> sellPriceCents;
+    std::atomic<int> costCents;
+    std::atomic<int> substanceIndices[MAX_MIX_LENGTH];
+  };
+
+  std::atomic<uint64_t> word;
+  std::unique_ptr<Slot[]> slots;
+};
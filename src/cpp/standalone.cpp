@@ -8,31 +8,50 @@
 #include <cmath>
 #include <limits>
 #include <algorithm>
+#include <memory>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
 #include "types.h"
 #include "effects.h"
 #include "pricing.h"
 #include "bfs_algorithm.h"
 #include "dfs_algorithm.h"
+#include "dp_algorithm.h"
 #include "json_parser.h"
+#include "alloc_counter.h"
+#include "result_cache.h"
+#include "checkpoint.h"
+#include "dataset.h"
+#include "batch.h"
+#include "shard.h"
+#include "daemon.h"
+#include "metrics.h"
 
 // External console mutex declaration (defined in dfs_algorithm.cpp)
 extern std::mutex g_consoleMutex;
 
-// Forward declaration of functions defined in dfs.cpp
-JsBestMixResult findBestMixDFSJsonWithProgress(
-    std::string productJson,
-    std::string substancesJson,
-    std::string effectMultipliersJson,
-    std::string substanceRulesJson,
-    int maxDepth,
-    bool reportProgress,
-    bool useHashingOptimization);
+// Cancels the running search on the first SIGINT or SIGTERM
+static CancellationToken g_interruptToken;
+
+static void cancelOnSignal(int signal)
+{
+    g_interruptToken.cancel();
+
+    // A second one kills the process as usual
+    std::signal(signal, SIG_DFL);
+}
 
-// Simple progress reporting to console
+// Simple progress reporting to console, at most every 100 ms plus the final report, with
+// the time left at the measured rate
 void reportProgressToConsole(int depth, int64_t processed, int64_t total)
 {
-    // Only report progress every 10,000 combinations instead of every time
-    if (processed % 10000 != 0 && processed != total)
+    static std::atomic<int64_t> lastReportMs(0);
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+    int64_t last = lastReportMs.load(std::memory_order_relaxed);
+    if (processed != total && (now - last < 100 || !lastReportMs.compare_exchange_strong(last, now)))
     {
         return;
     }
@@ -40,38 +59,79 @@ void reportProgressToConsole(int depth, int64_t processed, int64_t total)
     // Lock console output to avoid garbled text from multiple threads
     std::lock_guard<std::mutex> lock(g_consoleMutex);
 
-    // Calculate percentage safely to avoid negative values
+    // A count going backwards is the next search, or the next depth of an anytime one. The
+    // rate is measured from the first report after the start, since a resumed search
+    // starts with the work of its checkpoint already counted
+    static ThroughputEstimator throughput;
+    static int64_t startMs = 0;
+    static int64_t lastProcessed = -1;
+    if (processed < lastProcessed || lastProcessed <= 0)
+    {
+        throughput = ThroughputEstimator();
+        throughput.update(0.0, processed);
+        startMs = now;
+    }
+    lastProcessed = processed;
+    throughput.update((now - startMs) / 1000.0, processed);
+    double etaSeconds = throughput.etaSeconds(total - processed);
+
+    // Calculate the percentage in floating point, since totals of deep searches are too
+    // large to multiply by 100
     int percentage = 0;
     if (total > 0)
     {
-        // Calculate percentage using 64-bit arithmetic
-        percentage = static_cast<int>((100 * processed) / total);
-
-        // Make sure percentage is between 0 and 100
+        percentage = static_cast<int>(100.0 * processed / total);
         percentage = std::max(0, std::min(100, percentage));
     }
 
     std::cout << "Progress: Depth " << depth << ", "
               << processed << "/" << total
-              << " (" << percentage << "%)" << std::endl;
+              << " (" << percentage << "%)";
+    if (processed != total && etaSeconds >= 0)
+    {
+        std::cout << ", about " << static_cast<int64_t>(std::ceil(etaSeconds)) << " s left";
+    }
+    std::cout << std::endl;
 }
 
-// Format result as JSON string
-std::string formatResultAsJson(const JsBestMixResult &result)
+// Format a list of substance names as a JSON array
+static std::string formatMixArrayAsJson(const std::vector<std::string> &mixArray)
 {
-    std::string json = "{\n";
-    json += "  \"mixArray\": [";
-
-    // Handle the mix array - convert vector to JSON array
+    std::string json = "[";
     bool first = true;
-    for (const auto &substanceName : result.mixArray)
+    for (const auto &substanceName : mixArray)
     {
         if (!first)
             json += ", ";
         first = false;
         json += "\"" + substanceName + "\"";
     }
-    json += "],\n";
+    json += "]";
+    return json;
+}
+
+// Split a comma-separated list of effect or substance names
+static std::vector<std::string> splitNameList(const std::string &list)
+{
+    std::vector<std::string> names;
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+            end = list.size();
+        if (end > start)
+            names.push_back(list.substr(start, end - start));
+        start = end + 1;
+    }
+    return names;
+}
+
+// Format result as JSON string
+std::string formatResultAsJson(const JsBestMixResult &result)
+{
+    std::string json = "{\n";
+    json += "  \"mixArray\": " + formatMixArrayAsJson(result.mixArray) + ",\n";
 
     // Convert cents back to dollars with 2 decimal places for JSON output
     double profit = result.profitCents / 100.0;
@@ -80,97 +140,176 @@ std::string formatResultAsJson(const JsBestMixResult &result)
 
     json += "  \"profit\": " + std::to_string(profit) + ",\n";
     json += "  \"sellPrice\": " + std::to_string(sellPrice) + ",\n";
-    json += "  \"cost\": " + std::to_string(cost) + "\n";
+    json += "  \"cost\": " + std::to_string(cost) + ",\n";
+
+    // Best mixes with distinct effect sets, best first
+    json += "  \"topMixes\": [";
+    for (size_t i = 0; i < result.topMixes.size(); ++i)
+    {
+        const RankedMixResult &entry = result.topMixes[i];
+        json += i > 0 ? ",\n    " : "\n    ";
+        json += "{\"mixArray\": " + formatMixArrayAsJson(entry.mixArray) +
+                ", \"profit\": " + std::to_string(entry.profitCents / 100.0) +
+                ", \"sellPrice\": " + std::to_string(entry.sellPriceCents / 100.0) +
+                ", \"cost\": " + std::to_string(entry.costCents / 100.0) + "}";
+    }
+    json += result.topMixes.empty() ? "]\n" : "\n  ]\n";
     json += "}";
 
     return json;
 }
 
-// Parse JSON input and run BFS with progress reporting
-JsBestMixResult findBestMixJsonWithProgress(
-    std::string productJson,
-    std::string substancesJson,
-    std::string effectMultipliersJson,
-    std::string substanceRulesJson,
+// Run the chosen engine on inputs that were parsed or loaded once
+static JsBestMixResult runSearch(
+    const std::string &algorithm,
+    const Product &product,
+    const Dataset &dataset,
     int maxDepth,
-    bool reportProgress)
+    bool reportProgress,
+    bool useHashingOptimization,
+    const SearchOptions &options)
 {
-    // Parse JSON inputs
-    Product product = parseProductJson(productJson);
-    std::vector<Substance> substances = parseSubstancesJson(substancesJson);
-    std::unordered_map<std::string, int> effectMultipliers = parseEffectMultipliersJson(effectMultipliersJson);
-    applySubstanceRulesJson(substances, substanceRulesJson);
-
-    // Run the BFS algorithm with progress reporting if enabled
-#ifdef __EMSCRIPTEN__
+    ProgressCallback progressCallback = nullptr;
     if (reportProgress)
     {
-        // Use the WebAssembly-specific progress reporting function
-        return findBestMix(product, substances, effectMultipliers, maxDepth, reportProgressToJS);
+        progressCallback = reportProgressToConsole;
     }
-    else
-#else
-    if (reportProgress)
+
+    if (algorithm == "dfs")
     {
-        return findBestMix(product, substances, effectMultipliers, maxDepth, reportProgressToConsole);
+        return findBestMixDFS(product, dataset.substances, dataset.effectMultipliers, maxDepth,
+                              progressCallback, useHashingOptimization, options);
     }
-    else
-#endif
+    if (algorithm == "dp")
     {
-        return findBestMix(product, substances, effectMultipliers, maxDepth, nullptr);
+        return findBestMixDP(product, dataset.substances, dataset.effectMultipliers, maxDepth,
+                             progressCallback, options);
     }
-}
-
-// Parse JSON input and run BFS without progress reporting
-JsBestMixResult findBestMixJson(
-    std::string productJson,
-    std::string substancesJson,
-    std::string effectMultipliersJson,
-    std::string substanceRulesJson,
-    int maxDepth)
-{
-    return findBestMixJsonWithProgress(
-        productJson,
-        substancesJson,
-        effectMultipliersJson,
-        substanceRulesJson,
-        maxDepth,
-        false);
+    return findBestMix(product, dataset.substances, dataset.effectMultipliers, maxDepth,
+                       progressCallback, options);
 }
 
 // Print usage information
 void printUsage(const char *programName)
 {
     std::cerr << "Usage: " << programName << " [options] <product_json> <substances_json> <effect_multipliers_json> <substance_rules_json> <max_depth>\n"
+              << "       " << programName << " [options] --dataset <dataset_bin> <product_json> <max_depth>\n"
+              << "       " << programName << " --build-dataset <dataset_bin> <substances_json> <effect_multipliers_json> <substance_rules_json>\n"
+              << "       " << programName << " [options] --batch <jobs_json> (<substances_json> <effect_multipliers_json> <substance_rules_json> | --dataset <dataset_bin>)\n"
+              << "       " << programName << " [options] --daemon\n"
               << "Options:\n"
               << "  -p, --progress  Enable progress reporting\n"
               << "  -o, --output    Output file (if not specified, prints to stdout)\n"
-              << "  -a, --algorithm  Algorithm to use: bfs (default) or dfs\n"
+              << "  -a, --algorithm  Algorithm to use: bfs (default), dfs or dp\n"
               << "  --no-hashing     Disable the hashing optimization for DFS (for benchmarking)\n"
+              << "  --table-states N Capacity of the shared DFS transition table (default " << DEFAULT_TRANSITION_TABLE_STATES << ")\n"
+              << "  --threads N      Worker threads for DFS and BFS (default: hardware concurrency)\n"
+              << "  --bfs-memory MB  Memory cap for the stored BFS frontier, deeper levels are streamed (default "
+              << (DEFAULT_BFS_MEMORY_LIMIT_BYTES >> 20) << ")\n"
+              << "  --prune          Skip DFS subtrees that provably can't beat the best mix (branch-and-bound)\n"
+              << "  --dominance      Skip DFS subtrees that reach an already expanded effect set at no lower cost\n"
+              << "  --metrics        Print DFS metrics (nodes/sec, per-depth counts, cache hit rate, pruning,\n"
+              << "                   thread utilization, progress and time left) as JSON lines {\"metrics\": {...}}\n"
+              << "                   every 100 ms\n"
+              << "  --anytime        Solve DFS depth 1, 2, ... in turn, printing each proven result as a JSON\n"
+              << "                   line {\"depthResult\": {...}} and bounding the next depth with it\n"
+              << "  --deadline MS    Stop the search after MS milliseconds and return the best mix found so far\n"
+              << "  --checkpoint F   Save DFS progress to F every interval, to be resumed after a kill or deadline\n"
+              << "  --checkpoint-interval S Seconds between two checkpoints (default " << DEFAULT_CHECKPOINT_INTERVAL_MS / 1000 << ")\n"
+              << "  --resume         Continue the DFS search saved in the checkpoint file (default " << DEFAULT_CHECKPOINT_FILE << ")\n"
+              << "  --prefix-depth N Length of the substance prefixes DFS work is split into (1-" << MAX_DFS_PREFIX_DEPTH
+              << ", default " << DEFAULT_DFS_PREFIX_DEPTH << ")\n"
+              << "  --no-cache       Don't read or write the on-disk result cache\n"
+              << "  --cache-file F   Result cache file (default " << DEFAULT_RESULT_CACHE_FILE << ")\n"
+              << "  --cache-entries N Maximum number of cached results (default " << DEFAULT_RESULT_CACHE_ENTRIES << ")\n"
+              << "  --top K          Also report the K most profitable mixes with distinct effect sets (default 1)\n"
+              << "  --top-max-cost C Only list mixes costing at most C dollars in the top K\n"
+              << "  --top-max-length N Only list mixes of at most N substances in the top K\n"
+              << "  --max-cost C     Only consider mixes costing at most C dollars\n"
+              << "  --require E,...  Only consider mixes that end with all of these effects\n"
+              << "  --forbid E,...   Only consider mixes that end with none of these effects\n"
+              << "  --only S,...     Only use these substances\n"
+              << "  --length N       Only consider mixes of exactly N substances\n"
+              << "  --dataset F      Read substances, rules and multipliers from a binary snapshot\n"
+              << "  --build-dataset F Convert the three JSON files to a binary snapshot for --dataset and exit\n"
+              << "  --batch F        Solve a JSON array of {\"product\", \"maxDepth\", \"algorithm\"} jobs over one\n"
+              << "                   dataset and print a JSON array of their results\n"
+              << "  --shard I/N      Only search shard I of N of the DFS work units and print its partial\n"
+              << "                   result, for --merge\n"
+              << "  --merge          Combine the shard results in the given files into the search's result\n"
+              << "  --bound-hub PORT Serve the best profit of the shards of a search on a TCP port\n"
+              << "  --share-bound A  Trade the best profit with the bound hub at HOST:PORT while searching\n"
+              << "  --daemon         Stay resident and serve framed jobs on stdin/stdout (see daemon.h)\n"
               << "  -h, --help      Show this help message\n";
 }
 
 // Function to read file content into a string
 std::string readFileContents(const std::string &filePath)
 {
-    std::ifstream file(filePath);
+    std::ifstream file(filePath, std::ios::binary);
     if (!file.is_open())
     {
         throw std::runtime_error("Could not open file: " + filePath);
     }
 
-    std::string content((std::istreambuf_iterator<char>(file)),
-                        std::istreambuf_iterator<char>());
-    file.close();
+    // Read the whole file in one call instead of a character at a time
+    file.seekg(0, std::ios::end);
+    std::string content(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0, std::ios::beg);
+    file.read(&content[0], content.size());
     return content;
 }
 
+// Load the dataset from a snapshot, or else parse it from its three JSON files
+static Dataset loadDataset(const std::string &datasetFile, const std::vector<std::string> &jsonPaths)
+{
+    if (!datasetFile.empty())
+    {
+        return loadDatasetSnapshot(datasetFile);
+    }
+    return parseDatasetJson(
+        readFileContents(jsonPaths[0]), readFileContents(jsonPaths[1]), readFileContents(jsonPaths[2]));
+}
+
+// Print the result JSON, or write it to the output file if one was given
+static int writeOutput(const std::string &resultJson, const std::string &outputFile)
+{
+    if (outputFile.empty())
+    {
+        std::cout << resultJson << std::endl;
+        return 0;
+    }
+
+    std::ofstream outFile(outputFile);
+    if (!outFile)
+    {
+        std::cerr << "Error: Could not open output file: " << outputFile << std::endl;
+        return 1;
+    }
+    outFile << resultJson;
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     bool reportProgress = false;
     std::string outputFile;
     std::string algorithm = "dfs";      // Changed default to "dfs" instead of "bfs"
     bool useHashingOptimization = true; // Default to using hashing optimization
+    SearchOptions searchOptions;
+    bool useCache = true;
+    std::string cacheFile = DEFAULT_RESULT_CACHE_FILE;
+    size_t cacheEntries = DEFAULT_RESULT_CACHE_ENTRIES;
+    bool daemonMode = false;
+    int64_t deadlineMs = 0;
+    std::string checkpointFile;
+    bool resume = false;
+    std::string datasetFile;
+    std::string buildDatasetFile;
+    std::string batchFile;
+    bool mergeShards = false;
+    int boundHubPort = 0;
+    std::string boundHubAddress;
     std::vector<std::string> jsonArgs;
 
     // Check if being called from server by looking for explicit algorithm flag
@@ -203,6 +342,290 @@ int main(int argc, char *argv[])
         {
             useHashingOptimization = false;
         }
+        else if (arg == "--table-states")
+        {
+            if (i + 1 < argc)
+            {
+                searchOptions.transitionTableStates = std::stoull(argv[++i]);
+            }
+            else
+            {
+                std::cerr << "Error: Table size missing\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--prune")
+        {
+            searchOptions.pruning = true;
+        }
+        else if (arg == "--dominance")
+        {
+            searchOptions.dominance = true;
+        }
+        else if (arg == "--metrics")
+        {
+            searchOptions.metricsCallback = [](const std::string &metricsJson)
+            {
+                std::lock_guard<std::mutex> lock(g_consoleMutex);
+                std::cout << "{\"metrics\": " << metricsJson << "}" << std::endl;
+            };
+        }
+        else if (arg == "--anytime")
+        {
+            searchOptions.anytime = true;
+            searchOptions.depthResultCallback = [](int depth, const JsBestMixResult &result, bool complete)
+            {
+                std::lock_guard<std::mutex> lock(g_consoleMutex);
+                std::cout << "{\"depthResult\": {\"depth\": " << depth
+                          << ", \"complete\": " << (complete ? "true" : "false")
+                          << ", \"mixArray\": " << formatMixArrayAsJson(result.mixArray)
+                          << ", \"profit\": " << std::to_string(result.profitCents / 100.0)
+                          << ", \"sellPrice\": " << std::to_string(result.sellPriceCents / 100.0)
+                          << ", \"cost\": " << std::to_string(result.costCents / 100.0) << "}}" << std::endl;
+            };
+        }
+        else if (arg == "--deadline")
+        {
+            if (i + 1 < argc)
+            {
+                deadlineMs = std::stoll(argv[++i]);
+            }
+            else
+            {
+                std::cerr << "Error: Deadline missing\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--checkpoint" || arg == "--checkpoint-interval")
+        {
+            if (i + 1 < argc)
+            {
+                std::string value = argv[++i];
+                if (arg == "--checkpoint")
+                {
+                    checkpointFile = value;
+                }
+                else
+                {
+                    searchOptions.checkpointIntervalMs = std::max(1, static_cast<int>(std::stod(value) * 1000));
+                }
+            }
+            else
+            {
+                std::cerr << "Error: Checkpoint value missing\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--resume")
+        {
+            resume = true;
+        }
+        else if (arg == "--dataset" || arg == "--build-dataset" || arg == "--batch")
+        {
+            if (i + 1 < argc)
+            {
+                std::string value = argv[++i];
+                if (arg == "--dataset")
+                {
+                    datasetFile = value;
+                }
+                else if (arg == "--build-dataset")
+                {
+                    buildDatasetFile = value;
+                }
+                else
+                {
+                    batchFile = value;
+                }
+            }
+            else
+            {
+                std::cerr << "Error: File for " << arg << " missing\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--daemon")
+        {
+            daemonMode = true;
+        }
+        else if (arg == "--shard")
+        {
+            char slash = 0;
+            bool valid = i + 1 < argc &&
+                         std::sscanf(argv[++i], "%d%c%d", &searchOptions.shardIndex, &slash,
+                                     &searchOptions.shardCount) == 3 &&
+                         slash == '/' && searchOptions.shardIndex >= 0 &&
+                         searchOptions.shardIndex < searchOptions.shardCount;
+            if (!valid)
+            {
+                std::cerr << "Error: Shard must be I/N with 0 <= I < N\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--merge")
+        {
+            mergeShards = true;
+        }
+        else if (arg == "--bound-hub" || arg == "--share-bound")
+        {
+            if (i + 1 < argc)
+            {
+                std::string value = argv[++i];
+                if (arg == "--bound-hub")
+                {
+                    boundHubPort = std::stoi(value);
+                }
+                else
+                {
+                    boundHubAddress = value;
+                }
+            }
+            else
+            {
+                std::cerr << "Error: Value for " << arg << " missing\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--top" || arg == "--top-max-cost" || arg == "--top-max-length")
+        {
+            if (i + 1 < argc)
+            {
+                std::string value = argv[++i];
+                if (arg == "--top")
+                {
+                    searchOptions.topK = static_cast<size_t>(std::max(1, std::stoi(value)));
+                }
+                else if (arg == "--top-max-cost")
+                {
+                    searchOptions.topMaxCostCents = static_cast<int>(std::round(std::stod(value) * 100.0));
+                }
+                else
+                {
+                    searchOptions.topMaxLength = std::stoi(value);
+                }
+            }
+            else
+            {
+                std::cerr << "Error: Value for " << arg << " missing\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--max-cost" || arg == "--require" || arg == "--forbid" || arg == "--only" ||
+                 arg == "--length")
+        {
+            if (i + 1 < argc)
+            {
+                std::string value = argv[++i];
+                SearchConstraints &constraints = searchOptions.constraints;
+                if (arg == "--max-cost")
+                {
+                    constraints.maxCostCents = static_cast<int>(std::round(std::stod(value) * 100.0));
+                }
+                else if (arg == "--require")
+                {
+                    constraints.requiredEffects = splitNameList(value);
+                }
+                else if (arg == "--forbid")
+                {
+                    constraints.forbiddenEffects = splitNameList(value);
+                }
+                else if (arg == "--only")
+                {
+                    constraints.allowedSubstances = splitNameList(value);
+                }
+                else
+                {
+                    constraints.exactLength = std::max(0, std::stoi(value));
+                }
+            }
+            else
+            {
+                std::cerr << "Error: Value for " << arg << " missing\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--no-cache")
+        {
+            useCache = false;
+        }
+        else if (arg == "--cache-file")
+        {
+            if (i + 1 < argc)
+            {
+                cacheFile = argv[++i];
+            }
+            else
+            {
+                std::cerr << "Error: Cache file missing\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--cache-entries")
+        {
+            if (i + 1 < argc)
+            {
+                cacheEntries = static_cast<size_t>(std::stoull(argv[++i]));
+            }
+            else
+            {
+                std::cerr << "Error: Cache size missing\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--bfs-memory")
+        {
+            if (i + 1 < argc)
+            {
+                searchOptions.bfsMemoryLimitBytes = static_cast<size_t>(std::stoull(argv[++i])) << 20;
+            }
+            else
+            {
+                std::cerr << "Error: BFS memory limit missing\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--threads")
+        {
+            if (i + 1 < argc)
+            {
+                searchOptions.threads = std::stoi(argv[++i]);
+            }
+            else
+            {
+                std::cerr << "Error: Thread count missing\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--prefix-depth")
+        {
+            if (i + 1 < argc)
+            {
+                searchOptions.prefixDepth = std::stoi(argv[++i]);
+                if (searchOptions.prefixDepth < 1 || searchOptions.prefixDepth > MAX_DFS_PREFIX_DEPTH)
+                {
+                    std::cerr << "Error: Prefix depth must be between 1 and " << MAX_DFS_PREFIX_DEPTH << "\n";
+                    return 1;
+                }
+            }
+            else
+            {
+                std::cerr << "Error: Prefix depth missing\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
         else if (arg == "-o" || arg == "--output")
         {
             if (i + 1 < argc)
@@ -221,9 +644,9 @@ int main(int argc, char *argv[])
             if (i + 1 < argc)
             {
                 algorithm = argv[++i];
-                if (algorithm != "bfs" && algorithm != "dfs")
+                if (algorithm != "bfs" && algorithm != "dfs" && algorithm != "dp")
                 {
-                    std::cerr << "Error: Invalid algorithm. Use 'bfs' or 'dfs'\n";
+                    std::cerr << "Error: Invalid algorithm. Use 'bfs', 'dfs' or 'dp'\n";
                     printUsage(argv[0]);
                     return 1;
                 }
@@ -246,45 +669,190 @@ int main(int argc, char *argv[])
         }
     }
 
-    // Check if we have enough arguments
-    if (jsonArgs.size() < 5)
+    // Serve jobs from the client until it disconnects
+    if (daemonMode)
     {
-        std::cerr << "Error: Not enough arguments\n";
-        printUsage(argv[0]);
-        return 1;
+        std::unique_ptr<ResultCache> daemonCache;
+        if (useCache)
+        {
+            daemonCache.reset(new ResultCache(cacheFile, cacheEntries));
+        }
+        return runDaemon(searchOptions, useHashingOptimization, daemonCache.get());
     }
 
-    // Extract JSON file paths and max depth
-    std::string productJsonPath = jsonArgs[0];
-    std::string substancesJsonPath = jsonArgs[1];
-    std::string effectMultipliersJsonPath = jsonArgs[2];
-    std::string substanceRulesJsonPath = jsonArgs[3];
-    int maxDepth;
+    // The deadline counts from startup, so it bounds the whole run
+    if (deadlineMs > 0)
+    {
+        searchOptions.setTimeLimit(deadlineMs);
+    }
 
-    // Try to get max depth from command line first
-    if (jsonArgs.size() > 4)
+    // Daemon jobs aren't checkpointed, they'd all share one file
+    if (resume && checkpointFile.empty())
     {
+        checkpointFile = DEFAULT_CHECKPOINT_FILE;
+    }
+    searchOptions.checkpointFile = checkpointFile;
+    searchOptions.resume = resume;
+
+    // Ctrl-C stops the search, which still prints its best mix so far and, when
+    // checkpointing, saves where it got to
+    searchOptions.cancellation = &g_interruptToken;
+    std::signal(SIGINT, cancelOnSignal);
+    std::signal(SIGTERM, cancelOnSignal);
+
+    // Hold the best profit of the shards of a distributed search until interrupted
+    if (boundHubPort > 0)
+    {
+        return runBoundHub(boundHubPort, &g_interruptToken);
+    }
+
+    // Combine the partial results of a sharded search
+    if (mergeShards)
+    {
+        if (jsonArgs.empty())
+        {
+            std::cerr << "Error: No shard results to merge\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        JsBestMixResult merged;
         try
         {
-            maxDepth = std::stoi(jsonArgs[4]);
+            std::vector<ShardResult> shards;
+            for (const std::string &shardFile : jsonArgs)
+            {
+                shards.push_back(parseShardResultJson(readFileContents(shardFile)));
+            }
+            std::vector<std::string> warnings;
+            merged = mergeShardResults(shards, searchOptions.topK, warnings);
+            for (const std::string &warning : warnings)
+            {
+                std::cerr << "Warning: " << warning << std::endl;
+            }
         }
         catch (const std::exception &e)
         {
-            std::cerr << "Error parsing max depth from command line: " << e.what() << std::endl;
-            maxDepth = 5; // Default to 5 if parsing fails
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
         }
+        return writeOutput(formatResultAsJson(merged), outputFile);
     }
-    else
+
+    // A shard's result is only part of the search's, so it isn't cached, and its work units
+    // only exist in DFS
+    bool sharded = searchOptions.shardCount > 1;
+    if (sharded || !boundHubAddress.empty())
     {
-        maxDepth = 5; // Default if not provided
+        if (algorithm != "dfs" || searchOptions.anytime)
+        {
+            std::cerr << "Error: Shards are only supported by DFS without --anytime\n";
+            return 1;
+        }
+        useCache = false;
     }
+    if (!boundHubAddress.empty())
+    {
+        try
+        {
+            searchOptions.boundExchange = connectBoundHub(boundHubAddress);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    // Convert the JSON dataset to a binary snapshot for later runs
+    if (!buildDatasetFile.empty())
+    {
+        if (jsonArgs.size() < 3)
+        {
+            std::cerr << "Error: Not enough arguments\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+        try
+        {
+            Dataset dataset = loadDataset("", jsonArgs);
+            saveDatasetSnapshot(buildDatasetFile, dataset);
+            std::cout << "Wrote a dataset snapshot of " << dataset.substances.size() << " substances to "
+                      << buildDatasetFile << std::endl;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Solve a list of jobs against one dataset, printing one JSON array of results. Engine
+    // log text goes to stderr, so stdout only holds the array
+    if (!batchFile.empty())
+    {
+        if (datasetFile.empty() && jsonArgs.size() < 3)
+        {
+            std::cerr << "Error: Not enough arguments\n";
+            printUsage(argv[0]);
+            return 1;
+        }
 
-    // Read JSON content from files
-    std::string productJson, substancesJson, effectMultipliersJson, substanceRulesJson;
-    productJson = readFileContents(productJsonPath);
-    substancesJson = readFileContents(substancesJsonPath);
-    effectMultipliersJson = readFileContents(effectMultipliersJsonPath);
-    substanceRulesJson = readFileContents(substanceRulesJsonPath);
+        std::string resultsJson;
+        std::streambuf *consoleBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+        try
+        {
+            Dataset dataset = loadDataset(datasetFile, jsonArgs);
+            std::vector<BatchJob> jobs = parseBatchJobsJson(readFileContents(batchFile), algorithm);
+            resultsJson = runBatch(jobs, dataset, searchOptions, useHashingOptimization);
+        }
+        catch (const std::exception &e)
+        {
+            std::cout.rdbuf(consoleBuffer);
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        std::cout.rdbuf(consoleBuffer);
+        return writeOutput(resultsJson, outputFile);
+    }
+
+    // Check if we have enough arguments; a dataset snapshot replaces the three dataset files
+    size_t requiredArgs = datasetFile.empty() ? 5 : 2;
+    if (jsonArgs.size() < requiredArgs)
+    {
+        std::cerr << "Error: Not enough arguments\n";
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Max depth from the command line
+    int maxDepth;
+    try
+    {
+        maxDepth = std::stoi(jsonArgs[requiredArgs - 1]);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error parsing max depth from command line: " << e.what() << std::endl;
+        maxDepth = 5; // Default to 5 if parsing fails
+    }
+
+    // Read and parse every input once
+    std::string productJson;
+    Product product;
+    Dataset dataset;
+    try
+    {
+        productJson = readFileContents(jsonArgs[0]);
+        product = parseProductJson(productJson);
+        dataset = loadDataset(datasetFile, std::vector<std::string>(jsonArgs.begin() + 1, jsonArgs.end()));
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
 
     // Check if maxDepth is included in the product JSON
     try
@@ -316,58 +884,110 @@ int main(int argc, char *argv[])
         // Continue with the command line value
     }
 
-    // Call the appropriate algorithm based on user selection
+    // Results only depend on the parsed inputs and the depth, so repeat queries can be
+    // answered from the on-disk cache
     JsBestMixResult result;
-    if (algorithm == "dfs")
+    std::unique_ptr<ResultCache> cache;
+    uint64_t cacheKey = 0;
+    CachedResult cached;
+    bool cacheHit = false;
+    if (useCache)
     {
+        cacheKey = computeResultCacheKey(product, dataset.substances, dataset.effectMultipliers, searchOptions.constraints);
+        cache.reset(new ResultCache(cacheFile, cacheEntries));
+
+        // The cache only holds the best mix, so top-K queries are always searched
+        if (!searchOptions.wantsTopList() && cache->find(cacheKey, maxDepth, cached))
         {
-            std::lock_guard<std::mutex> lock(g_consoleMutex);
-            std::cout << "Running DFS algorithm with " << (reportProgress ? "progress reporting" : "no progress reporting")
-                      << " and hashing optimization " << (useHashingOptimization ? "ENABLED" : "DISABLED") << std::endl;
+            cacheHit = true;
         }
-        result = findBestMixDFSJsonWithProgress(
-            productJson, substancesJson, effectMultipliersJson,
-            substanceRulesJson, maxDepth, reportProgress, useHashingOptimization);
+        else if (cache->findShallower(cacheKey, maxDepth, cached))
+        {
+            // Seed the search with the best mix of the deepest shallower search
+            seedFromCachedResult(cached, dataset.substances, searchOptions.seed);
+
+            if (searchOptions.seed.valid)
+            {
+                std::cout << "Result cache: seeding search with the depth " << cached.depth
+                          << " best mix (profit " << cached.profitCents / 100.0 << ")" << std::endl;
+            }
+        }
+    }
+
+    int64_t allocationsBefore = heapAllocationCount();
+    if (cacheHit)
+    {
+        std::cout << "Result cache: hit for depth " << maxDepth << std::endl;
+        std::cout << "Best mix so far: [";
+        for (size_t i = 0; i < cached.mix.size(); ++i)
+        {
+            if (i > 0)
+                std::cout << ", ";
+            std::cout << cached.mix[i];
+        }
+        std::cout << "] with profit " << cached.profitCents / 100.0
+                  << ", price " << cached.sellPriceCents / 100.0
+                  << ", cost " << cached.costCents / 100.0 << std::endl;
+
+        result = toBestMixResult(cached);
     }
     else
     {
+        // Call the appropriate algorithm based on user selection
         {
             std::lock_guard<std::mutex> lock(g_consoleMutex);
-            std::cout << "Running BFS algorithm with " << (reportProgress ? "progress reporting" : "no progress reporting") << std::endl;
+            std::string progressText = reportProgress ? "progress reporting" : "no progress reporting";
+            if (algorithm == "dfs")
+            {
+                std::cout << "Running DFS algorithm with " << progressText
+                          << " and hashing optimization " << (useHashingOptimization ? "ENABLED" : "DISABLED") << std::endl;
+            }
+            else if (algorithm == "dp")
+            {
+                std::cout << "Running DP algorithm with " << progressText << std::endl;
+            }
+            else
+            {
+                std::cout << "Running BFS algorithm with " << progressText << std::endl;
+            }
         }
-        if (reportProgress)
+        result = runSearch(algorithm, product, dataset, maxDepth, reportProgress, useHashingOptimization, searchOptions);
+        if (g_interruptToken.cancelled())
         {
-            result = findBestMixJsonWithProgress(
-                productJson, substancesJson, effectMultipliersJson,
-                substanceRulesJson, maxDepth, true);
+            std::cerr << "Interrupted, the result is the best mix found so far" << std::endl;
         }
-        else
+
+        // A search stopped at its deadline or interrupted didn't cover the whole depth, so it isn't cached
+        if (cache && !result.mixArray.empty() && !g_shouldTerminate)
         {
-            result = findBestMixJson(
-                productJson, substancesJson, effectMultipliersJson,
-                substanceRulesJson, maxDepth);
+            cache->store(cacheKey, {maxDepth, result.mixArray, result.profitCents,
+                                    result.sellPriceCents, result.costCents});
         }
     }
 
-    // Format the result as JSON
-    std::string resultJson = formatResultAsJson(result);
-
-    // Output the result
-    if (outputFile.empty())
+    // Heap allocations don't grow with depth once the search hot paths are warm
+    if (allocationsBefore >= 0)
     {
-        std::cout << resultJson << std::endl;
+        std::cout << "Heap allocations during search: " << heapAllocationCount() - allocationsBefore << std::endl;
     }
-    else
+
+    // A shard prints its partial result and counters for --merge
+    if (sharded)
     {
-        std::ofstream outFile(outputFile);
-        if (!outFile)
-        {
-            std::cerr << "Error: Could not open output file: " << outputFile << std::endl;
-            return 1;
-        }
-        outFile << resultJson;
-        outFile.close();
+        ShardResult shard;
+        shard.index = searchOptions.shardIndex;
+        shard.count = searchOptions.shardCount;
+        shard.maxDepth = maxDepth;
+        shard.complete = !g_shouldTerminate;
+        shard.result = result;
+        shard.nodes = g_totalProcessedCombinations.load();
+        shard.prunedSubtrees = g_prunedSubtrees.load();
+        shard.prunedNodes = g_prunedCombinations.load();
+        shard.dominatedSubtrees = g_dominatedSubtrees.load();
+        return writeOutput(formatShardResultJson(shard), outputFile);
     }
 
-    return 0;
+    // Format the result as JSON
+    std::string resultJson = formatResultAsJson(result);
+    return writeOutput(resultJson, outputFile);
 }
@@ -0,0 +1,230 @@
+#include "state_table.h"
+#include "pricing.h"
+#include <algorithm>
+
+// Smallest power of two that is >= value
+static size_t nextPowerOfTwo(size_t value)
+{
+  size_t result = 1;
+  while (result < value)
+  {
+    result <<= 1;
+  }
+  return result;
+}
+
+// Slots in the first hash segment; later segments double in size
+static const size_t FIRST_SEGMENT_SLOTS = size_t(1) << 13;
+
+TransitionTable::Segment::Segment(size_t slotCount)
+    : slotMask(slotCount - 1),
+      stateCount(0),
+      slotKeys(new EffectMask[slotCount]),
+      slotIds(new std::atomic<int32_t>[slotCount])
+{
+  for (size_t i = 0; i < slotCount; ++i)
+  {
+    slotIds[i].store(EMPTY_SLOT, std::memory_order_relaxed);
+  }
+}
+
+TransitionTable::TransitionTable(const CompiledEffects &compiled, size_t maxStates)
+    : compiled(compiled),
+      kernel(compiled),
+      maxStates(maxStates),
+      nextStateId(0),
+      newestSegment(0),
+      masks(maxStates, 1, 0),
+      transitions(maxStates, compiled.substances.size(), UNKNOWN_STATE),
+      lateTransitions(maxStates, compiled.substances.size(), UNKNOWN_STATE)
+{
+  size_t firstSlots = std::min(nextPowerOfTwo(maxStates * 2), FIRST_SEGMENT_SLOTS);
+  segments[0].store(new Segment(firstSlots), std::memory_order_relaxed);
+  for (int i = 1; i < MAX_SEGMENTS; ++i)
+  {
+    segments[i].store(nullptr, std::memory_order_relaxed);
+  }
+  segmentStates = firstSlots / 2;
+}
+
+TransitionTable::~TransitionTable()
+{
+  for (int i = 0; i < MAX_SEGMENTS; ++i)
+  {
+    delete segments[i].load(std::memory_order_relaxed);
+  }
+}
+
+int32_t TransitionTable::getStateId(EffectMask mask)
+{
+  uint64_t hash = hashEffectMask(mask);
+
+  while (true)
+  {
+    // Look newest first - each segment is at least as large as all older ones together
+    int newest = newestSegment.load(std::memory_order_seq_cst);
+    for (int i = newest; i >= 0; --i)
+    {
+      int32_t id = findInSegment(*segments[i].load(std::memory_order_acquire), hash, mask);
+      if (id >= 0)
+      {
+        return id;
+      }
+    }
+
+    int32_t id = insertInSegment(newest, hash, mask);
+    if (id != RETRY_INSERT)
+    {
+      return id;
+    }
+  }
+}
+
+int32_t TransitionTable::findInSegment(const Segment &segment, uint64_t hash, EffectMask mask)
+{
+  size_t slot = hash & segment.slotMask;
+  while (true)
+  {
+    int32_t id = segment.slotIds[slot].load(std::memory_order_acquire);
+    if (id == EMPTY_SLOT)
+    {
+      return -1;
+    }
+    if (id == CLAIMED_SLOT)
+    {
+      continue; // Wait for the claiming thread to publish or abandon its slot
+    }
+    if (id != SKIPPED_SLOT && segment.slotKeys[slot] == mask)
+    {
+      return id;
+    }
+    slot = (slot + 1) & segment.slotMask;
+  }
+}
+
+int32_t TransitionTable::insertInSegment(int segmentIndex, uint64_t hash, EffectMask mask)
+{
+  Segment &segment = *segments[segmentIndex].load(std::memory_order_acquire);
+  size_t slot = hash & segment.slotMask;
+
+  // Linear probing - segments are at most about half full, so probe sequences stay short
+  while (true)
+  {
+    int32_t id = segment.slotIds[slot].load(std::memory_order_acquire);
+
+    if (id == EMPTY_SLOT)
+    {
+      // The mask isn't in the table - don't claim more slots once it's full
+      if (static_cast<size_t>(nextStateId.load(std::memory_order_relaxed)) >= maxStates)
+      {
+        return -1;
+      }
+
+      // Try to claim the empty slot for this mask
+      if (!segment.slotIds[slot].compare_exchange_strong(id, CLAIMED_SLOT, std::memory_order_seq_cst))
+      {
+        continue; // Another thread claimed it first, re-examine the slot
+      }
+      segment.slotKeys[slot] = mask;
+
+      // A thread that saw a newer segment may have probed past this slot before we
+      // claimed it and inserted the mask there. Both sides are sequentially consistent,
+      // so either it waits on our claim or we see its segment here and retry there
+      if (newestSegment.load(std::memory_order_seq_cst) != segmentIndex)
+      {
+        segment.slotIds[slot].store(SKIPPED_SLOT, std::memory_order_release);
+        return RETRY_INSERT;
+      }
+
+      int32_t newId = nextStateId.fetch_add(1, std::memory_order_relaxed);
+      if (static_cast<size_t>(newId) >= maxStates)
+      {
+        // Table is full - leave a marker so readers keep probing past this slot
+        segment.slotIds[slot].store(SKIPPED_SLOT, std::memory_order_release);
+        return -1;
+      }
+
+      masks.row(newId)->store(mask, std::memory_order_relaxed);
+      segment.slotIds[slot].store(newId, std::memory_order_release);
+
+      size_t count = segment.stateCount.fetch_add(1, std::memory_order_relaxed) + 1;
+      if (count >= (segment.slotMask + 1) / 2)
+      {
+        addSegment(segmentIndex);
+      }
+      return newId;
+    }
+
+    if (id == CLAIMED_SLOT)
+    {
+      continue; // Wait for the claiming thread to publish its state
+    }
+
+    if (id != SKIPPED_SLOT && segment.slotKeys[slot] == mask)
+    {
+      return id;
+    }
+
+    slot = (slot + 1) & segment.slotMask;
+  }
+}
+
+void TransitionTable::addSegment(int segmentIndex)
+{
+  // Threads filling the segment meanwhile block here, so it can't overfill
+  std::lock_guard<std::mutex> lock(segmentMutex);
+  if (newestSegment.load(std::memory_order_relaxed) != segmentIndex)
+  {
+    return; // Another thread already added it
+  }
+
+  // Once the segments can hold maxStates at their load limit, the newest one never
+  // reaches its limit, as every older one took at least its share
+  if (segmentStates >= maxStates || segmentIndex + 1 >= MAX_SEGMENTS)
+  {
+    return;
+  }
+
+  size_t slotCount = (segments[segmentIndex].load(std::memory_order_relaxed)->slotMask + 1) * 2;
+  segments[segmentIndex + 1].store(new Segment(slotCount), std::memory_order_release);
+  segmentStates += slotCount / 2;
+  newestSegment.store(segmentIndex + 1, std::memory_order_seq_cst);
+}
+
+int32_t TransitionTable::fillRow(LazyAtomicBlocks<int32_t> &phaseTransitions, int32_t stateId,
+                                 int substanceIndex, int recipeLength)
+{
+  thread_local std::vector<EffectMask> children;
+  children.resize(kernel.substanceCount());
+  kernel.expand(getMask(stateId), recipeLength, children.data());
+
+  // Threads racing on the same row compute the same successors, so plain stores are fine
+  std::atomic<int32_t> *row = phaseTransitions.row(stateId);
+  for (size_t s = 0; s < children.size(); ++s)
+  {
+    if (row[s].load(std::memory_order_acquire) == UNKNOWN_STATE)
+    {
+      row[s].store(getStateId(children[s]), std::memory_order_release);
+    }
+  }
+  return row[substanceIndex].load(std::memory_order_acquire);
+}
+
+size_t TransitionTable::stateCount() const
+{
+  size_t count = static_cast<size_t>(nextStateId.load(std::memory_order_relaxed));
+  return count < maxStates ? count : maxStates;
+}
+
+int StatePriceCache::getPrice(int32_t stateId, EffectMask effects, const PricingContext &pricing)
+{
+  std::atomic<int> &entry = prices.row(stateId)[0];
+  int price = entry.load(std::memory_order_relaxed);
+  if (price == UNKNOWN_PRICE)
+  {
+    // Racing threads compute the same value, so a plain store is enough
+    price = pricing.sellPrice(effects);
+    entry.store(price, std::memory_order_relaxed);
+  }
+  return price;
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include "effects.h"
+#include "rule_kernel.h"
+#include "pricing.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <climits>
+
+// Fixed-capacity array of atomics whose storage is allocated in blocks on first use,
+// so a large capacity only costs memory for the part that is actually touched
+template <typename T>
+class LazyAtomicBlocks
+{
+public:
+  static const size_t BLOCK_BITS = 12;
+  static const size_t BLOCK_SIZE = size_t(1) << BLOCK_BITS;
+
+  LazyAtomicBlocks(size_t capacity, size_t stride, T fillValue)
+      : blockCount((capacity + BLOCK_SIZE - 1) / BLOCK_SIZE),
+        stride(stride),
+        fillValue(fillValue),
+        blocks(new std::atomic<std::atomic<T> *>[blockCount])
+  {
+    for (size_t i = 0; i < blockCount; ++i)
+    {
+      blocks[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  ~LazyAtomicBlocks()
+  {
+    for (size_t i = 0; i < blockCount; ++i)
+    {
+      delete[] blocks[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  LazyAtomicBlocks(const LazyAtomicBlocks &) = delete;
+  LazyAtomicBlocks &operator=(const LazyAtomicBlocks &) = delete;
+
+  // Get the `stride` atomics stored for an index, allocating its block if needed
+  std::atomic<T> *row(size_t index)
+  {
+    size_t blockIndex = index >> BLOCK_BITS;
+    std::atomic<T> *block = blocks[blockIndex].load(std::memory_order_acquire);
+    if (!block)
+    {
+      block = allocateBlock(blockIndex);
+    }
+    return block + (index & (BLOCK_SIZE - 1)) * stride;
+  }
+
+  // Get the atomics of an index whose block is known to be allocated already
+  const std::atomic<T> *existingRow(size_t index) const
+  {
+    return blocks[index >> BLOCK_BITS].load(std::memory_order_acquire) + (index & (BLOCK_SIZE - 1)) * stride;
+  }
+
+private:
+  std::atomic<T> *allocateBlock(size_t blockIndex)
+  {
+    std::atomic<T> *fresh = new std::atomic<T>[BLOCK_SIZE * stride];
+    for (size_t i = 0; i < BLOCK_SIZE * stride; ++i)
+    {
+      fresh[i].store(fillValue, std::memory_order_relaxed);
+    }
+
+    // Publish our block unless another thread beat us to it
+    std::atomic<T> *expected = nullptr;
+    if (blocks[blockIndex].compare_exchange_strong(expected, fresh, std::memory_order_acq_rel))
+    {
+      return fresh;
+    }
+    delete[] fresh;
+    return expected;
+  }
+
+  size_t blockCount;
+  size_t stride;
+  T fillValue;
+  std::unique_ptr<std::atomic<std::atomic<T> *>[]> blocks;
+};
+
+// Shared, lazily filled table mapping canonical effect sets to dense state IDs and
+// (state, substance) pairs to successor states. Lookups are lock-free and safe to call
+// from any number of threads; only adding a hash segment takes a lock. Memory grows with
+// the states actually interned, up to `maxStates`. When the table is full, lookups
+// return -1 and callers fall back to applying the compiled rules directly
+class TransitionTable
+{
+public:
+  TransitionTable(const CompiledEffects &compiled, size_t maxStates = DEFAULT_TRANSITION_TABLE_STATES);
+  ~TransitionTable();
+
+  TransitionTable(const TransitionTable &) = delete;
+  TransitionTable &operator=(const TransitionTable &) = delete;
+
+  // Get the canonical state ID for an effect mask, inserting it if needed.
+  // Returns -1 if the mask isn't in the table and the table is full
+  int32_t getStateId(EffectMask mask);
+
+  // Get the effect mask of a state
+  EffectMask getMask(int32_t stateId) const
+  {
+    return masks.existingRow(stateId)->load(std::memory_order_relaxed);
+  }
+
+  // Get the state reached by adding a substance to a state at the given recipe length,
+  // filling the state's whole row on a miss. Returns -1 if the successor doesn't fit in
+  // the table. `rowFills`, if given, is incremented on a miss
+  int32_t getSuccessor(int32_t stateId, int substanceIndex, int recipeLength, int64_t *rowFills = nullptr)
+  {
+    // The default effect is only added below recipe length 9, so transitions differ by phase
+    LazyAtomicBlocks<int32_t> &phaseTransitions = recipeLength < 9 ? transitions : lateTransitions;
+    std::atomic<int32_t> &entry = phaseTransitions.row(stateId)[substanceIndex];
+
+    int32_t successor = entry.load(std::memory_order_acquire);
+    if (successor != UNKNOWN_STATE)
+    {
+      return successor;
+    }
+    if (rowFills)
+    {
+      ++*rowFills;
+    }
+    return fillRow(phaseTransitions, stateId, substanceIndex, recipeLength);
+  }
+
+  // Number of states interned so far
+  size_t stateCount() const;
+
+  size_t capacity() const { return maxStates; }
+
+  // Rules the table was built for. Any search with the same rule tables may share it, as
+  // states are plain effect sets and don't depend on the product
+  const CompiledEffects &compiledEffects() const { return compiled; }
+
+private:
+  static const int32_t EMPTY_SLOT = -1;
+  static const int32_t CLAIMED_SLOT = -2;
+  static const int32_t SKIPPED_SLOT = -3;
+  static const int32_t UNKNOWN_STATE = -2;
+  static const int32_t RETRY_INSERT = -4;
+  static const int MAX_SEGMENTS = 32;
+
+  // Open-addressing hash set: slotIds is EMPTY_SLOT, CLAIMED_SLOT (being written),
+  // SKIPPED_SLOT (abandoned claim) or the state ID stored in the slot. A segment takes
+  // states until it is half full, then a segment twice its size is added
+  struct Segment
+  {
+    explicit Segment(size_t slotCount);
+
+    size_t slotMask;
+    std::atomic<size_t> stateCount;
+    std::unique_ptr<EffectMask[]> slotKeys;
+    std::unique_ptr<std::atomic<int32_t>[]> slotIds;
+  };
+
+  // Find a mask in a segment without inserting it. Returns -1 if it isn't there
+  static int32_t findInSegment(const Segment &segment, uint64_t hash, EffectMask mask);
+
+  // Find or insert a mask in the newest segment. Returns RETRY_INSERT if a newer segment
+  // was added meanwhile
+  int32_t insertInSegment(int segmentIndex, uint64_t hash, EffectMask mask);
+
+  // Add a segment after `segmentIndex` unless another thread already did
+  void addSegment(int segmentIndex);
+
+  // Expand every substance of a state at once and publish the successors still unknown.
+  // DFS visits all children of a node, so the rest of the row is about to be needed
+  int32_t fillRow(LazyAtomicBlocks<int32_t> &phaseTransitions, int32_t stateId,
+                  int substanceIndex, int recipeLength);
+
+  const CompiledEffects &compiled;
+  RuleKernel kernel;
+  size_t maxStates;
+  std::atomic<int32_t> nextStateId;
+
+  // Each mask lives in exactly one segment. Segments only ever get appended
+  std::atomic<Segment *> segments[MAX_SEGMENTS];
+  std::atomic<int> newestSegment;
+  std::mutex segmentMutex;
+  size_t segmentStates; // States the segments hold at their load limit, guarded by segmentMutex
+
+  // State ID -> effect mask
+  LazyAtomicBlocks<EffectMask> masks;
+
+  // State ID -> successor state ID per substance, before and after recipe length 9
+  LazyAtomicBlocks<int32_t> transitions;
+  LazyAtomicBlocks<int32_t> lateTransitions;
+};
+
+// Lowest cost at which the subtree below each (state, depth) pair has been expanded.
+// Future effects only depend on the effect set and the recipe length, so a subtree
+// reached again at an equal or higher cost can't hold a better mix and is skipped.
+// Lock-free: entries only ever decrease, by compare-and-swap
+class DominanceTable
+{
+public:
+  DominanceTable(size_t maxStates, int maxDepth)
+      : costs(maxStates, static_cast<size_t>(maxDepth) + 1, INT_MAX) {}
+
+  // Claim the subtree below a state reached at `depth` for `costCents`. Returns false if
+  // it was already claimed at an equal or lower cost
+  bool claim(int32_t stateId, int depth, int costCents)
+  {
+    std::atomic<int> &entry = costs.row(stateId)[depth];
+    int claimed = entry.load(std::memory_order_relaxed);
+    while (costCents < claimed)
+    {
+      if (entry.compare_exchange_weak(claimed, costCents, std::memory_order_relaxed))
+        return true;
+    }
+    return false;
+  }
+
+private:
+  LazyAtomicBlocks<int> costs;
+};
+
+// Per-state sell price memo for one product, indexed by TransitionTable state ID
+class StatePriceCache
+{
+public:
+  explicit StatePriceCache(size_t maxStates = DEFAULT_TRANSITION_TABLE_STATES)
+      : prices(maxStates, 1, UNKNOWN_PRICE) {}
+
+  // Get the sell price of a state, calculating and caching it on first use
+  int getPrice(int32_t stateId, EffectMask effects, const PricingContext &pricing);
+
+private:
+  static const int UNKNOWN_PRICE = INT_MIN;
+
+  LazyAtomicBlocks<int> prices;
+};
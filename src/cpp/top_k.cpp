@@ -0,0 +1,116 @@
+#include "top_k.h"
+#include <algorithm>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/val.h>
+using namespace emscripten;
+#endif
+
+// Orders the heap so the least profitable entry is at the front
+static bool moreProfitable(const TopMixEntry &a, const TopMixEntry &b)
+{
+  return a.profitCents > b.profitCents;
+}
+
+TopMixList::TopMixList(const SearchOptions &options)
+    : capacity(std::max<size_t>(1, options.topK)),
+      maxCostCents(options.topMaxCostCents),
+      maxLength(options.topMaxLength)
+{
+  entries.reserve(capacity);
+}
+
+bool TopMixList::insert(const MixState &mix, EffectMask effects, int profitCents, int sellPriceCents, int costCents)
+{
+  // Keep only the best mix per effect set
+  for (TopMixEntry &entry : entries)
+  {
+    if (entry.effects == effects)
+    {
+      if (profitCents <= entry.profitCents)
+        return false;
+
+      entry = {mix, effects, profitCents, sellPriceCents, costCents};
+      std::make_heap(entries.begin(), entries.end(), moreProfitable);
+      return true;
+    }
+  }
+
+  if (entries.size() < capacity)
+  {
+    entries.push_back({mix, effects, profitCents, sellPriceCents, costCents});
+    std::push_heap(entries.begin(), entries.end(), moreProfitable);
+    return true;
+  }
+
+  if (profitCents <= entries.front().profitCents)
+    return false;
+
+  std::pop_heap(entries.begin(), entries.end(), moreProfitable);
+  entries.back() = {mix, effects, profitCents, sellPriceCents, costCents};
+  std::push_heap(entries.begin(), entries.end(), moreProfitable);
+  return true;
+}
+
+void TopMixList::merge(const TopMixList &other)
+{
+  for (const TopMixEntry &entry : other.entries)
+  {
+    if (admits(entry.profitCents, entry.costCents, static_cast<int>(entry.mix.substanceIndices.size())))
+    {
+      insert(entry.mix, entry.effects, entry.profitCents, entry.sellPriceCents, entry.costCents);
+    }
+  }
+}
+
+std::vector<TopMixEntry> TopMixList::sorted() const
+{
+  std::vector<TopMixEntry> result = entries;
+  std::sort(result.begin(), result.end(), moreProfitable);
+  return result;
+}
+
+void setTopMixes(
+    JsBestMixResult &result,
+    const TopMixList *top,
+    const MixState &bestMix,
+    const std::vector<Substance> &substances)
+{
+  std::vector<TopMixEntry> entries;
+  if (top)
+  {
+    entries = top->sorted();
+  }
+  else if (!bestMix.substanceIndices.empty())
+  {
+    entries.push_back({bestMix, 0, result.profitCents, result.sellPriceCents, result.costCents});
+  }
+
+#ifdef __EMSCRIPTEN__
+  val list = val::array();
+  for (size_t i = 0; i < entries.size(); ++i)
+  {
+    val names = val::array();
+    std::vector<std::string> mixNames = entries[i].mix.toSubstanceNames(substances);
+    for (size_t j = 0; j < mixNames.size(); ++j)
+    {
+      names.set(j, val(mixNames[j]));
+    }
+
+    val entry = val::object();
+    entry.set("mixArray", names);
+    entry.set("profit", entries[i].profitCents / 100.0);
+    entry.set("sellPrice", entries[i].sellPriceCents / 100.0);
+    entry.set("cost", entries[i].costCents / 100.0);
+    list.set(i, entry);
+  }
+  result.topMixes = list;
+#else
+  result.topMixes.clear();
+  for (const TopMixEntry &entry : entries)
+  {
+    result.topMixes.push_back({entry.mix.toSubstanceNames(substances), entry.profitCents,
+                               entry.sellPriceCents, entry.costCents, entry.effects});
+  }
+#endif
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "types.h"
+#include "effects.h"
+#include <vector>
+#include <climits>
+
+// A mix kept in a top-K list
+struct TopMixEntry
+{
+  MixState mix;
+  EffectMask effects;
+  int profitCents;
+  int sellPriceCents;
+  int costCents;
+};
+
+// Bounded list of the most profitable mixes, at most one per final effect set so the
+// list isn't filled with reorderings of the same recipe. Mixes outside the cost and
+// length filters never enter. Not thread-safe: each worker keeps its own list and the
+// lists are merged when the search ends
+class TopMixList
+{
+public:
+  explicit TopMixList(const SearchOptions &options);
+
+  // Cheap check to run before building a MixState: only admitted mixes can enter
+  bool admits(int profitCents, int costCents, int length) const
+  {
+    if ((maxCostCents >= 0 && costCents > maxCostCents) || (maxLength > 0 && length > maxLength))
+      return false;
+    return entries.size() < capacity || profitCents > entries.front().profitCents;
+  }
+
+  // Add an admitted mix. Returns true if the list changed
+  bool insert(const MixState &mix, EffectMask effects, int profitCents, int sellPriceCents, int costCents);
+
+  // Profit a mix has to beat to enter the full list; INT_MIN while the list isn't full.
+  // Merged lists only get better, so this is a valid pruning bound for the whole search
+  int thresholdCents() const { return entries.size() < capacity ? INT_MIN : entries.front().profitCents; }
+
+  void merge(const TopMixList &other);
+
+  // Entries sorted best first
+  std::vector<TopMixEntry> sorted() const;
+
+private:
+  size_t capacity;
+  int maxCostCents;
+  int maxLength;
+  std::vector<TopMixEntry> entries; // Min-heap on profit, so the weakest entry is at the front
+};
+
+// Fill result.topMixes from a top list, or with just the best mix of the result when
+// no list was kept. Call after the result's best mix amounts are set
+void setTopMixes(
+    JsBestMixResult &result,
+    const TopMixList *top,
+    const MixState &bestMix,
+    const std::vector<Substance> &substances);
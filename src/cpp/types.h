@@ -4,6 +4,8 @@
 #include <vector>
 #include <unordered_map>
 #include <functional>
+#include <chrono>
+#include <atomic>
 
 // Include Emscripten headers only when building for WebAssembly
 #ifdef __EMSCRIPTEN__
@@ -13,6 +15,19 @@
 // Progress reporting function type
 typedef std::function<void(int, int64_t, int64_t)> ProgressCallback;
 
+// Default cap on distinct effect-set states in the shared transition table. Memory grows
+// with the states actually reached, so the cap only bounds the worst case
+const size_t DEFAULT_TRANSITION_TABLE_STATES = size_t(1) << 22;
+
+// Default cap on the memory used by a stored BFS frontier
+const size_t DEFAULT_BFS_MEMORY_LIMIT_BYTES = size_t(64) << 20;
+
+// Default length of the substance prefixes DFS work is split into
+const int DEFAULT_DFS_PREFIX_DEPTH = 2;
+
+// Longest mix any engine can build
+const size_t MAX_MIX_LENGTH = 16;
+
 // Data structures that mirror the TypeScript ones
 struct Effect
 {
@@ -41,6 +56,9 @@ struct Product
 {
   std::string name;
   std::string initialEffect;
+  int basePriceCents; // Sell price with no effects; 0 = derive from the product name
+
+  Product() : basePriceCents(0) {}
 };
 
 // Define different result structs based on build type
@@ -57,8 +75,20 @@ struct JsBestMixResult
   double profit;    // Dollar value (cents / 100.0)
   double sellPrice; // Dollar value (cents / 100.0)
   double cost;      // Dollar value (cents / 100.0)
+
+  emscripten::val topMixes; // Array of {mixArray, profit, sellPrice, cost}, best first
 };
 #else
+// One entry of a top-K result list
+struct RankedMixResult
+{
+  std::vector<std::string> mixArray;
+  int profitCents;
+  int sellPriceCents;
+  int costCents;
+  uint64_t effects; // Final effect set as an EffectMask, 0 when it isn't known
+};
+
 // Native version with std::vector
 struct JsBestMixResult
 {
@@ -71,25 +101,65 @@ struct JsBestMixResult
   double profit;    // Dollar value (cents / 100.0)
   double sellPrice; // Dollar value (cents / 100.0)
   double cost;      // Dollar value (cents / 100.0)
+
+  std::vector<RankedMixResult> topMixes; // Best mixes with distinct effect sets, best first
 };
 #endif
 
+// Fixed-capacity vector stored inline - copying or growing it never touches the heap.
+// Elements past the capacity are dropped
+template <typename T, size_t Capacity>
+class InlineVector
+{
+public:
+  InlineVector() : count(0) {}
+
+  void push_back(const T &value)
+  {
+    if (count < Capacity)
+    {
+      items[count++] = value;
+    }
+  }
+
+  void pop_back()
+  {
+    if (count > 0)
+    {
+      --count;
+    }
+  }
+
+  // Storage is fixed, so reserving is a no-op
+  void reserve(size_t) {}
+  void clear() { count = 0; }
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  static size_t capacity() { return Capacity; }
+
+  T &operator[](size_t index) { return items[index]; }
+  const T &operator[](size_t index) const { return items[index]; }
+
+  const T *begin() const { return items; }
+  const T *end() const { return items + count; }
+
+private:
+  T items[Capacity];
+  size_t count;
+};
+
 // Memory-efficient mix representation
-// Instead of storing multiple copies of string vectors, store indices
+// Instead of storing multiple copies of string vectors, store indices inline
 struct MixState
 {
-  std::vector<size_t> substanceIndices; // Indices into substances vector
+  InlineVector<size_t, MAX_MIX_LENGTH> substanceIndices; // Indices into substances vector
 
   explicit MixState(size_t initialCapacity = 6)
   {
     substanceIndices.reserve(initialCapacity);
   }
 
-  MixState(const MixState &other)
-  {
-    substanceIndices = other.substanceIndices;
-  }
-
   void addSubstance(size_t index)
   {
     substanceIndices.push_back(index);
@@ -107,3 +177,135 @@ struct MixState
     return names;
   }
 };
+
+// Best mix known before a search starts, such as a cached result for a shallower depth.
+// Engines start from it as their best mix, so pruning has a real bound from the outset
+struct SearchSeed
+{
+  bool valid;
+  MixState mix;
+  int profitCents;
+  int sellPriceCents;
+  int costCents;
+
+  SearchSeed() : valid(false), profitCents(0), sellPriceCents(0), costCents(0) {}
+};
+
+// Best mix reporting function type: (mix, profit, sell price, cost), amounts in cents
+typedef std::function<void(const MixState &, int, int, int)> BestMixCallback;
+
+// Metrics reporting function type, called with one sampled snapshot as a line of JSON
+typedef std::function<void(const std::string &)> MetricsCallback;
+
+// Anytime search reporting function type: (depth, result, complete). A complete result is
+// the proven best mix of at most that many substances; an incomplete one is the best found
+// before the deadline or a cancel
+typedef std::function<void(int, const JsBestMixResult &, bool)> DepthResultCallback;
+
+// Bound sharing function type: called with the key of the search and its best profit in
+// cents, returns the best profit any search with the same key has found
+typedef std::function<int(uint64_t, int)> BoundExchange;
+
+// Default time between two samples of the search metrics
+const int DEFAULT_METRICS_INTERVAL_MS = 100;
+
+// Default time between two checkpoints of a DFS search
+const int DEFAULT_CHECKPOINT_INTERVAL_MS = 30 * 1000;
+
+// Shared effect-state transition table of DFS (see state_table.h)
+class TransitionTable;
+
+// Request to stop a running search, from another thread, a signal handler or a JavaScript
+// callback. Cancelling is one lock-free store, so it's safe in a signal handler. The
+// engines poll it with their deadline and return the best mix found so far
+class CancellationToken
+{
+public:
+  CancellationToken() : flag(false) {}
+
+  void cancel() { flag.store(true, std::memory_order_relaxed); }
+  void reset() { flag.store(false, std::memory_order_relaxed); }
+  bool cancelled() const { return flag.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<bool> flag;
+};
+
+// Restrictions on the mixes a search may return. The engines apply them while searching,
+// cutting subtrees that can't satisfy them, so a tighter constraint also means less work
+struct SearchConstraints
+{
+  int maxCostCents;                           // Most the whole mix may cost (-1 = no limit)
+  std::vector<std::string> requiredEffects;   // Effects the mix must end with
+  std::vector<std::string> forbiddenEffects;  // Effects the mix must not end with
+  std::vector<std::string> allowedSubstances; // Substances the mix may use (empty = all)
+  int exactLength;                            // Substances the mix must have (0 = any up to the depth)
+
+  SearchConstraints() : maxCostCents(-1), exactLength(0) {}
+
+  bool any() const
+  {
+    return maxCostCents >= 0 || !requiredEffects.empty() || !forbiddenEffects.empty() ||
+           !allowedSubstances.empty() || exactLength > 0;
+  }
+};
+
+// Tuning options for the search engines
+struct SearchOptions
+{
+  size_t transitionTableStates; // Capacity of the shared effect-state transition table
+  int threads;                  // Worker threads for DFS and BFS (0 = std::thread::hardware_concurrency())
+  int prefixDepth;              // Length of the substance prefixes DFS work units are split into
+  bool pruning;                 // Skip DFS subtrees whose profit upper bound can't beat the best mix
+  bool dominance;               // Skip DFS subtrees below a (depth, effect set) already expanded at no higher cost
+  size_t bfsMemoryLimitBytes;   // Largest BFS frontier kept in memory; deeper levels are streamed
+  SearchSeed seed;              // Known mix to start from, e.g. a cached shallower result
+  BestMixCallback bestMixCallback; // Called whenever the best mix improves (native builds)
+  size_t topK;                  // Number of best mixes with distinct effect sets to return
+  int topMaxCostCents;          // Only mixes costing at most this enter the top list (-1 = no limit)
+  int topMaxLength;             // Only mixes of at most this many substances enter the top list (0 = no limit)
+  MetricsCallback metricsCallback; // Called with each sample of the DFS metrics (nodes/sec, cache hits, ...)
+  int metricsIntervalMs;        // Time between two samples of the DFS progress and metrics
+  bool anytime;                 // DFS solves depth 1, 2, ... in turn, each bounded by the last one's best
+  DepthResultCallback depthResultCallback; // Called with each depth's result in anytime mode
+  std::chrono::steady_clock::time_point deadline; // The search returns its best mix so far at this time (epoch = none)
+  CancellationToken *cancellation; // The search returns its best mix so far once this is cancelled (null = never)
+  std::string checkpointFile;   // Native DFS periodically saves its progress here (empty = no checkpoints)
+  int checkpointIntervalMs;     // Time between two checkpoints
+  bool resume;                  // Continue from checkpointFile if it holds a checkpoint of the same search
+  TransitionTable *sharedTransitions; // Transition table kept across DFS searches over the same rules (null = one per search)
+  SearchConstraints constraints; // Budget, effect, substance and length restrictions on the result
+  int shardIndex;               // DFS only searches the work units whose index % shardCount is this
+  int shardCount;               // Shards a distributed DFS search is split into (1 = not sharded)
+  BoundExchange boundExchange;  // Shares the best profit with the other shards (native DFS, best-mix searches)
+
+  SearchOptions()
+      : transitionTableStates(DEFAULT_TRANSITION_TABLE_STATES),
+        threads(0),
+        prefixDepth(DEFAULT_DFS_PREFIX_DEPTH),
+        pruning(false),
+        dominance(false),
+        bfsMemoryLimitBytes(DEFAULT_BFS_MEMORY_LIMIT_BYTES),
+        topK(1),
+        topMaxCostCents(-1),
+        topMaxLength(0),
+        metricsIntervalMs(DEFAULT_METRICS_INTERVAL_MS),
+        anytime(false),
+        cancellation(nullptr),
+        checkpointIntervalMs(DEFAULT_CHECKPOINT_INTERVAL_MS),
+        resume(false),
+        sharedTransitions(nullptr),
+        shardIndex(0),
+        shardCount(1) {}
+
+  // Whether the engines need to keep a top-K list, rather than just reporting the best mix
+  bool wantsTopList() const { return topK > 1 || topMaxCostCents >= 0 || topMaxLength > 0; }
+
+  bool hasDeadline() const { return deadline != std::chrono::steady_clock::time_point(); }
+
+  // Set the deadline to the given number of milliseconds from now
+  void setTimeLimit(int64_t milliseconds)
+  {
+    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds);
+  }
+};
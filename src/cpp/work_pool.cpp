@@ -0,0 +1,79 @@
+#include "work_pool.h"
+
+WorkStealingPool::WorkStealingPool(size_t unitCount, int workerCount)
+    : workers(workerCount > 0 ? workerCount : 1),
+      slices(new Slice[workers]),
+      steals(0)
+{
+  // Split the units into equal contiguous slices, one per worker
+  for (int i = 0; i < workers; ++i)
+  {
+    uint32_t begin = static_cast<uint32_t>(unitCount * i / workers);
+    uint32_t end = static_cast<uint32_t>(unitCount * (i + 1) / workers);
+    slices[i].bounds.store(pack(begin, end), std::memory_order_relaxed);
+  }
+}
+
+bool WorkStealingPool::next(int worker, size_t &unit)
+{
+  while (true)
+  {
+    if (takeFront(worker, unit))
+    {
+      return true;
+    }
+    if (!steal(worker))
+    {
+      return false;
+    }
+  }
+}
+
+bool WorkStealingPool::takeFront(int worker, size_t &unit)
+{
+  std::atomic<uint64_t> &bounds = slices[worker].bounds;
+  uint64_t current = bounds.load(std::memory_order_acquire);
+  while (sliceBegin(current) < sliceEnd(current))
+  {
+    uint64_t taken = pack(sliceBegin(current) + 1, sliceEnd(current));
+    if (bounds.compare_exchange_weak(current, taken, std::memory_order_acq_rel))
+    {
+      unit = sliceBegin(current);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WorkStealingPool::steal(int worker)
+{
+  // Keep scanning while any victim still has work - a failed CAS means its slice moved,
+  // not that it's empty
+  bool sawWork = true;
+  while (sawWork)
+  {
+    sawWork = false;
+    for (int offset = 1; offset < workers; ++offset)
+    {
+      std::atomic<uint64_t> &victim = slices[(worker + offset) % workers].bounds;
+      uint64_t current = victim.load(std::memory_order_acquire);
+      uint32_t begin = sliceBegin(current);
+      uint32_t end = sliceEnd(current);
+      if (begin >= end)
+        continue;
+
+      sawWork = true;
+
+      // Take the back half, rounded up so a single remaining unit can be stolen too
+      uint32_t split = begin + (end - begin) / 2;
+      if (victim.compare_exchange_strong(current, pack(begin, split), std::memory_order_acq_rel))
+      {
+        // Only the owner refills its own slice, and only once it's empty, so a plain store is safe
+        slices[worker].bounds.store(pack(split, end), std::memory_order_release);
+        steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+  }
+  return false;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// Lock-free work-stealing scheduler over the indices 0..unitCount-1.
+// Each worker starts with a contiguous slice of the indices and takes units from its
+// front. A worker whose slice is empty steals the back half of another worker's slice,
+// so threads keep busy until the last unit is handed out even when unit costs vary
+class WorkStealingPool
+{
+public:
+  WorkStealingPool(size_t unitCount, int workerCount);
+
+  // Get the next unit for a worker. Returns false once every unit has been handed out
+  bool next(int worker, size_t &unit);
+
+  // Number of successful steals, for diagnostics
+  int64_t stealCount() const { return steals.load(std::memory_order_relaxed); }
+
+  int workerCount() const { return workers; }
+
+private:
+  // Slice [begin, end) packed into one word so owner and thieves can update it with a CAS.
+  // Padded to a cache line so workers don't contend on each other's slices
+  struct Slice
+  {
+    std::atomic<uint64_t> bounds;
+    char padding[64 - sizeof(std::atomic<uint64_t>)];
+  };
+
+  static uint64_t pack(uint32_t begin, uint32_t end) { return (static_cast<uint64_t>(begin) << 32) | end; }
+  static uint32_t sliceBegin(uint64_t bounds) { return static_cast<uint32_t>(bounds >> 32); }
+  static uint32_t sliceEnd(uint64_t bounds) { return static_cast<uint32_t>(bounds); }
+
+  bool takeFront(int worker, size_t &unit);
+  bool steal(int worker);
+
+  int workers;
+  std::unique_ptr<Slice[]> slices;
+  std::atomic<int64_t> steals;
+};
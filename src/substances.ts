@@ -964,6 +964,12 @@ export function calculateFinalPrice(
   return Math.round(product.basePrice * (1 + totalMultiplier));
 }
 
+// Base price of a product or product variety, sent to the calculators with the product
+export function getBasePrice(productName: string): number | undefined {
+  const baseProductName = productVarietyMap.get(productName) || productName;
+  return products[baseProductName]?.basePrice;
+}
+
 export function calculateFinalCost(currentMix: string[]): number {
   let totalCost = 0;
 
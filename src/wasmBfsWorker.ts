@@ -40,6 +40,9 @@ self.onmessage = async (event: MessageEvent) => {
     state.lastBestMixUpdate = 0;
     state.totalTrackedProcessed = 0;
     state.totalTrackedCombinations = 0;
+    state.cancelFlag = data.cancelBuffer
+      ? new Int32Array(data.cancelBuffer)
+      : null;
     state.currentBestMix = {
       mix: [],
       profit: -Infinity,
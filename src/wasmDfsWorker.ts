@@ -1,5 +1,6 @@
 // WebAssembly DFS Worker
-// This worker runs the WASM DFS implementation with multi-threading to avoid blocking the UI thread
+// This worker runs the WASM DFS implementation off the UI thread. On cross-origin isolated
+// pages it loads the pthread build, which searches on all cores
 
 import {
   WorkerState,
@@ -19,15 +20,39 @@ declare global {
   interface Window {
     reportDfsProgress: (progressData: any) => void;
     reportBestMixFound: (mixData: any) => void;
+    reportDepthResult: (depthResult: any) => void;
   }
 }
 
+// Module of the running search, whose metrics are polled on each progress report
+let runningModule: any = null;
+
 // Implementation of reportDfsProgress that the C++ code will call
-(self as any).reportDfsProgress = setupProgressReporting(state);
+(self as any).reportDfsProgress = setupProgressReporting(state, () =>
+  runningModule && typeof runningModule.getSearchMetricsJson === "function"
+    ? runningModule.getSearchMetricsJson()
+    : undefined
+);
 
 // Implementation of reportBestMixFound that the C++ code will call
 (self as any).reportBestMixFound = setupBestMixReporting(state);
 
+// Each depth's result of an anytime search, proven optimal when `complete`
+(self as any).reportDepthResult = (depthResult: any) => {
+  self.postMessage({
+    type: "depthResult",
+    depth: depthResult.depth,
+    complete: depthResult.complete,
+    bestMix: {
+      mix: Array.from(depthResult.mixArray || []),
+      profit: depthResult.profit,
+      sellPrice: depthResult.sellPrice,
+      cost: depthResult.cost,
+    },
+    workerId: state.workerId,
+  });
+};
+
 // Handle messages from the main thread
 self.onmessage = async (event: MessageEvent) => {
   const { type, workerId: id, data } = event.data || {};
@@ -40,6 +65,9 @@ self.onmessage = async (event: MessageEvent) => {
     state.lastBestMixUpdate = 0;
     state.totalTrackedProcessed = 0;
     state.totalTrackedCombinations = 0;
+    state.cancelFlag = data.cancelBuffer
+      ? new Int32Array(data.cancelBuffer)
+      : null;
     state.currentBestMix = {
       mix: [],
       profit: -Infinity,
@@ -58,7 +86,8 @@ self.onmessage = async (event: MessageEvent) => {
         substancesJson,
         effectMultipliersJson,
         substanceRulesJson,
-      } = await prepareWasmRun(state, product, maxDepth);
+      } = await prepareWasmRun(state, product, maxDepth, true);
+      runningModule = wasmModule;
 
       // Check if DFS functions are available
       if (typeof wasmModule.findBestMixDFSJsonWithProgress !== "function") {
@@ -68,21 +97,37 @@ self.onmessage = async (event: MessageEvent) => {
         }
       }
 
-      console.log("Starting multi-threaded WebAssembly DFS...");
+      const threadCount = wasmModule.isThreaded
+        ? navigator.hardwareConcurrency || 1
+        : 1;
+      console.log(`Starting WebAssembly DFS on ${threadCount} thread(s)...`);
 
-      // Post a message to inform the main thread that we're using threading
+      // Post a message to inform the main thread whether we're using threading
       self.postMessage({
         type: "info",
-        message:
-          "Using multi-threaded WebAssembly implementation with 16 threads",
+        message: wasmModule.isThreaded
+          ? `Using multi-threaded WebAssembly implementation with ${threadCount} threads`
+          : "Using single-threaded WebAssembly implementation (page is not cross-origin isolated)",
         workerId: state.workerId,
       });
 
-      // Call the WASM DFS function with JSON strings and enable progress reporting
-      // The multi-threaded implementation will be used automatically by the WebAssembly module
-      // due to the PTHREAD_POOL_SIZE=16 setting in the build
+      // Call the WASM DFS function with JSON strings and enable progress reporting.
+      // The threaded build spreads the search over its pthread pool and reports progress
+      // from this thread, so the callbacks above keep working
+      // Anytime runs solve depth by depth and stop at their deadline, if any
       let result;
-      if (wasmModule.findBestMixDFSJsonWithProgress) {
+      if (data.anytime && wasmModule.findBestMixDFSJsonAnytime) {
+        result = wasmModule.findBestMixDFSJsonAnytime(
+          productJson,
+          substancesJson,
+          effectMultipliersJson,
+          substanceRulesJson,
+          maxDepth,
+          true, // Enable progress reporting
+          true, // Enable hashing optimization
+          data.deadlineMs || 0
+        );
+      } else if (wasmModule.findBestMixDFSJsonWithProgress) {
         result = wasmModule.findBestMixDFSJsonWithProgress(
           productJson,
           substancesJson,
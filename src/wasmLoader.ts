@@ -66,13 +66,18 @@ export interface BFSModule {
 
   // Add the helper function
   getMixArray?: () => string[];
+
+  // Stops the running search, which then returns its best mix so far
+  cancelSearch?: () => void;
+
+  // Set by the loader: true for the pthread build, where DFS runs on all cores
+  isThreaded?: boolean;
 }
 
 // No module declaration - we'll use type assertions instead
 
-let wasmModule: BFSModule | null = null;
-let isLoading = false;
-let loadPromise: Promise<BFSModule> | null = null;
+// Loaded modules, keyed by build variant
+const loadPromises: { [variant: string]: Promise<BFSModule> } = {};
 
 /**
  * Utility function to convert a ClassHandle to a JavaScript array
@@ -99,46 +104,75 @@ export function extractMixArrayFromClassHandle(mixHandle: any): string[] {
 }
 
 /**
- * Loads the WebAssembly module containing the BFS algorithm
+ * Whether this context can run the threaded build: it needs SharedArrayBuffer, which
+ * browsers only provide to cross-origin isolated pages (COOP/COEP headers)
  */
-export async function loadWasmModule(): Promise<BFSModule> {
-  if (wasmModule) {
-    return wasmModule;
-  }
-
-  if (isLoading && loadPromise) {
-    return loadPromise;
-  }
-
-  isLoading = true;
-  loadPromise = new Promise(async (resolve, reject) => {
-    try {
-      console.log("Starting to load WASM module...");
-
-      // Import the JS glue code generated by Emscripten
-      // @ts-ignore - Suppress TypeScript error for WASM module import
-      const moduleImport = await import("./cpp/bfs.wasm.js");
-      const moduleFactory = moduleImport.default as unknown as BFSModuleFactory;
-
-      console.log("Module factory loaded, initializing WASM module...");
+export function canUseThreadedWasm(): boolean {
+  return (
+    typeof SharedArrayBuffer !== "undefined" &&
+    (self as any).crossOriginIsolated === true
+  );
+}
 
-      // Initialize the module
-      const module = await moduleFactory();
+/**
+ * Creates the flag a page sets to stop a running WASM search, which then returns its
+ * best mix so far. The worker is blocked while the search runs, so the flag lives in
+ * shared memory and is only available to cross-origin isolated pages; elsewhere the
+ * search can only be stopped by terminating its worker
+ */
+export function createCancelBuffer(): SharedArrayBuffer | null {
+  return canUseThreadedWasm() ? new SharedArrayBuffer(4) : null;
+}
 
-      console.log("WASM module initialized:", module);
-      console.log("Available module functions:", Object.keys(module));
+/**
+ * Loads the WebAssembly module containing the BFS algorithm.
+ * With `threaded` set, the pthread build is used when the context allows it,
+ * falling back to the single-threaded build otherwise
+ */
+export async function loadWasmModule(threaded = false): Promise<BFSModule> {
+  const useThreads = threaded && canUseThreadedWasm();
+  const variant = useThreads ? "threads" : "single";
+
+  if (!loadPromises[variant]) {
+    loadPromises[variant] = (async () => {
+      try {
+        console.log(`Starting to load ${variant}-threaded WASM module...`);
+
+        // Import the JS glue code generated by Emscripten
+        const moduleImport = useThreads
+          ? // @ts-ignore - Suppress TypeScript error for WASM module import
+            await import("./cpp/bfs.threads.wasm.js")
+          : // @ts-ignore - Suppress TypeScript error for WASM module import
+            await import("./cpp/bfs.wasm.js");
+        const moduleFactory = moduleImport.default as unknown as BFSModuleFactory;
+
+        console.log("Module factory loaded, initializing WASM module...");
+
+        // Initialize the module
+        const module = await moduleFactory();
+        module.isThreaded = useThreads;
+
+        console.log("WASM module initialized:", module);
+        console.log("Available module functions:", Object.keys(module));
+
+        return module;
+      } catch (error) {
+        console.error(`Failed to load ${variant}-threaded WASM module:`, error);
+        delete loadPromises[variant];
+        throw error;
+      }
+    })();
+  }
 
-      wasmModule = module;
-      isLoading = false;
-      resolve(wasmModule);
-    } catch (error) {
-      console.error("Failed to load WASM module:", error);
-      isLoading = false;
-      reject(error);
+  try {
+    return await loadPromises[variant];
+  } catch (error) {
+    if (!useThreads) {
+      throw error;
     }
-  });
-
-  return loadPromise;
+    console.warn("Falling back to the single-threaded WASM module");
+    return loadWasmModule(false);
+  }
 }
 
 // Prepare substance data as JSON string
@@ -1,7 +1,7 @@
 // WASM Worker Common Utilities
 // This file contains shared functionality used by both BFS and DFS WebAssembly workers
 
-import { effects } from "./substances";
+import { effects, getBasePrice } from "./substances";
 import {
   loadWasmModule,
   prepareEffectMultipliersForWasm,
@@ -18,6 +18,10 @@ export interface WorkerState {
   lastBestMixUpdate: number;
   totalTrackedProcessed: number;
   totalTrackedCombinations: number;
+  // Flag the page sets to stop the search (see createCancelBuffer), null if unavailable
+  cancelFlag: Int32Array | null;
+  // Stops the running search of the loaded module
+  cancelSearch: (() => void) | null;
   currentBestMix: {
     mix: string[];
     profit: number;
@@ -45,6 +49,8 @@ export function createWorkerState(): WorkerState {
     lastBestMixUpdate: 0,
     totalTrackedProcessed: 0,
     totalTrackedCombinations: 0,
+    cancelFlag: null,
+    cancelSearch: null,
     currentBestMix: {
       mix: [],
       profit: -Infinity,
@@ -54,10 +60,29 @@ export function createWorkerState(): WorkerState {
   };
 }
 
+// Stop the running search once the page raised the cancel flag. The search calls back
+// into JavaScript only to report progress, so this is polled from there
+export function pollCancellation(state: WorkerState) {
+  if (
+    state.cancelFlag &&
+    state.cancelSearch &&
+    Atomics.load(state.cancelFlag, 0) !== 0
+  ) {
+    state.cancelSearch();
+    state.cancelSearch = null;
+  }
+}
+
 // Setup global reportProgress function for C++ to call
-// Note: Algorithm-specific version (BFS/DFS) should be implemented in each worker
-export function setupProgressReporting(state: WorkerState) {
+// Note: Algorithm-specific version (BFS/DFS) should be implemented in each worker.
+// `readMetrics` polls the module's latest metrics sample (JSON), which is sent along
+// with each progress update
+export function setupProgressReporting(
+  state: WorkerState,
+  readMetrics?: () => string | undefined
+) {
   return function reportProgress(progressData: any) {
+    pollCancellation(state);
     if (state.isPaused) return;
 
     const currentTime = Date.now();
@@ -74,6 +99,8 @@ export function setupProgressReporting(state: WorkerState) {
       state.totalTrackedCombinations = progressData.total;
     }
 
+    const metricsJson = readMetrics ? readMetrics() : undefined;
+
     // Send progress update to main thread
     self.postMessage({
       type: "progress",
@@ -82,6 +109,7 @@ export function setupProgressReporting(state: WorkerState) {
       total: progressData.total,
       executionTime: Date.now() - state.startTime,
       workerId: state.workerId,
+      metrics: metricsJson ? JSON.parse(metricsJson) : undefined,
     });
   };
 }
@@ -132,23 +160,30 @@ export function setupBestMixReporting(state: WorkerState) {
   };
 }
 
-// Prepare a WASM run with common setup
+// Prepare a WASM run with common setup. `threaded` asks for the pthread build,
+// which is used when the page is cross-origin isolated
 export async function prepareWasmRun(
   state: WorkerState,
   product: any,
-  maxDepth: number
+  maxDepth: number,
+  threaded = false
 ) {
   // Prepare data for WASM as JSON strings
   const productJson = JSON.stringify({
     name: product.name,
     initialEffect: product.initialEffect,
+    basePrice: getBasePrice(product.name),
   });
   const substancesJson = prepareSubstancesForWasm();
   const effectMultipliersJson = prepareEffectMultipliersForWasm(effects);
   const substanceRulesJson = prepareSubstanceRulesForWasm();
 
   // Load the WebAssembly module
-  const wasmModule = await loadWasmModule();
+  const wasmModule = await loadWasmModule(threaded);
+  state.cancelSearch =
+    typeof wasmModule.cancelSearch === "function"
+      ? () => wasmModule.cancelSearch!()
+      : null;
 
   return {
     wasmModule,
@@ -40,7 +40,7 @@ else
 fi
 
 # Check if the source files exist
-CPP_FILES=("src/cpp/bfs.cpp" "src/cpp/effects.cpp" "src/cpp/pricing.cpp" "src/cpp/bfs_algorithm.cpp" "src/cpp/json_parser.cpp")
+CPP_FILES=("src/cpp/bfs.cpp" "src/cpp/dfs.cpp" "src/cpp/dp.cpp" "src/cpp/effects.cpp" "src/cpp/pricing.cpp" "src/cpp/reporter.cpp" "src/cpp/bfs_algorithm.cpp" "src/cpp/dfs_algorithm.cpp" "src/cpp/state_table.cpp" "src/cpp/rule_kernel.cpp" "src/cpp/work_pool.cpp" "src/cpp/profit_bound.cpp" "src/cpp/top_k.cpp" "src/cpp/constraints.cpp" "src/cpp/shared_best.cpp" "src/cpp/metrics.cpp" "src/cpp/dp_algorithm.cpp" "src/cpp/incremental.cpp" "src/cpp/json_parser.cpp")
 MISSING_FILES=0
 
 echo "Checking for required C++ source files:"
@@ -16,7 +16,7 @@ export default defineConfig({
     rollupOptions: {
       output: {
         manualChunks: {
-          wasm: ["./src/cpp/bfs.wasm.js"],
+          wasm: ["./src/cpp/bfs.wasm.js", "./src/cpp/bfs.threads.wasm.js"],
         },
       },
     },
@@ -31,7 +31,7 @@ export default defineConfig({
   },
   // Don't try to optimize WASM modules
   optimizeDeps: {
-    exclude: ["./src/cpp/bfs.wasm.js"],
+    exclude: ["./src/cpp/bfs.wasm.js", "./src/cpp/bfs.threads.wasm.js"],
   },
   // Handle WebAssembly files correctly
   assetsInclude: ["**/*.wasm"],